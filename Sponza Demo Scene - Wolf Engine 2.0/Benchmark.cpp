@@ -0,0 +1,270 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+#include <Debug.h>
+
+#include "GameContext.h"
+#include "GPUProfiler.h"
+
+using namespace Wolf;
+
+bool Benchmark::parseCommandLine(int argc, char* argv[], CreateInfo& output)
+{
+	bool benchmarkRequested = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg(argv[i]);
+		const bool hasValue = i + 1 < argc;
+
+		if (arg == "--benchmark")
+		{
+			benchmarkRequested = true;
+			if (hasValue && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+				output.frameCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--benchmark-scenario" && hasValue)
+		{
+			benchmarkRequested = true;
+			output.scenarioFilename = argv[++i];
+		}
+		else if (arg == "--benchmark-pipeline-statistics")
+		{
+			benchmarkRequested = true;
+			output.collectPipelineStatistics = true;
+		}
+		else if (arg == "--benchmark-output" && hasValue)
+		{
+			benchmarkRequested = true;
+			output.outputFilename = argv[++i];
+		}
+		else if (arg == "--benchmark-window")
+		{
+			benchmarkRequested = true;
+			output.offscreen = false;
+		}
+		else
+		{
+			Debug::sendWarning("Unknown command line argument: " + arg);
+		}
+	}
+
+	return benchmarkRequested;
+}
+
+Benchmark::Benchmark(const CreateInfo& createInfo, uint32_t framesInFlight) : m_frameCount(createInfo.frameCount), m_framesInFlight(framesInFlight), m_outputFilename(createInfo.outputFilename), m_offscreen(createInfo.offscreen)
+{
+	if (!createInfo.scenarioFilename.empty())
+		loadScenario(createInfo.scenarioFilename);
+
+	if (m_keyFrames.empty())
+	{
+		// Default scenario: walk down the nave while the sun moves across the sky
+		m_keyFrames =
+		{
+			{ 0.00f, glm::vec3(-10.0f, 1.5f,  0.0f), glm::vec3(-5.0f, 1.5f,  0.0f), -0.6f, 0.3f },
+			{ 0.35f, glm::vec3( -2.0f, 1.5f,  1.5f), glm::vec3( 3.0f, 2.5f,  0.0f), -0.2f, 0.3f },
+			{ 0.65f, glm::vec3(  6.0f, 5.5f, -3.0f), glm::vec3( 0.0f, 1.0f,  0.0f),  0.2f, 0.3f },
+			{ 1.00f, glm::vec3( 10.0f, 1.5f,  0.0f), glm::vec3( 5.0f, 1.5f,  0.0f),  0.6f, 0.3f }
+		};
+	}
+
+	m_frameTimings.reserve(m_frameCount);
+}
+
+void Benchmark::updateGameContext(GameContext& gameContext) const
+{
+	const float time = m_frameCount > 1 ? static_cast<float>(m_currentFrame) / static_cast<float>(m_frameCount - 1) : 0.0f;
+
+	const auto nextKeyFrame = std::find_if(m_keyFrames.begin(), m_keyFrames.end(), [time](const KeyFrame& keyFrame) { return keyFrame.time >= time; });
+	KeyFrame keyFrame;
+	if (nextKeyFrame == m_keyFrames.begin())
+		keyFrame = m_keyFrames.front();
+	else if (nextKeyFrame == m_keyFrames.end())
+		keyFrame = m_keyFrames.back();
+	else
+	{
+		const KeyFrame& previous = *(nextKeyFrame - 1);
+		const KeyFrame& next = *nextKeyFrame;
+		const float t = (time - previous.time) / std::max(next.time - previous.time, 1e-6f);
+
+		keyFrame.cameraPosition = glm::mix(previous.cameraPosition, next.cameraPosition, t);
+		keyFrame.cameraTarget = glm::mix(previous.cameraTarget, next.cameraTarget, t);
+		keyFrame.sunPhi = glm::mix(previous.sunPhi, next.sunPhi, t);
+		keyFrame.sunTheta = glm::mix(previous.sunTheta, next.sunTheta, t);
+	}
+
+	gameContext.sunPhi = keyFrame.sunPhi;
+	gameContext.sunTheta = keyFrame.sunTheta;
+	gameContext.sunDirection = -glm::vec3(glm::sin(keyFrame.sunPhi) * glm::cos(keyFrame.sunTheta), glm::cos(keyFrame.sunPhi), glm::sin(keyFrame.sunPhi) * glm::sin(keyFrame.sunTheta));
+
+	gameContext.offscreen = m_offscreen;
+
+	gameContext.overrideCamera = true;
+	gameContext.cameraOverridePosition = keyFrame.cameraPosition;
+	gameContext.cameraOverrideTarget = keyFrame.cameraTarget;
+
+	// Animations must not depend on how fast the frames are rendered to keep runs comparable
+	constexpr float FIXED_TIME_STEP = 1.0f / 60.0f;
+	gameContext.useFixedAnimationTime = true;
+	gameContext.animationTimeInSeconds = static_cast<float>(m_currentFrame) * FIXED_TIME_STEP;
+}
+
+void Benchmark::beginFrame()
+{
+	m_frameStartTime = std::chrono::steady_clock::now();
+}
+
+void Benchmark::endUpdate()
+{
+	m_updateEndTime = std::chrono::steady_clock::now();
+}
+
+void Benchmark::endFrame(const GPUProfiler* gpuProfiler)
+{
+	const auto currentTime = std::chrono::steady_clock::now();
+
+	FrameTimings& frameTimings = m_frameTimings.emplace_back();
+	frameTimings.updateTimeInMs = std::chrono::duration<float, std::milli>(m_updateEndTime - m_frameStartTime).count();
+	frameTimings.frameTimeInMs = std::chrono::duration<float, std::milli>(currentTime - m_updateEndTime).count();
+	frameTimings.totalTimeInMs = std::chrono::duration<float, std::milli>(currentTime - m_frameStartTime).count();
+
+	if (gpuProfiler)
+	{
+		std::vector<GPUProfiler::RegionResult> gpuResults;
+		gpuProfiler->getResults(gpuResults);
+
+		// Regions are only appended by the profiler so indices stay stable
+		for (size_t i = m_gpuPassNames.size(); i < gpuResults.size(); ++i)
+			m_gpuPassNames.push_back(gpuResults[i].name);
+
+		frameTimings.gpuPassTimesInMs.reserve(gpuResults.size());
+		for (const GPUProfiler::RegionResult& gpuResult : gpuResults)
+			frameTimings.gpuPassTimesInMs.push_back(gpuResult.lastTimeInMs);
+	}
+
+	m_currentFrame++;
+}
+
+void Benchmark::writeResults() const
+{
+	std::ofstream outFile(m_outputFilename);
+	if (!outFile.is_open())
+	{
+		Debug::sendError("Can't open benchmark output file " + m_outputFilename);
+		return;
+	}
+
+	const bool useJSON = m_outputFilename.size() >= 5 && m_outputFilename.compare(m_outputFilename.size() - 5, 5, ".json") == 0;
+	if (useJSON)
+		writeJSON(outFile);
+	else
+		writeCSV(outFile);
+
+	Summary summary;
+	computeSummary(summary);
+	Debug::sendInfo("Benchmark with " + std::to_string(m_framesInFlight) + " frames in flight: " + std::to_string(summary.averageTotalTimeInMs) + " ms per frame, CPU " +
+		std::to_string(summary.averageCPUTimeInMs) + " ms, GPU " + std::to_string(summary.averageGPUTimeInMs) + " ms, CPU/GPU overlap " + std::to_string(static_cast<int>(summary.overlapRatio * 100.0f)) + "%");
+	Debug::sendInfo("Benchmark results written to " + m_outputFilename);
+}
+
+void Benchmark::computeSummary(Summary& output) const
+{
+	output = {};
+	if (m_frameTimings.empty())
+		return;
+
+	for (const FrameTimings& frameTimings : m_frameTimings)
+	{
+		output.averageTotalTimeInMs += frameTimings.totalTimeInMs;
+		output.averageCPUTimeInMs += frameTimings.updateTimeInMs + frameTimings.frameTimeInMs;
+		for (const float gpuPassTimeInMs : frameTimings.gpuPassTimesInMs)
+			output.averageGPUTimeInMs += gpuPassTimeInMs;
+	}
+
+	const float frameCount = static_cast<float>(m_frameTimings.size());
+	output.averageTotalTimeInMs /= frameCount;
+	output.averageCPUTimeInMs /= frameCount;
+	output.averageGPUTimeInMs /= frameCount;
+
+	// Without overlap a frame costs CPU + GPU time, with perfect overlap it costs max(CPU, GPU)
+	const float hideableTimeInMs = std::min(output.averageCPUTimeInMs, output.averageGPUTimeInMs);
+	if (hideableTimeInMs > 0.0f)
+		output.overlapRatio = std::clamp((output.averageCPUTimeInMs + output.averageGPUTimeInMs - output.averageTotalTimeInMs) / hideableTimeInMs, 0.0f, 1.0f);
+}
+
+void Benchmark::loadScenario(const std::string& filename)
+{
+	std::ifstream inFile(filename);
+	if (!inFile.is_open())
+	{
+		Debug::sendError("Can't open benchmark scenario " + filename + ", using default scenario");
+		return;
+	}
+
+	// One key frame per line: time posX posY posZ targetX targetY targetZ sunPhi sunTheta
+	std::string line;
+	while (std::getline(inFile, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream lineStream(line);
+		KeyFrame keyFrame;
+		lineStream >> keyFrame.time >> keyFrame.cameraPosition.x >> keyFrame.cameraPosition.y >> keyFrame.cameraPosition.z
+			>> keyFrame.cameraTarget.x >> keyFrame.cameraTarget.y >> keyFrame.cameraTarget.z >> keyFrame.sunPhi >> keyFrame.sunTheta;
+		if (lineStream.fail())
+		{
+			Debug::sendWarning("Ignoring malformed benchmark key frame: " + line);
+			continue;
+		}
+
+		m_keyFrames.push_back(keyFrame);
+	}
+
+	std::sort(m_keyFrames.begin(), m_keyFrames.end(), [](const KeyFrame& a, const KeyFrame& b) { return a.time < b.time; });
+}
+
+void Benchmark::writeCSV(std::ofstream& outFile) const
+{
+	outFile << "frame,updateMs,frameMs,totalMs";
+	for (const std::string& gpuPassName : m_gpuPassNames)
+		outFile << ",gpu " << gpuPassName << " Ms";
+	outFile << "\n";
+
+	for (uint32_t i = 0; i < m_frameTimings.size(); ++i)
+	{
+		const FrameTimings& frameTimings = m_frameTimings[i];
+		outFile << i << "," << frameTimings.updateTimeInMs << "," << frameTimings.frameTimeInMs << "," << frameTimings.totalTimeInMs;
+		for (size_t gpuPassIdx = 0; gpuPassIdx < m_gpuPassNames.size(); ++gpuPassIdx)
+		{
+			outFile << ",";
+			if (gpuPassIdx < frameTimings.gpuPassTimesInMs.size())
+				outFile << frameTimings.gpuPassTimesInMs[gpuPassIdx];
+		}
+		outFile << "\n";
+	}
+}
+
+void Benchmark::writeJSON(std::ofstream& outFile) const
+{
+	Summary summary;
+	computeSummary(summary);
+	outFile << "{\n\t\"frameCount\": " << m_frameTimings.size() << ",\n\t\"framesInFlight\": " << m_framesInFlight << ",\n";
+	outFile << "\t\"averageTotalMs\": " << summary.averageTotalTimeInMs << ",\n\t\"averageCPUMs\": " << summary.averageCPUTimeInMs << ",\n\t\"averageGPUMs\": " << summary.averageGPUTimeInMs <<
+		",\n\t\"overlapRatio\": " << summary.overlapRatio << ",\n\t\"frames\": [\n";
+	for (uint32_t i = 0; i < m_frameTimings.size(); ++i)
+	{
+		const FrameTimings& frameTimings = m_frameTimings[i];
+		outFile << "\t\t{ \"frame\": " << i << ", \"updateMs\": " << frameTimings.updateTimeInMs << ", \"frameMs\": " << frameTimings.frameTimeInMs << ", \"totalMs\": " << frameTimings.totalTimeInMs;
+		outFile << ", \"gpuPassesMs\": {";
+		for (size_t gpuPassIdx = 0; gpuPassIdx < frameTimings.gpuPassTimesInMs.size(); ++gpuPassIdx)
+			outFile << (gpuPassIdx > 0 ? ", " : " ") << "\"" << m_gpuPassNames[gpuPassIdx] << "\": " << frameTimings.gpuPassTimesInMs[gpuPassIdx];
+		outFile << " } }";
+		outFile << (i + 1 < m_frameTimings.size() ? ",\n" : "\n");
+	}
+	outFile << "\t]\n}\n";
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class GPUProfiler;
+struct GameContext;
+
+class Benchmark
+{
+public:
+	struct CreateInfo
+	{
+		uint32_t frameCount = 1000;
+		std::string scenarioFilename; // empty = default camera path and sun schedule
+		std::string outputFilename = "benchmark.csv"; // ".json" extension switches output to JSON
+		bool collectPipelineStatistics = false;
+		bool offscreen = true; // no window: the final image stays in the TAA output and the swapchain comes from a headless surface
+	};
+	static bool parseCommandLine(int argc, char* argv[], CreateInfo& output);
+
+	Benchmark(const CreateInfo& createInfo, uint32_t framesInFlight);
+
+	bool isFinished() const { return m_currentFrame >= m_frameCount; }
+	bool isOffscreen() const { return m_offscreen; }
+	void updateGameContext(GameContext& gameContext) const;
+
+	void beginFrame();
+	void endUpdate();
+	void endFrame(const GPUProfiler* gpuProfiler);
+
+	void writeResults() const;
+
+private:
+	void loadScenario(const std::string& filename);
+	void writeCSV(std::ofstream& outFile) const;
+	void writeJSON(std::ofstream& outFile) const;
+
+	struct Summary
+	{
+		float averageTotalTimeInMs;
+		float averageCPUTimeInMs; // update + frame recording and submission
+		float averageGPUTimeInMs; // sum of the profiled passes
+		float overlapRatio; // share of the GPU work hidden behind CPU work of other frames
+	};
+	void computeSummary(Summary& output) const;
+
+	struct KeyFrame
+	{
+		float time; // normalized between 0 (first frame) and 1 (last frame)
+		glm::vec3 cameraPosition;
+		glm::vec3 cameraTarget;
+		float sunPhi;
+		float sunTheta;
+	};
+	std::vector<KeyFrame> m_keyFrames;
+
+	uint32_t m_frameCount;
+	uint32_t m_framesInFlight;
+	uint32_t m_currentFrame = 0;
+	std::string m_outputFilename;
+	bool m_offscreen;
+
+	struct FrameTimings
+	{
+		float updateTimeInMs;
+		float frameTimeInMs;
+		float totalTimeInMs;
+		std::vector<float> gpuPassTimesInMs; // latest resolved GPU time of each pass, indexed like m_gpuPassNames (GPU results are read back a few frames late)
+	};
+	std::vector<FrameTimings> m_frameTimings;
+	std::vector<std::string> m_gpuPassNames;
+	std::chrono::steady_clock::time_point m_frameStartTime;
+	std::chrono::steady_clock::time_point m_updateEndTime;
+};
@@ -0,0 +1,88 @@
+#include "CascadeFitting.h"
+
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// Depth bounds are read back a few frames late, the range is widened so that a moving camera stays covered
+static constexpr float DEPTH_RANGE_MARGIN = 0.05f;
+static constexpr float MIN_DEPTH_RANGE = 0.1f;
+
+// Border kept around the slice for the PCF kernel and the texel snapping
+static constexpr float BORDER_TEXEL_COUNT = 8.0f;
+// Radius is rounded up to limit the texel size changes (and the shimmering) between frames
+static constexpr float RADIUS_STEP = 0.25f;
+// The depth of the center is snapped too so that the near plane of the cascade camera doesn't slide along the light direction with the camera,
+// depths rendered at different frames (static casters cache and dynamic casters) are then comparable
+static constexpr float LIGHT_SPACE_DEPTH_STEP = 2.0f;
+
+void CascadeFitting::computeDepthRange(float readbackMinDepth, float readbackMaxDepth, float near, float maxDistance, float& outMinDepth, float& outMaxDepth)
+{
+	if (!std::isfinite(readbackMinDepth) || !std::isfinite(readbackMaxDepth) || readbackMinDepth <= 0.0f || readbackMinDepth > readbackMaxDepth)
+	{
+		outMinDepth = near;
+		outMaxDepth = maxDistance;
+		return;
+	}
+
+	outMinDepth = glm::clamp(readbackMinDepth * (1.0f - DEPTH_RANGE_MARGIN), near, maxDistance);
+	outMaxDepth = glm::max(glm::min(readbackMaxDepth * (1.0f + DEPTH_RANGE_MARGIN), maxDistance), outMinDepth + MIN_DEPTH_RANGE);
+}
+
+void CascadeFitting::computeSplits(float minDepth, float maxDepth, float logarithmicWeight, std::span<float> outSplits)
+{
+	const uint32_t cascadeCount = static_cast<uint32_t>(outSplits.size());
+	for (uint32_t cascadeIdx = 0; cascadeIdx < cascadeCount; ++cascadeIdx)
+	{
+		const float t = static_cast<float>(cascadeIdx + 1) / static_cast<float>(cascadeCount);
+		const float uniformSplit = glm::mix(minDepth, maxDepth, t);
+		const float logarithmicSplit = minDepth * glm::pow(maxDepth / minDepth, t);
+
+		outSplits[cascadeIdx] = glm::mix(uniformSplit, logarithmicSplit, logarithmicWeight);
+	}
+}
+
+glm::mat4 CascadeFitting::computeLightViewMatrix(const glm::vec3& lightDirection)
+{
+	return glm::lookAt(glm::vec3(0.0f), -lightDirection, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+void CascadeFitting::fitCascade(const ViewFrustum& viewFrustum, float startDepth, float endDepth, const glm::vec3& lightDirection, uint32_t textureSize, CascadeBounds& output)
+{
+	const float tanHalfFOVX = viewFrustum.tanHalfFOVY * viewFrustum.aspect;
+	const glm::mat4 lightView = computeLightViewMatrix(lightDirection);
+	const glm::mat4 viewToLight = lightView * viewFrustum.invViewMatrix;
+
+	// Light space bounds of the 8 corners of the slice
+	glm::vec3 minLightSpace(std::numeric_limits<float>::max());
+	glm::vec3 maxLightSpace(std::numeric_limits<float>::lowest());
+	for (const float depth : { startDepth, endDepth })
+	{
+		for (const float y : { -1.0f, 1.0f })
+		{
+			for (const float x : { -1.0f, 1.0f })
+			{
+				const glm::vec3 corner = viewToLight * glm::vec4(x * tanHalfFOVX * depth, y * viewFrustum.tanHalfFOVY * depth, -depth, 1.0f);
+				minLightSpace = glm::min(minLightSpace, corner);
+				maxLightSpace = glm::max(maxLightSpace, corner);
+			}
+		}
+	}
+
+	float radius = glm::max(maxLightSpace.x - minLightSpace.x, maxLightSpace.y - minLightSpace.y) / 2.0f;
+	radius *= 1.0f + 2.0f * BORDER_TEXEL_COUNT / static_cast<float>(textureSize);
+	radius = glm::ceil(radius / RADIUS_STEP) * RADIUS_STEP;
+
+	glm::vec3 centerLightSpace = (minLightSpace + maxLightSpace) / 2.0f;
+	const float texelPerUnit = static_cast<float>(textureSize) / (radius * 2.0f);
+	centerLightSpace.x = glm::floor(centerLightSpace.x * texelPerUnit) / texelPerUnit;
+	centerLightSpace.y = glm::floor(centerLightSpace.y * texelPerUnit) / texelPerUnit;
+	centerLightSpace.z = glm::floor(centerLightSpace.z / LIGHT_SPACE_DEPTH_STEP) * LIGHT_SPACE_DEPTH_STEP;
+
+	output.center = glm::inverse(lightView) * glm::vec4(centerLightSpace, 1.0f);
+	output.radius = radius;
+	output.lightSpaceCenter = glm::vec2(centerLightSpace);
+	output.lightSpaceMaxZ = maxLightSpace.z;
+}
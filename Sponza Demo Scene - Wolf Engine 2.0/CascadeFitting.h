@@ -0,0 +1,38 @@
+#pragma once
+
+#include <span>
+
+#include <glm/glm.hpp>
+
+// CPU side of the cascade fitting, doesn't depend on Vulkan so it can be checked on its own
+namespace CascadeFitting
+{
+	struct ViewFrustum
+	{
+		glm::mat4 invViewMatrix;
+		float tanHalfFOVY;
+		float aspect; // width / height
+	};
+
+	struct CascadeBounds
+	{
+		glm::vec3 center;
+		float radius;
+
+		// In the space of computeLightViewMatrix(), z grows along the light direction (away from the sun)
+		glm::vec2 lightSpaceCenter;
+		float lightSpaceMaxZ; // farthest receiver from the sun
+	};
+
+	glm::mat4 computeLightViewMatrix(const glm::vec3& lightDirection);
+
+	// Clamps the depth range read back from the GPU, falls back to [near, maxDistance] when the reduction isn't valid (first frames or nothing visible)
+	void computeDepthRange(float readbackMinDepth, float readbackMaxDepth, float near, float maxDistance, float& outMinDepth, float& outMaxDepth);
+
+	// Mix of uniform and logarithmic splits between minDepth and maxDepth, outSplits[i] is the far distance of cascade i
+	void computeSplits(float minDepth, float maxDepth, float logarithmicWeight, std::span<float> outSplits);
+
+	// Fits a square light-space area around the frustum slice between startDepth and endDepth, the center is snapped to texels to avoid shimmering when the camera moves.
+	// Its depth along the light is snapped to a coarser step, the cascade camera only moves along the light when it crosses a step
+	void fitCascade(const ViewFrustum& viewFrustum, float startDepth, float endDepth, const glm::vec3& lightDirection, uint32_t textureSize, CascadeBounds& output);
+}
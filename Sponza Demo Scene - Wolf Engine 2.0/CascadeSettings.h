@@ -0,0 +1,27 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include <vulkan/vulkan_core.h>
+
+// Cascaded shadow maps settings. The count and the depth format are chosen at compile time as they size the uniform buffers, the shader arrays and the shadow pipelines,
+// the resolutions are divided at runtime (GameContext::cascadeResolutionDivisor). Low-end deployments can reduce the count, the resolutions or use 16 bits depth
+namespace CascadeSettings
+{
+	constexpr uint32_t CASCADE_COUNT = 4;
+	constexpr std::array<uint32_t, CASCADE_COUNT> TEXTURE_SIZES = { 3072, 3072, 3072, 3072 };
+	constexpr VkFormat DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+	constexpr uint32_t MAX_RESOLUTION_DIVISOR = 4; // 1 = full, 2 = half, 4 = quarter of TEXTURE_SIZES
+
+	static_assert(CASCADE_COUNT >= 2 && CASCADE_COUNT <= 8, "Cascade count must be between 2 and 8");
+	static_assert(DEPTH_FORMAT == VK_FORMAT_D32_SFLOAT || DEPTH_FORMAT == VK_FORMAT_D16_UNORM, "Cascade depth format must be D32 or D16");
+
+	// Shaders including "cascadedShadowMapping/cascadeCount.glsl" get CASCADES_COUNT from this block
+	inline std::string getCascadeCountShaderBlock() { return "CASCADE_COUNT_" + std::to_string(CASCADE_COUNT); }
+
+	constexpr uint32_t getTextureSize(uint32_t cascadeIdx, uint32_t resolutionDivisor) { return TEXTURE_SIZES[cascadeIdx] / resolutionDivisor; }
+
+	constexpr uint32_t getDepthFormatSize() { return DEPTH_FORMAT == VK_FORMAT_D16_UNORM ? 2 : 4; }
+}
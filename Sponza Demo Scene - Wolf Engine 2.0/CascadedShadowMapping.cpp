@@ -1,43 +1,140 @@
 #include "CascadedShadowMapping.h"
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
 #include <glm/gtx/transform.hpp>
 
 #include <CameraList.h>
+#include <Configuration.h>
+#include <Debug.h>
 #include <DescriptorSetGenerator.h>
 #include <ModelLoader.h>
+#include <Timer.h>
 
+#include "CascadeFitting.h"
 #include "CommonLayout.h"
 #include "DebugMarker.h"
 #include "PreDepthPass.h"
 #include "GameContext.h"
+#include "GPUProfiler.h"
+#include "GraphicCameraInterface.h"
 #include "RenderMeshList.h"
+#include "Vertex2DTextured.h"
 
 using namespace Wolf;
 
+VkDescriptorSetLayout CommonDescriptorLayouts::g_singlePassShadowMapDescriptorSetLayout;
+
+static_assert(std::ranges::all_of(CascadeSettings::TEXTURE_SIZES, [](uint32_t size) { return size % (CascadedShadowMapping::PYRAMID_BLOCK_SIZE * CascadeSettings::MAX_RESOLUTION_DIVISOR) == 0; }),
+	"Cascade sizes must be multiples of the depth pyramid block size at every resolution");
+
 CascadeDepthPass::CascadeDepthPass(const InitializationContext& context, uint32_t width, uint32_t height, const CommandBuffer* commandBuffer, uint32_t cameraIdx) : m_width(width), m_height(height)
 {
 	m_commandBuffer = commandBuffer;
 
+	m_cameraIdx = cameraIdx;
+
 	DepthPassBase::initializeResources(context);
+}
+
+void CascadeDepthPass::recordDraws(const RecordContext& context)
+{
+	const VkCommandBuffer commandBuffer = getCommandBuffer(context);
+
+	// Static casters are copied from the cached depth, the depth test keeps the closest of them and the dynamic casters drawn after
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_staticDepthMergePipeline->getPipeline());
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_staticDepthMergePipeline->getPipelineLayout(), 0, 1, m_staticDepthDescriptorSet->getDescriptorSet(), 0, nullptr);
+	m_fullscreenRect->draw(commandBuffer, RenderMeshList::NO_CAMERA_IDX);
+
+	// The render list can't be filtered per camera, the draws are skipped when the cascade doesn't see any caster
+	if (!m_hasVisibleCasters)
+		return;
+
+	context.renderMeshList->draw(context, commandBuffer, m_renderPass.get(), CommonPipelineIndices::PIPELINE_IDX_SHADOW_MAP, m_cameraIdx, {});
+}
+
+VkCommandBuffer CascadeDepthPass::getCommandBuffer(const RecordContext& context)
+{
+	return m_commandBuffer->getCommandBuffer(context.commandBufferIdx);
+}
+
+void CascadeDepthPass::createStaticDepthMergePipeline(ShaderParser& vertexShaderParser, ShaderParser& fragmentShaderParser, VkDescriptorSetLayout descriptorSetLayout)
+{
+	RenderingPipelineCreateInfo pipelineCreateInfo;
+	pipelineCreateInfo.renderPass = m_renderPass->getRenderPass();
+
+	// Programming stages
+	pipelineCreateInfo.shaderCreateInfos.resize(2);
+	vertexShaderParser.readCompiledShader(pipelineCreateInfo.shaderCreateInfos[0].shaderCode);
+	pipelineCreateInfo.shaderCreateInfos[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	fragmentShaderParser.readCompiledShader(pipelineCreateInfo.shaderCreateInfos[1].shaderCode);
+	pipelineCreateInfo.shaderCreateInfos[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	// IA
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+	Vertex2DTextured::getAttributeDescriptions(attributeDescriptions, 0);
+	pipelineCreateInfo.vertexInputAttributeDescriptions = attributeDescriptions;
+
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+	bindingDescriptions[0] = {};
+	Vertex2DTextured::getBindingDescription(bindingDescriptions[0], 0);
+	pipelineCreateInfo.vertexInputBindingDescriptions = bindingDescriptions;
+
+	// Viewport
+	pipelineCreateInfo.extent = { m_width, m_height };
 
-	m_camera.reset(new OrthographicCamera(glm::vec3(0.0f), 0.0f, 50.0f, glm::vec3(0.0f)));
+	// Resources
+	pipelineCreateInfo.descriptorSetLayouts = { descriptorSetLayout };
+
+	// Depth only
+	pipelineCreateInfo.blendModes = {};
+
+	m_staticDepthMergePipeline.reset(new Pipeline(pipelineCreateInfo));
+}
+
+StaticCascadeDepthPass::StaticCascadeDepthPass(const InitializationContext& context, uint32_t width, uint32_t height, const CommandBuffer* commandBuffer, uint32_t cameraIdx) : m_width(width), m_height(height)
+{
+	m_commandBuffer = commandBuffer;
 	m_cameraIdx = cameraIdx;
+
+	DepthPassBase::initializeResources(context);
 }
 
-void CascadeDepthPass::setCameraInfos(const glm::vec3& center, float radius, const glm::vec3& direction) const
+void StaticCascadeDepthPass::recordDraws(const RecordContext& context)
 {
-	m_camera->setCenter(center);
-	m_camera->setDirection(direction);
-	m_camera->setRadius(radius);
+	if (!m_hasVisibleCasters)
+		return;
+
+	const VkCommandBuffer commandBuffer = getCommandBuffer(context);
+	context.renderMeshList->draw(context, commandBuffer, m_renderPass.get(), CommonPipelineIndices::PIPELINE_IDX_STATIC_SHADOW_MAP, m_cameraIdx, {});
 }
 
-void CascadeDepthPass::recordDraws(const RecordContext& context)
+VkCommandBuffer StaticCascadeDepthPass::getCommandBuffer(const RecordContext& context)
+{
+	return m_commandBuffer->getCommandBuffer(context.commandBufferIdx);
+}
+
+SinglePassCascadeDepthPass::SinglePassCascadeDepthPass(const InitializationContext& context, uint32_t width, uint32_t height, const CommandBuffer* commandBuffer, const DescriptorSet* descriptorSet) : m_width(width), m_height(height)
+{
+	m_commandBuffer = commandBuffer;
+	m_descriptorSet = descriptorSet;
+
+	DepthPassBase::initializeResources(context);
+}
+
+void SinglePassCascadeDepthPass::recordDraws(const RecordContext& context)
 {
+	// Cascade matrices come from the single pass descriptor set, the camera is only bound to match the pipeline layout
 	const VkCommandBuffer commandBuffer = getCommandBuffer(context);
-	context.renderMeshList->draw(context, commandBuffer, m_renderPass.get(), CommonPipelineIndices::PIPELINE_IDX_SHADOW_MAP, m_cameraIdx, {});
+	context.renderMeshList->draw(context, commandBuffer, m_renderPass.get(), CommonPipelineIndices::PIPELINE_IDX_SINGLE_PASS_SHADOW_MAP, CommonCameraIndices::CAMERA_IDX_SHADOW_CASCADE_0,
+		{
+			{ 3, m_descriptorSet }
+		});
 }
 
-VkCommandBuffer CascadeDepthPass::getCommandBuffer(const RecordContext& context)
+VkCommandBuffer SinglePassCascadeDepthPass::getCommandBuffer(const RecordContext& context)
 {
 	return m_commandBuffer->getCommandBuffer(context.commandBufferIdx);
 }
@@ -47,77 +144,215 @@ void CascadedShadowMapping::initializeResources(const InitializationContext& con
 	m_commandBuffer.reset(new CommandBuffer(QueueType::GRAPHIC, false /* isTransient */));
 	m_semaphore.reset(new Semaphore(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT));
 
-	for (uint32_t i = 0; i < m_cascadeDepthPasses.size(); ++i)
+	// Shadow maps don't share the depth format of the main view
+	m_shadowMapContext.reset(new InitializationContext(context));
+	m_shadowMapContext->depthFormat = CascadeSettings::DEPTH_FORMAT;
+
+	for (std::unique_ptr<OrthographicCamera>& cascadeCamera : m_cascadeCameras)
+		cascadeCamera.reset(new OrthographicCamera(glm::vec3(0.0f), 0.0f, 50.0f, glm::vec3(0.0f)));
+
+	// Static depth merge
+	m_staticDepthMergeDescriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 0, 1); // static depth
+	m_staticDepthMergeDescriptorSetLayout.reset(new DescriptorSetLayout(m_staticDepthMergeDescriptorSetLayoutGenerator.getDescriptorLayouts()));
+
+	const std::vector<Vertex2DTextured> vertices =
 	{
-		m_cascadeDepthPasses[i].reset(new CascadeDepthPass(context, m_cascadeTextureSize[i], m_cascadeTextureSize[i], m_commandBuffer.get(), CommonCameraIndices::CAMERA_IDX_SHADOW_CASCADE_0 + i));
-	}
+		{ glm::vec2(-1.0f, -1.0f), glm::vec2(0.0f, 0.0f) }, // top left
+		{ glm::vec2(1.0f, -1.0f), glm::vec2(1.0f, 0.0f) }, // top right
+		{ glm::vec2(-1.0f, 1.0f), glm::vec2(0.0f, 1.0f) }, // bot left
+		{ glm::vec2(1.0f, 1.0f),glm::vec2(1.0f, 1.0f) } // bot right
+	};
+	const std::vector<uint32_t> indices =
+	{
+		0, 2, 1,
+		2, 3, 1
+	};
+	m_fullscreenRect.reset(new Mesh(vertices, indices));
+
+	// Single pass
+	m_singlePassDescriptorSetLayoutGenerator.addUniformBuffer(VK_SHADER_STAGE_GEOMETRY_BIT, 0);
+	m_singlePassDescriptorSetLayout.reset(new DescriptorSetLayout(m_singlePassDescriptorSetLayoutGenerator.getDescriptorLayouts()));
+	CommonDescriptorLayouts::g_singlePassShadowMapDescriptorSetLayout = m_singlePassDescriptorSetLayout->getDescriptorSetLayout();
+
+	m_singlePassUniformBuffer.reset(new Buffer(sizeof(SinglePassUBData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::EACH_FRAME));
+
+	DescriptorSetGenerator singlePassDescriptorSetGenerator(m_singlePassDescriptorSetLayoutGenerator.getDescriptorLayouts());
+	singlePassDescriptorSetGenerator.setBuffer(0, *m_singlePassUniformBuffer);
+	m_singlePassDescriptorSet.reset(new DescriptorSet(m_singlePassDescriptorSetLayout->getDescriptorSetLayout(), UpdateRate::EACH_FRAME));
+	m_singlePassDescriptorSet->update(singlePassDescriptorSetGenerator.getDescriptorSetCreateInfo());
 
-	const float near = 0.1f; // context.camera->getNear();
-	const float far = 50.0f; // context.camera->getFar(); // we don't render shadows on all the range
-	uint32_t cascadeIdx = 0;
-	for (float i(1.0f / CASCADE_COUNT); i <= 1.0f; i += 1.0f / CASCADE_COUNT)
+	// Depth reduction
+	m_depthReductionDescriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0, 1); // input depth
+	m_depthReductionDescriptorSetLayoutGenerator.addStorageBuffer(VK_SHADER_STAGE_COMPUTE_BIT, 1); // depth bounds
+	m_depthReductionDescriptorSetLayout.reset(new DescriptorSetLayout(m_depthReductionDescriptorSetLayoutGenerator.getDescriptorLayouts()));
+
+	m_depthBoundsBuffer.reset(new Buffer(sizeof(DepthBounds), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		UpdateRate::EACH_FRAME));
+	constexpr DepthBounds invalidDepthBounds = { 0xFFFFFFFF, 0 }; // cascades use the full range until the first results are read back
+	for (uint32_t i = 0; i < g_configuration->getMaxCachedFrames(); ++i)
+		m_depthBoundsBuffer->transferCPUMemory(&invalidDepthBounds, sizeof(invalidDepthBounds), 0, i);
+
+	m_depthReductionDescriptorSet.reset(new DescriptorSet(m_depthReductionDescriptorSetLayout->getDescriptorSetLayout(), UpdateRate::EACH_FRAME));
+	updateDepthReductionDescriptorSet();
+
+	// Depth pyramids
+	m_depthPyramidDescriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0, 1); // cascade depth
+	m_depthPyramidDescriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT, 1); // depth pyramid
+	m_depthPyramidDescriptorSetLayoutGenerator.addUniformBuffer(VK_SHADER_STAGE_COMPUTE_BIT, 2);
+	m_depthPyramidDescriptorSetLayout.reset(new DescriptorSetLayout(m_depthPyramidDescriptorSetLayoutGenerator.getDescriptorLayouts()));
+
+	createCascadeStorage(0);
+
+	// Shader compilation and pipeline creation don't use the queue, they run on a worker thread while the next passes are initialized
+	m_pipelineCreation = std::async(std::launch::async, [this]
 	{
-		float d_uni = glm::mix(near, far, i);
-		float d_log = near * glm::pow((far / near), i);
+		Timer timer("Depth reduction pipeline creation");
+		m_depthReductionShaderParser.reset(new ShaderParser("Shaders/cascadedShadowMapping/depthReduction.comp", {}, 1));
+		createDepthReductionPipeline();
 
-		m_cascadeSplits[cascadeIdx] = (glm::mix(d_uni, d_log, 0.5f));
-		cascadeIdx++;
-	}
+		m_depthPyramidShaderParser.reset(new ShaderParser("Shaders/cascadedShadowMapping/shadowMapPyramid.comp"));
+		createDepthPyramidPipeline();
+
+		m_staticDepthMergeVertexShaderParser.reset(new ShaderParser("Shaders/UI.vert"));
+		m_staticDepthMergeFragmentShaderParser.reset(new ShaderParser("Shaders/cascadedShadowMapping/staticDepthMerge.frag"));
+		createStaticDepthMergePipelines();
+	});
 }
 
 void CascadedShadowMapping::resize(const InitializationContext& context)
 {
-	// Nothing to do
+	*m_shadowMapContext = context;
+	m_shadowMapContext->depthFormat = CascadeSettings::DEPTH_FORMAT;
+
+	updateDepthReductionDescriptorSet();
 }
 
 void CascadedShadowMapping::record(const RecordContext& context)
 {
+	waitForPipelineCreation();
+
 	const GameContext* gameContext = static_cast<const GameContext*>(context.gameContext);
 	const CameraInterface* camera = context.cameraList->getCamera(CommonCameraIndices::CAMERA_IDX_ACTIVE);
 
 	/* Update */
-	float lastSplitDist = camera->getNear();
-	for (int cascade(0); cascade < CASCADE_COUNT; ++cascade)
+	// Splits and cascade bounds are fitted to the depth range of the visible pixels (read back from a previous frame)
+	float minDepth, maxDepth;
+	readDepthBounds(context.commandBufferIdx, minDepth, maxDepth);
+	CascadeFitting::computeDepthRange(minDepth, maxDepth, camera->getNear(), MAX_SHADOW_DISTANCE, minDepth, maxDepth);
+	CascadeFitting::computeSplits(minDepth, maxDepth, 0.5f, m_cascadeSplits);
+
+	CascadeFitting::ViewFrustum viewFrustum;
+	viewFrustum.invViewMatrix = glm::inverse(camera->getViewMatrix());
+	viewFrustum.tanHalfFOVY = glm::tan(camera->getFOV() / 2.0f);
+	viewFrustum.aspect = static_cast<float>(context.swapchainImage[0].getExtent().width) / static_cast<float>(context.swapchainImage[0].getExtent().height);
+
+	const glm::mat4 lightViewMatrix = CascadeFitting::computeLightViewMatrix(gameContext->sunDirection);
+	m_shadowCasterCount = m_shadowCasterCulling.getCasterCount();
+
+	releaseRetiredStorages(context.currentFrameIdx);
+	if (gameContext->singlePassCascades != m_isSinglePassUsed || gameContext->cascadeResolutionDivisor != m_resolutionDivisor)
 	{
-		const float startCascade = lastSplitDist;
-		const float endCascade = m_cascadeSplits[cascade];
+		m_isSinglePassUsed = gameContext->singlePassCascades;
+		m_resolutionDivisor = gameContext->cascadeResolutionDivisor;
+		createCascadeStorage(context.currentFrameIdx);
+	}
+	uint32_t singlePassCascadeMask = 0;
+
+	float cascadeStart = minDepth;
+	for (uint32_t cascade = 0; cascade < CASCADE_COUNT; ++cascade)
+	{
+		CascadeFitting::CascadeBounds cascadeBounds;
+		CascadeFitting::fitCascade(viewFrustum, cascadeStart, m_cascadeSplits[cascade], gameContext->sunDirection, m_cascadeTextureSizes[cascade], cascadeBounds);
+		cascadeStart = m_cascadeSplits[cascade];
+		m_staticCascadeStates[cascade].updatedThisFrame = false;
 
-		float radius = (endCascade - startCascade) / 2.0f;
+		uint32_t visibleDynamicCasterCount;
+		m_shadowCasterCulling.cull(lightViewMatrix, cascadeBounds.lightSpaceCenter, cascadeBounds.radius, cascadeBounds.lightSpaceMaxZ, m_visibleShadowCasterCounts[cascade], visibleDynamicCasterCount);
 
-		const float ar = context.swapchainImage[0].getExtent().height / static_cast<float>(context.swapchainImage[0].getExtent().width);
-		const float cosHalfHFOV = glm::cos(camera->getFOV() * (1.0f / ar) / 2.0f);
-		const float b = endCascade / cosHalfHFOV;
-		radius = glm::sqrt(b * b + (startCascade + radius) * (startCascade + radius) - 2.0f * b * startCascade * cosHalfHFOV) * 0.75f;
+		// All cascades share the atlas clear so they are all rendered again
+		if (m_isSinglePassUsed)
+		{
+			setCascadeCamera(cascade, cascadeBounds.center, cascadeBounds.radius, gameContext->sunDirection);
+			m_cascadeStates[cascade] = CascadeState();
+			m_cascadeStates[cascade].updatedThisFrame = true;
+			if (m_visibleShadowCasterCounts[cascade] > 0)
+				singlePassCascadeMask |= 1u << cascade;
+			continue;
+		}
 
-		const float texelPerUnit = static_cast<float>(m_cascadeTextureSize[cascade]) / (radius * 2.0f);
-		glm::mat4 scaleMat = scale(glm::mat4(1.0f), glm::vec3(texelPerUnit));
-		glm::mat4 lookAt = scaleMat * glm::lookAt(glm::vec3(0.0f), -gameContext->sunDirection, glm::vec3(0.0f, 1.0f, 0.0f));
-		glm::mat4 lookAtInv = inverse(lookAt);
+		CascadeState fittedState;
+		fittedState.isValid = true;
+		fittedState.lightDirection = gameContext->sunDirection;
+		fittedState.lightSpaceCenter = cascadeBounds.lightSpaceCenter;
+		fittedState.center = cascadeBounds.center;
+		fittedState.radius = cascadeBounds.radius;
 
-		glm::vec3 frustumCenter = camera->getPosition() + (camera->getOrientation() * startCascade + camera->getOrientation() * endCascade) / 2.0f;
-		frustumCenter = lookAt * glm::vec4(frustumCenter, 1.0f);
-		frustumCenter.x = floor(frustumCenter.x);
-		frustumCenter.y = floor(frustumCenter.y);
-		frustumCenter = lookAtInv * glm::vec4(frustumCenter, 1.0f);
+		// A reused cascade keeps the camera it has been rendered with, so the shadow mask reads it with the matching matrix
+		if (!needsUpdate(cascade, fittedState, visibleDynamicCasterCount, context.currentFrameIdx))
+		{
+			m_cascadeStates[cascade].updatedThisFrame = false;
+			continue;
+		}
 
-		m_cascadeDepthPasses[cascade]->setCameraInfos(frustumCenter, radius, gameContext->sunDirection);
+		setCascadeCamera(cascade, cascadeBounds.center, cascadeBounds.radius, gameContext->sunDirection);
+		m_cascadeDepthPasses[cascade]->setHasVisibleCasters(visibleDynamicCasterCount > 0);
+		m_cascadeStates[cascade] = fittedState;
+		m_cascadeStates[cascade].updatedThisFrame = true;
 
-		lastSplitDist += m_cascadeSplits[cascade];
+		// The static depth is rendered with the same camera, it has to be rendered again as soon as the camera changes (including its depth along the light)
+		const CascadeState& staticState = m_staticCascadeStates[cascade];
+		const bool isStaticDepthValid = staticState.isValid && staticState.lightDirection == fittedState.lightDirection && staticState.center == fittedState.center &&
+			staticState.radius == fittedState.radius;
+		if (!isStaticDepthValid)
+		{
+			m_staticCascadeDepthPasses[cascade]->setHasVisibleCasters(m_visibleShadowCasterCounts[cascade] > visibleDynamicCasterCount);
+			m_staticCascadeStates[cascade] = fittedState;
+			m_staticCascadeStates[cascade].updatedThisFrame = true;
+		}
 	}
+	m_shadowCasterCulling.clear();
+
+	if (m_isSinglePassUsed)
+		updateSinglePassData(singlePassCascadeMask, context.commandBufferIdx);
 
 	/* Command buffer record */
 	m_commandBuffer->beginCommandBuffer(context.commandBufferIdx);
 
-	DebugMarker::beginRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), DebugMarker::renderPassDebugColor, "Cascade shadow maps");
+	GPUProfiler::beginPassRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), DebugMarker::renderPassDebugColor, "Cascade shadow maps", true);
 
-	for (uint32_t i = 0, end = static_cast<uint32_t>(m_cascadeDepthPasses.size()); i < end; ++i)
+	if (m_isSinglePassUsed)
 	{
-		constexpr float color[4] = { 0.4f, 0.4f, 0.4f, 1.0f };
-		DebugMarker::insert(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), color, "Cascade " + std::to_string(i));
-		m_cascadeDepthPasses[i]->record(context);
+		m_singlePassDepthPass->record(context);
 	}
+	else
+	{
+		for (uint32_t i = 0, end = static_cast<uint32_t>(m_cascadeDepthPasses.size()); i < end; ++i)
+		{
+			if (!m_cascadeStates[i].updatedThisFrame)
+				continue;
+
+			constexpr float color[4] = { 0.4f, 0.4f, 0.4f, 1.0f };
+			if (m_staticCascadeStates[i].updatedThisFrame)
+			{
+				DebugMarker::insert(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), color, "Cascade " + std::to_string(i) + " static casters");
+				m_staticCascadeDepthPasses[i]->record(context);
 
-	DebugMarker::endRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
+				VkMemoryBarrier memoryBarrier{};
+				memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+				memoryBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				vkCmdPipelineBarrier(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier,
+					0, nullptr, 0, nullptr);
+			}
+
+			DebugMarker::insert(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), color, "Cascade " + std::to_string(i));
+			m_cascadeDepthPasses[i]->record(context);
+		}
+	}
+
+	GPUProfiler::endPassRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
+
+	recordDepthPyramids(m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
 
 	m_commandBuffer->endCommandBuffer(context.commandBufferIdx);
 }
@@ -127,12 +362,355 @@ void CascadedShadowMapping::submit(const SubmitContext& context)
 	const std::vector<const Semaphore*> waitSemaphores{ };
 	const std::vector<VkSemaphore> signalSemaphores{ m_semaphore->getSemaphore() };
 	m_commandBuffer->submit(context.commandBufferIdx, waitSemaphores, signalSemaphores, VK_NULL_HANDLE);
+
+	if (m_depthReductionShaderParser->compileIfFileHasBeenModified())
+	{
+		vkDeviceWaitIdle(context.device);
+		createDepthReductionPipeline();
+	}
+
+	if (m_staticDepthMergeFragmentShaderParser->compileIfFileHasBeenModified())
+	{
+		vkDeviceWaitIdle(context.device);
+		createStaticDepthMergePipelines();
+	}
+
+	if (m_depthPyramidShaderParser->compileIfFileHasBeenModified())
+	{
+		vkDeviceWaitIdle(context.device);
+		createDepthPyramidPipeline();
+	}
+}
+
+bool CascadedShadowMapping::needsUpdate(uint32_t cascadeIdx, const CascadeState& fittedState, uint32_t visibleDynamicCasterCount, uint32_t frameIdx) const
+{
+	const CascadeState& renderedState = m_cascadeStates[cascadeIdx];
+	if (!renderedState.isValid)
+		return true;
+
+	// Depths in the shadow map are only valid for the sun direction they have been rendered with
+	constexpr float LIGHT_DIRECTION_EPSILON = 1e-5f;
+	if (glm::any(glm::greaterThan(glm::abs(renderedState.lightDirection - fittedState.lightDirection), glm::vec3(LIGHT_DIRECTION_EPSILON))))
+		return true;
+
+	// The rendered area must contain the new slice, otherwise some receivers would sample outside of the shadow map
+	const glm::vec2 centerOffset = glm::abs(fittedState.lightSpaceCenter - renderedState.lightSpaceCenter);
+	if (centerOffset.x + fittedState.radius > renderedState.radius || centerOffset.y + fittedState.radius > renderedState.radius)
+		return true;
+
+	// Same texel grid and nothing moved: rendering would give the same result
+	const bool isSameGrid = fittedState.radius == renderedState.radius && fittedState.lightSpaceCenter == renderedState.lightSpaceCenter;
+	if (isSameGrid && visibleDynamicCasterCount == 0)
+		return false;
+
+	return (frameIdx + cascadeIdx) % getCascadeUpdatePeriod(cascadeIdx) == 0;
+}
+
+void CascadedShadowMapping::getCascadeAtlasScaleOffset(uint32_t cascadeIdx, glm::vec4& output) const
+{
+	const ShadowAtlasLayout::Rect& rect = m_atlasRects[cascadeIdx];
+	const glm::vec2 atlasSize(static_cast<float>(m_atlasWidth), static_cast<float>(m_atlasHeight));
+	output = glm::vec4(glm::vec2(static_cast<float>(rect.size)) / atlasSize, glm::vec2(static_cast<float>(rect.x), static_cast<float>(rect.y)) / atlasSize);
+}
+
+void CascadedShadowMapping::getMemoryReport(MemoryReport& output) const
+{
+	constexpr uint64_t texelSize = CascadeSettings::getDepthFormatSize();
+
+	uint64_t cascadeTexelCount = 0;
+	for (const uint32_t cascadeSize : m_cascadeTextureSizes)
+		cascadeTexelCount += static_cast<uint64_t>(cascadeSize) * cascadeSize;
+
+	output.cascadeBytes = cascadeTexelCount * texelSize;
+	output.staticCacheBytes = cascadeTexelCount * texelSize;
+	output.atlasBytes = static_cast<uint64_t>(m_atlasWidth) * m_atlasHeight * texelSize;
+
+	// RG32F, level 0 and the coarser levels next to it
+	output.depthPyramidBytes = 0;
+	for (const uint32_t cascadeSize : m_cascadeTextureSizes)
+	{
+		const uint64_t level0Size = cascadeSize / PYRAMID_CELL_SIZE;
+		output.depthPyramidBytes += (level0Size + level0Size / 2) * level0Size * 2 * sizeof(float);
+	}
+
+	// Depth pyramids are used by both modes
+	output.allocatedBytes = (m_isSinglePassUsed ? output.atlasBytes : output.cascadeBytes + output.staticCacheBytes) + output.depthPyramidBytes;
+	output.allModesBytes = output.cascadeBytes + output.staticCacheBytes + output.atlasBytes + output.depthPyramidBytes;
+}
+
+void CascadedShadowMapping::updateSinglePassData(uint32_t cascadeMask, uint32_t commandBufferIdx) const
+{
+	const glm::vec2 atlasSize(static_cast<float>(m_atlasWidth), static_cast<float>(m_atlasHeight));
+
+	SinglePassUBData singlePassUBData;
+	for (uint32_t cascadeIdx = 0; cascadeIdx < CASCADE_COUNT; ++cascadeIdx)
+	{
+		getCascadeMatrix(cascadeIdx, singlePassUBData.cascadeMatrices[cascadeIdx]);
+		getCascadeAtlasScaleOffset(cascadeIdx, singlePassUBData.atlasScaleOffsets[cascadeIdx]);
+
+		const glm::vec4& scaleOffset = singlePassUBData.atlasScaleOffsets[cascadeIdx];
+		singlePassUBData.atlasPixelBounds[cascadeIdx] = glm::vec4(glm::vec2(scaleOffset.z, scaleOffset.w) * atlasSize, glm::vec2(scaleOffset.z + scaleOffset.x, scaleOffset.w + scaleOffset.y) * atlasSize);
+	}
+	singlePassUBData.cascadeMask = cascadeMask;
+
+	m_singlePassUniformBuffer->transferCPUMemory(&singlePassUBData, sizeof(singlePassUBData), 0, commandBufferIdx);
 }
 
 void CascadedShadowMapping::addCamerasForThisFrame(Wolf::CameraList& cameraList) const
+{
+	for (uint32_t i = 0; i < CASCADE_COUNT; ++i)
+	{
+		cameraList.addCameraForThisFrame(m_cascadeCameras[i].get(), CommonCameraIndices::CAMERA_IDX_SHADOW_CASCADE_0 + i);
+	}
+}
+
+void CascadedShadowMapping::recordDepthReduction(VkCommandBuffer commandBuffer, const RecordContext& context)
+{
+	waitForPipelineCreation();
+
+	const CameraInterface* camera = context.cameraList->getCamera(CommonCameraIndices::CAMERA_IDX_ACTIVE);
+	const VkBuffer depthBoundsBuffer = m_depthBoundsBuffer->getBuffer(context.commandBufferIdx);
+
+	GPUProfiler::beginPassRegion(commandBuffer, DebugMarker::computePassDebugColor, "Depth reduction", false);
+
+	vkCmdFillBuffer(commandBuffer, depthBoundsBuffer, offsetof(DepthBounds, minLinearDepth), sizeof(uint32_t), 0xFFFFFFFF);
+	vkCmdFillBuffer(commandBuffer, depthBoundsBuffer, offsetof(DepthBounds, maxLinearDepth), sizeof(uint32_t), 0);
+
+	VkBufferMemoryBarrier bufferMemoryBarrier{};
+	bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferMemoryBarrier.buffer = depthBoundsBuffer;
+	bufferMemoryBarrier.offset = 0;
+	bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_depthReductionPipeline->getPipelineLayout(), 0, 1,
+		m_depthReductionDescriptorSet->getDescriptorSet(context.commandBufferIdx), 0, nullptr);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_depthReductionPipeline->getPipelineLayout(), 1, 1,
+		camera->getDescriptorSet()->getDescriptorSet(), 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_depthReductionPipeline->getPipeline());
+
+	const VkExtent3D depthExtent = m_preDepthPass->getOutput()->getExtent();
+	constexpr VkExtent3D dispatchGroups = { 16, 16, 1 };
+	const uint32_t groupSizeX = depthExtent.width % dispatchGroups.width != 0 ? depthExtent.width / dispatchGroups.width + 1 : depthExtent.width / dispatchGroups.width;
+	const uint32_t groupSizeY = depthExtent.height % dispatchGroups.height != 0 ? depthExtent.height / dispatchGroups.height + 1 : depthExtent.height / dispatchGroups.height;
+	vkCmdDispatch(commandBuffer, groupSizeX, groupSizeY, dispatchGroups.depth);
+
+	// Results are read by the CPU once the frame fence of this slot has been waited
+	bufferMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	bufferMemoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+
+	GPUProfiler::endPassRegion(commandBuffer);
+}
+
+void CascadedShadowMapping::createDepthReductionPipeline()
+{
+	std::vector<char> computeShaderCode;
+	m_depthReductionShaderParser->readCompiledShader(computeShaderCode);
+
+	ShaderCreateInfo computeShaderCreateInfo;
+	computeShaderCreateInfo.shaderCode = computeShaderCode;
+	computeShaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts = { m_depthReductionDescriptorSetLayout->getDescriptorSetLayout(), GraphicCameraInterface::getDescriptorSetLayout() };
+	m_depthReductionPipeline.reset(new ComputePipeline(computeShaderCreateInfo, descriptorSetLayouts));
+}
+
+void CascadedShadowMapping::createDepthPyramidPipeline()
+{
+	std::vector<char> computeShaderCode;
+	m_depthPyramidShaderParser->readCompiledShader(computeShaderCode);
+
+	ShaderCreateInfo computeShaderCreateInfo;
+	computeShaderCreateInfo.shaderCode = computeShaderCode;
+	computeShaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts = { m_depthPyramidDescriptorSetLayout->getDescriptorSetLayout() };
+	m_depthPyramidPipeline.reset(new ComputePipeline(computeShaderCreateInfo, descriptorSetLayouts));
+}
+
+void CascadedShadowMapping::recordDepthPyramids(VkCommandBuffer commandBuffer) const
+{
+	// Reused cascades keep their pyramid
+	bool hasUpdatedCascade = false;
+	for (const CascadeState& cascadeState : m_cascadeStates)
+		hasUpdatedCascade |= cascadeState.updatedThisFrame;
+	if (!hasUpdatedCascade)
+		return;
+
+	GPUProfiler::beginPassRegion(commandBuffer, DebugMarker::computePassDebugColor, "Shadow map depth pyramids", true);
+
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_depthPyramidPipeline->getPipeline());
+	for (uint32_t i = 0; i < CASCADE_COUNT; ++i)
+	{
+		if (!m_cascadeStates[i].updatedThisFrame)
+			continue;
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_depthPyramidPipeline->getPipelineLayout(), 0, 1,
+			m_depthPyramidDescriptorSets[i]->getDescriptorSet(), 0, nullptr);
+
+		// One workgroup of 8x8 cells reduces a block of PYRAMID_BLOCK_SIZE texels
+		const uint32_t groupCount = m_cascadeTextureSizes[i] / PYRAMID_BLOCK_SIZE;
+		vkCmdDispatch(commandBuffer, groupCount, groupCount, 1);
+	}
+
+	GPUProfiler::endPassRegion(commandBuffer);
+}
+
+void CascadedShadowMapping::createCascadeStorage(uint32_t frameIdx)
+{
+	if (m_storageVersion > 0)
+	{
+		RetiredStorage& retiredStorage = m_retiredStorages.emplace_back();
+		retiredStorage.retireFrameIdx = frameIdx;
+		retiredStorage.cascadeDepthPasses = std::move(m_cascadeDepthPasses);
+		retiredStorage.staticCascadeDepthPasses = std::move(m_staticCascadeDepthPasses);
+		retiredStorage.staticDepthMergeDescriptorSets = std::move(m_staticDepthMergeDescriptorSets);
+		retiredStorage.singlePassDepthPass = std::move(m_singlePassDepthPass);
+		retiredStorage.depthPyramids = std::move(m_depthPyramids);
+		retiredStorage.depthPyramidUniformBuffers = std::move(m_depthPyramidUniformBuffers);
+		retiredStorage.depthPyramidDescriptorSets = std::move(m_depthPyramidDescriptorSets);
+	}
+
+	for (uint32_t i = 0; i < CASCADE_COUNT; ++i)
+		m_cascadeTextureSizes[i] = CascadeSettings::getTextureSize(i, m_resolutionDivisor);
+	ShadowAtlasLayout::pack(m_cascadeTextureSizes, m_atlasRects, m_atlasWidth, m_atlasHeight);
+
+	if (m_isSinglePassUsed)
+	{
+		m_singlePassDepthPass.reset(new SinglePassCascadeDepthPass(*m_shadowMapContext, m_atlasWidth, m_atlasHeight, m_commandBuffer.get(), m_singlePassDescriptorSet.get()));
+	}
+	else
+	{
+		for (uint32_t i = 0; i < CASCADE_COUNT; ++i)
+		{
+			m_cascadeDepthPasses[i].reset(new CascadeDepthPass(*m_shadowMapContext, m_cascadeTextureSizes[i], m_cascadeTextureSizes[i], m_commandBuffer.get(), CommonCameraIndices::CAMERA_IDX_SHADOW_CASCADE_0 + i));
+			m_staticCascadeDepthPasses[i].reset(new StaticCascadeDepthPass(*m_shadowMapContext, m_cascadeTextureSizes[i], m_cascadeTextureSizes[i], m_commandBuffer.get(), CommonCameraIndices::CAMERA_IDX_SHADOW_CASCADE_0 + i));
+
+			DescriptorSetGenerator descriptorSetGenerator(m_staticDepthMergeDescriptorSetLayoutGenerator.getDescriptorLayouts());
+			DescriptorSetGenerator::ImageDescription staticDepthImageDesc;
+			staticDepthImageDesc.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			staticDepthImageDesc.imageView = m_staticCascadeDepthPasses[i]->getOutput()->getDefaultImageView();
+			descriptorSetGenerator.setImage(0, staticDepthImageDesc);
+
+			m_staticDepthMergeDescriptorSets[i].reset(new DescriptorSet(m_staticDepthMergeDescriptorSetLayout->getDescriptorSetLayout(), UpdateRate::NEVER));
+			m_staticDepthMergeDescriptorSets[i]->update(descriptorSetGenerator.getDescriptorSetCreateInfo());
+
+			m_cascadeDepthPasses[i]->setStaticDepthMerge(m_fullscreenRect.get(), m_staticDepthMergeDescriptorSets[i].get());
+		}
+
+		// Pipelines are created by the worker thread at initialization
+		if (m_staticDepthMergeFragmentShaderParser)
+			createStaticDepthMergePipelines();
+	}
+
+	for (uint32_t i = 0; i < CASCADE_COUNT; ++i)
+	{
+		const uint32_t level0Size = m_cascadeTextureSizes[i] / PYRAMID_CELL_SIZE;
+
+		CreateImageInfo depthPyramidCreateInfo;
+		depthPyramidCreateInfo.extent = { level0Size + level0Size / 2, level0Size, 1 };
+		depthPyramidCreateInfo.format = VK_FORMAT_R32G32_SFLOAT;
+		depthPyramidCreateInfo.mipLevelCount = 1;
+		depthPyramidCreateInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+		depthPyramidCreateInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		m_depthPyramids[i].reset(new Image(depthPyramidCreateInfo));
+		m_depthPyramids[i]->setImageLayout({ VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
+
+		DepthPyramidUBData depthPyramidUBData{};
+		if (m_isSinglePassUsed)
+			depthPyramidUBData.sourceOffset = glm::uvec2(m_atlasRects[i].x, m_atlasRects[i].y);
+		m_depthPyramidUniformBuffers[i].reset(new Buffer(sizeof(DepthPyramidUBData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::NEVER));
+		m_depthPyramidUniformBuffers[i]->transferCPUMemory(&depthPyramidUBData, sizeof(depthPyramidUBData), 0);
+
+		DescriptorSetGenerator descriptorSetGenerator(m_depthPyramidDescriptorSetLayoutGenerator.getDescriptorLayouts());
+		DescriptorSetGenerator::ImageDescription sourceImageDesc;
+		sourceImageDesc.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		sourceImageDesc.imageView = m_isSinglePassUsed ? m_singlePassDepthPass->getOutput()->getDefaultImageView() : m_cascadeDepthPasses[i]->getOutput()->getDefaultImageView();
+		descriptorSetGenerator.setImage(0, sourceImageDesc);
+		DescriptorSetGenerator::ImageDescription depthPyramidImageDesc;
+		depthPyramidImageDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		depthPyramidImageDesc.imageView = m_depthPyramids[i]->getDefaultImageView();
+		descriptorSetGenerator.setImage(1, depthPyramidImageDesc);
+		descriptorSetGenerator.setBuffer(2, *m_depthPyramidUniformBuffers[i]);
+
+		m_depthPyramidDescriptorSets[i].reset(new DescriptorSet(m_depthPyramidDescriptorSetLayout->getDescriptorSetLayout(), UpdateRate::NEVER));
+		m_depthPyramidDescriptorSets[i]->update(descriptorSetGenerator.getDescriptorSetCreateInfo());
+	}
+
+	// New images are empty, every cascade is rendered again
+	m_cascadeStates = {};
+	m_staticCascadeStates = {};
+	m_storageVersion++;
+
+	MemoryReport memoryReport;
+	getMemoryReport(memoryReport);
+	Debug::sendInfo("Shadow maps VRAM at 1/" + std::to_string(m_resolutionDivisor) + " resolution: " + std::to_string((memoryReport.cascadeBytes + memoryReport.staticCacheBytes + memoryReport.depthPyramidBytes) >> 20) +
+		" MB with separate cascades, " + std::to_string((memoryReport.atlasBytes + memoryReport.depthPyramidBytes) >> 20) + " MB with the " + std::to_string(m_atlasWidth) + "x" + std::to_string(m_atlasHeight) +
+		" atlas, " + std::to_string(memoryReport.allModesBytes >> 20) + " MB if both were allocated");
+}
+
+void CascadedShadowMapping::releaseRetiredStorages(uint32_t frameIdx)
+{
+	// The last frame reading a retired storage is the one before it has been retired, its slot is reused after maxCachedFrames frames
+	std::erase_if(m_retiredStorages, [frameIdx](const RetiredStorage& retiredStorage) { return frameIdx - retiredStorage.retireFrameIdx >= g_configuration->getMaxCachedFrames(); });
+}
+
+void CascadedShadowMapping::setCascadeCamera(uint32_t cascadeIdx, const glm::vec3& center, float radius, const glm::vec3& direction) const
+{
+	m_cascadeCameras[cascadeIdx]->setCenter(center);
+	m_cascadeCameras[cascadeIdx]->setDirection(direction);
+	m_cascadeCameras[cascadeIdx]->setRadius(radius);
+}
+
+void CascadedShadowMapping::createStaticDepthMergePipelines()
 {
 	for (const std::unique_ptr<CascadeDepthPass>& cascade : m_cascadeDepthPasses)
 	{
-		cascade->addCameraForThisFrame(cameraList);
+		if (!cascade) // single pass mode
+			continue;
+
+		cascade->createStaticDepthMergePipeline(*m_staticDepthMergeVertexShaderParser, *m_staticDepthMergeFragmentShaderParser, m_staticDepthMergeDescriptorSetLayout->getDescriptorSetLayout());
 	}
 }
+
+void CascadedShadowMapping::waitForPipelineCreation()
+{
+	if (m_pipelineCreation.valid())
+		m_pipelineCreation.get();
+}
+
+void CascadedShadowMapping::updateDepthReductionDescriptorSet() const
+{
+	DescriptorSetGenerator descriptorSetGenerator(m_depthReductionDescriptorSetLayoutGenerator.getDescriptorLayouts());
+
+	DescriptorSetGenerator::ImageDescription preDepthImageDesc;
+	preDepthImageDesc.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	preDepthImageDesc.imageView = m_preDepthPass->getOutput()->getDefaultImageView();
+	descriptorSetGenerator.setImage(0, preDepthImageDesc);
+	descriptorSetGenerator.setBuffer(1, *m_depthBoundsBuffer);
+
+	m_depthReductionDescriptorSet->update(descriptorSetGenerator.getDescriptorSetCreateInfo());
+}
+
+void CascadedShadowMapping::readDepthBounds(uint32_t commandBufferIdx, float& outMinDepth, float& outMaxDepth) const
+{
+	DepthBounds depthBounds;
+	const void* mappedData = m_depthBoundsBuffer->map(commandBufferIdx);
+	memcpy(&depthBounds, mappedData, sizeof(depthBounds));
+	m_depthBoundsBuffer->unmap(commandBufferIdx);
+
+	outMinDepth = std::bit_cast<float>(depthBounds.minLinearDepth);
+	outMaxDepth = std::bit_cast<float>(depthBounds.maxLinearDepth);
+}
@@ -1,13 +1,26 @@
 #pragma once
 
+#include <future>
+
+#include <Buffer.h>
 #include <CommandBuffer.h>
 #include <CommandRecordBase.h>
 #include <DepthPassBase.h>
+#include <DescriptorSet.h>
+#include <DescriptorSetLayout.h>
+#include <DescriptorSetLayoutGenerator.h>
 #include <Image.h>
+#include <Mesh.h>
+#include <Pipeline.h>
+#include <ResourceUniqueOwner.h>
 #include <ShaderParser.h>
 
 #include "CameraList.h"
+#include "CascadeSettings.h"
+#include "ShadowAtlasLayout.h"
 #include "OrthographicCamera.h"
+#include "PipelineCache.h"
+#include "ShadowCasterCulling.h"
 
 class SceneElements;
 class PreDepthPass;
@@ -18,10 +31,41 @@ public:
 	CascadeDepthPass(const Wolf::InitializationContext& context, uint32_t width, uint32_t height, const Wolf::CommandBuffer* commandBuffer, uint32_t cameraIdx);
 	CascadeDepthPass(const CascadeDepthPass&) = delete;
 
-	void getViewProjMatrix(glm::mat4& output) const { output = m_camera->getProjectionMatrix() * m_camera->getViewMatrix(); }
-	void setCameraInfos(const glm::vec3& center, float radius, const glm::vec3& direction) const;
+	void setHasVisibleCasters(bool hasVisibleCasters) { m_hasVisibleCasters = hasVisibleCasters; } // dynamic casters only, static ones come from the cached depth
+
+	void setStaticDepthMerge(const Wolf::Mesh* fullscreenRect, const Wolf::DescriptorSet* staticDepthDescriptorSet) { m_fullscreenRect = fullscreenRect; m_staticDepthDescriptorSet = staticDepthDescriptorSet; }
+	void createStaticDepthMergePipeline(Wolf::ShaderParser& vertexShaderParser, Wolf::ShaderParser& fragmentShaderParser, VkDescriptorSetLayout descriptorSetLayout);
+
+private:
+	uint32_t getWidth() override { return m_width; }
+	uint32_t getHeight() override { return m_height; }
+
+	void recordDraws(const Wolf::RecordContext& context) override;
+	VkCommandBuffer getCommandBuffer(const Wolf::RecordContext& context) override;
+	VkImageUsageFlags getAdditionalUsages() override { return VK_IMAGE_USAGE_SAMPLED_BIT; }
+	VkImageLayout getFinalLayout() override { return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; }
+
+	/* Shared resources */
+	const Wolf::CommandBuffer* m_commandBuffer;
+	const Wolf::Mesh* m_fullscreenRect = nullptr;
+	const Wolf::DescriptorSet* m_staticDepthDescriptorSet = nullptr;
+
+	/* Owned resources */
+	uint32_t m_cameraIdx;
+	uint32_t m_width, m_height;
+	bool m_hasVisibleCasters = true;
+	std::unique_ptr<Wolf::Pipeline> m_staticDepthMergePipeline;
+};
 
-	void addCameraForThisFrame(Wolf::CameraList& cameraList) const { cameraList.addCameraForThisFrame(m_camera.get(), m_cameraIdx); }
+// Static casters of a cascade, only rendered again when the cascade matrix changes.
+// Uses the camera of the matching CascadeDepthPass
+class StaticCascadeDepthPass : public Wolf::DepthPassBase
+{
+public:
+	StaticCascadeDepthPass(const Wolf::InitializationContext& context, uint32_t width, uint32_t height, const Wolf::CommandBuffer* commandBuffer, uint32_t cameraIdx);
+	StaticCascadeDepthPass(const StaticCascadeDepthPass&) = delete;
+
+	void setHasVisibleCasters(bool hasVisibleCasters) { m_hasVisibleCasters = hasVisibleCasters; }
 
 private:
 	uint32_t getWidth() override { return m_width; }
@@ -36,31 +80,215 @@ private:
 	const Wolf::CommandBuffer* m_commandBuffer;
 
 	/* Owned resources */
-	std::unique_ptr<Wolf::OrthographicCamera> m_camera;
 	uint32_t m_cameraIdx;
 	uint32_t m_width, m_height;
+	bool m_hasVisibleCasters = true;
+};
+
+// Every cascade in a packed atlas with a single draw per mesh, a geometry shader sends each triangle to the cascades it overlaps.
+// The engine render passes don't support multiview or layered framebuffers, the atlas gives the same fan-out in a single 2D depth target
+class SinglePassCascadeDepthPass : public Wolf::DepthPassBase
+{
+public:
+	SinglePassCascadeDepthPass(const Wolf::InitializationContext& context, uint32_t width, uint32_t height, const Wolf::CommandBuffer* commandBuffer, const Wolf::DescriptorSet* descriptorSet);
+	SinglePassCascadeDepthPass(const SinglePassCascadeDepthPass&) = delete;
+
+private:
+	uint32_t getWidth() override { return m_width; }
+	uint32_t getHeight() override { return m_height; }
+
+	void recordDraws(const Wolf::RecordContext& context) override;
+	VkCommandBuffer getCommandBuffer(const Wolf::RecordContext& context) override;
+	VkImageUsageFlags getAdditionalUsages() override { return VK_IMAGE_USAGE_SAMPLED_BIT; }
+	VkImageLayout getFinalLayout() override { return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; }
+
+	/* Shared resources */
+	const Wolf::CommandBuffer* m_commandBuffer;
+	const Wolf::DescriptorSet* m_descriptorSet;
+
+	/* Owned resources */
+	uint32_t m_width;
+	uint32_t m_height;
 };
 
 class CascadedShadowMapping : public Wolf::CommandRecordBase
 {
 public:
-	static constexpr int CASCADE_COUNT = 4;
+	static constexpr uint32_t CASCADE_COUNT = CascadeSettings::CASCADE_COUNT;
+
+	// Min/max depth of each cell of PYRAMID_CELL_SIZE texels, coarser levels are on the right of the first one (see shadowMapPyramid.comp).
+	// The shadow mask skips filtering when the whole kernel footprint is in front of or behind the receiver
+	static constexpr uint32_t PYRAMID_CELL_SIZE = 8;
+	static constexpr uint32_t PYRAMID_LEVEL_COUNT = 4;
+	static constexpr uint32_t PYRAMID_BLOCK_SIZE = PYRAMID_CELL_SIZE << (PYRAMID_LEVEL_COUNT - 1); // texels reduced by a workgroup
+
+	CascadedShadowMapping(const Wolf::ResourceNonOwner<PreDepthPass>& preDepthPass) : m_preDepthPass(preDepthPass) {}
 
 	void initializeResources(const Wolf::InitializationContext& context) override;
 	void resize(const Wolf::InitializationContext& context) override;
 	void record(const Wolf::RecordContext& context) override;
 	void submit(const Wolf::SubmitContext& context) override;
 
-	Wolf::Image* getShadowMap(uint32_t cascadeIdx) const { return m_cascadeDepthPasses[cascadeIdx]->getOutput(); }
 	float getCascadeSplit(uint32_t cascadeIdx) const { return m_cascadeSplits[cascadeIdx]; }
-	void getCascadeMatrix(uint32_t cascadeIdx, glm::mat4& output) const { m_cascadeDepthPasses[cascadeIdx]->getViewProjMatrix(output); }
-	uint32_t getCascadeTextureSize(uint32_t cascadeIdx) const { return m_cascadeTextureSize[cascadeIdx]; }
+	void getCascadeMatrix(uint32_t cascadeIdx, glm::mat4& output) const { output = m_cascadeCameras[cascadeIdx]->getProjectionMatrix() * m_cascadeCameras[cascadeIdx]->getViewMatrix(); }
+	uint32_t getCascadeTextureSize(uint32_t cascadeIdx) const { return m_cascadeTextureSizes[cascadeIdx]; } // of the allocated images
+
+	// Cascades of the last recorded frame are in the atlas when the single pass mode is used.
+	// Only the images of the current mode are allocated: the separate shadow maps are nullptr in the single pass mode and the atlas is nullptr otherwise
+	bool isSinglePassUsed() const { return m_isSinglePassUsed; }
+	Wolf::Image* getShadowMap(uint32_t cascadeIdx) const { return m_cascadeDepthPasses[cascadeIdx] ? m_cascadeDepthPasses[cascadeIdx]->getOutput() : nullptr; }
+	Wolf::Image* getShadowAtlas() const { return m_singlePassDepthPass ? m_singlePassDepthPass->getOutput() : nullptr; }
+	void getCascadeAtlasScaleOffset(uint32_t cascadeIdx, glm::vec4& output) const;
+	uint32_t getStorageVersion() const { return m_storageVersion; } // changes each time the images are recreated, the previous ones stay valid for the frames in flight
+
+	// In cascade texels whatever the mode, rebuilt each time the cascade is rendered
+	Wolf::Image* getDepthPyramid(uint32_t cascadeIdx) const { return m_depthPyramids[cascadeIdx].get(); }
+
+	struct MemoryReport
+	{
+		uint64_t cascadeBytes; // separate shadow maps of the multi pass mode
+		uint64_t staticCacheBytes; // multi pass mode only
+		uint64_t atlasBytes; // single pass mode only
+		uint64_t depthPyramidBytes;
+		uint64_t allocatedBytes; // total of the current mode
+		uint64_t allModesBytes; // total if the images of both modes were allocated
+	};
+	void getMemoryReport(MemoryReport& output) const;
 
 	void addCamerasForThisFrame(Wolf::CameraList& cameraList) const;
+	// Whole models, a cascade seeing none of them skips its draws
+	void addShadowCasterForThisFrame(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& transform, bool isDynamic) { m_shadowCasterCulling.addCaster(localMin, localMax, transform, isDynamic); }
+
+	// Statistics of the last recorded frame
+	uint32_t getShadowCasterCount() const { return m_shadowCasterCount; }
+	uint32_t getVisibleShadowCasterCount(uint32_t cascadeIdx) const { return m_visibleShadowCasterCounts[cascadeIdx]; }
+	bool isCascadeUpdated(uint32_t cascadeIdx) const { return m_cascadeStates[cascadeIdx].updatedThisFrame; }
+	bool isStaticDepthUpdated(uint32_t cascadeIdx) const { return m_staticCascadeStates[cascadeIdx].updatedThisFrame; }
+
+	// Min/max depth of the visible pixels, used to fit the cascades of the next frames.
+	// Recorded by the shadow mask pass as it already waits for the pre-depth pass
+	void recordDepthReduction(VkCommandBuffer commandBuffer, const Wolf::RecordContext& context);
 
 private:
+	void createDepthReductionPipeline();
+	void createDepthPyramidPipeline();
+	void recordDepthPyramids(VkCommandBuffer commandBuffer) const;
+	void createCascadeStorage(uint32_t frameIdx);
+	void releaseRetiredStorages(uint32_t frameIdx);
+	void setCascadeCamera(uint32_t cascadeIdx, const glm::vec3& center, float radius, const glm::vec3& direction) const;
+	void createStaticDepthMergePipelines();
+	void updateSinglePassData(uint32_t cascadeMask, uint32_t commandBufferIdx) const;
+	void waitForPipelineCreation();
+	void updateDepthReductionDescriptorSet() const;
+	void readDepthBounds(uint32_t commandBufferIdx, float& outMinDepth, float& outMaxDepth) const;
+
+	static constexpr float MAX_SHADOW_DISTANCE = 50.0f;
+
+	struct CascadeState
+	{
+		bool isValid = false; // false until the cascade is rendered once
+		glm::vec3 lightDirection;
+		glm::vec2 lightSpaceCenter;
+		glm::vec3 center; // of the cascade camera, also gives its depth along the light
+		float radius;
+		bool updatedThisFrame = false;
+	};
+	bool needsUpdate(uint32_t cascadeIdx, const CascadeState& fittedState, uint32_t visibleDynamicCasterCount, uint32_t frameIdx) const;
+
+	Wolf::ResourceNonOwner<PreDepthPass> m_preDepthPass;
+
 	/* Cascades */
-	uint32_t m_cascadeTextureSize[CASCADE_COUNT] = { 3072, 3072, 3072, 3072 };
-	std::array<std::unique_ptr<CascadeDepthPass>, CASCADE_COUNT> m_cascadeDepthPasses;
+	// Cameras are kept when the mode changes, the single pass mode reads their matrices too
+	std::array<std::unique_ptr<Wolf::OrthographicCamera>, CASCADE_COUNT> m_cascadeCameras;
+	std::array<std::unique_ptr<CascadeDepthPass>, CASCADE_COUNT> m_cascadeDepthPasses; // multi pass mode only
 	std::array<float, CASCADE_COUNT> m_cascadeSplits{};
+
+	/* Storage */
+	// Separate shadow maps and static caches or atlas, following the mode. They're recreated with the depth pyramids when the mode or the resolution changes
+	std::unique_ptr<Wolf::InitializationContext> m_shadowMapContext;
+	uint32_t m_resolutionDivisor = 1; // of the allocated images
+	std::array<uint32_t, CASCADE_COUNT> m_cascadeTextureSizes{};
+	// Frames in flight may still read the previous images, they're released once these frames are done instead of waiting for the device
+	struct RetiredStorage
+	{
+		uint32_t retireFrameIdx;
+		std::array<std::unique_ptr<CascadeDepthPass>, CASCADE_COUNT> cascadeDepthPasses;
+		std::array<std::unique_ptr<StaticCascadeDepthPass>, CASCADE_COUNT> staticCascadeDepthPasses;
+		std::array<std::unique_ptr<Wolf::DescriptorSet>, CASCADE_COUNT> staticDepthMergeDescriptorSets;
+		std::unique_ptr<SinglePassCascadeDepthPass> singlePassDepthPass;
+		std::array<std::unique_ptr<Wolf::Image>, CASCADE_COUNT> depthPyramids;
+		std::array<std::unique_ptr<Wolf::Buffer>, CASCADE_COUNT> depthPyramidUniformBuffers;
+		std::array<std::unique_ptr<Wolf::DescriptorSet>, CASCADE_COUNT> depthPyramidDescriptorSets;
+	};
+	std::vector<RetiredStorage> m_retiredStorages;
+	uint32_t m_storageVersion = 0;
+
+	/* Update policy */
+	// Far cascades cover more area per texel so they are refreshed less often (1, 1, 2, 4, 4...), updates are staggered between cascades
+	static constexpr uint32_t getCascadeUpdatePeriod(uint32_t cascadeIdx) { return cascadeIdx < 2 ? 1 : (cascadeIdx == 2 ? 2 : 4); }
+	std::array<CascadeState, CASCADE_COUNT> m_cascadeStates; // as rendered in the shadow maps
+
+	/* Static casters cache */
+	// Static casters are rendered once per cascade matrix, each cascade update copies them with a fullscreen draw before drawing the dynamic casters
+	std::array<std::unique_ptr<StaticCascadeDepthPass>, CASCADE_COUNT> m_staticCascadeDepthPasses;
+	std::array<CascadeState, CASCADE_COUNT> m_staticCascadeStates; // as rendered in the static depth
+	std::unique_ptr<Wolf::Mesh> m_fullscreenRect;
+	std::unique_ptr<Wolf::ShaderParser> m_staticDepthMergeVertexShaderParser;
+	std::unique_ptr<Wolf::ShaderParser> m_staticDepthMergeFragmentShaderParser;
+	Wolf::DescriptorSetLayoutGenerator m_staticDepthMergeDescriptorSetLayoutGenerator;
+	std::unique_ptr<Wolf::DescriptorSetLayout> m_staticDepthMergeDescriptorSetLayout;
+	std::array<std::unique_ptr<Wolf::DescriptorSet>, CASCADE_COUNT> m_staticDepthMergeDescriptorSets;
+
+	/* Single pass */
+	bool m_isSinglePassUsed = false; // mode of the allocated images
+	std::array<ShadowAtlasLayout::Rect, CASCADE_COUNT> m_atlasRects{}; // pixels
+	uint32_t m_atlasWidth = 0;
+	uint32_t m_atlasHeight = 0;
+	std::unique_ptr<SinglePassCascadeDepthPass> m_singlePassDepthPass; // single pass mode only
+	Wolf::DescriptorSetLayoutGenerator m_singlePassDescriptorSetLayoutGenerator;
+	std::unique_ptr<Wolf::DescriptorSetLayout> m_singlePassDescriptorSetLayout;
+	std::unique_ptr<Wolf::DescriptorSet> m_singlePassDescriptorSet;
+	struct SinglePassUBData
+	{
+		std::array<glm::mat4, CASCADE_COUNT> cascadeMatrices;
+		std::array<glm::vec4, CASCADE_COUNT> atlasScaleOffsets; // uv space
+		std::array<glm::vec4, CASCADE_COUNT> atlasPixelBounds; // min xy, max xy
+
+		uint32_t cascadeMask; // cascades with at least one visible caster
+	};
+	std::unique_ptr<Wolf::Buffer> m_singlePassUniformBuffer;
+
+	/* Caster culling */
+	ShadowCasterCulling m_shadowCasterCulling;
+	uint32_t m_shadowCasterCount = 0;
+	std::array<uint32_t, CASCADE_COUNT> m_visibleShadowCasterCounts{};
+
+	/* Depth reduction */
+	std::unique_ptr<Wolf::ShaderParser> m_depthReductionShaderParser;
+	std::unique_ptr<ComputePipeline> m_depthReductionPipeline;
+	std::future<void> m_pipelineCreation;
+	Wolf::DescriptorSetLayoutGenerator m_depthReductionDescriptorSetLayoutGenerator;
+	std::unique_ptr<Wolf::DescriptorSetLayout> m_depthReductionDescriptorSetLayout;
+	std::unique_ptr<Wolf::DescriptorSet> m_depthReductionDescriptorSet;
+	struct DepthBounds
+	{
+		uint32_t minLinearDepth; // float bits
+		uint32_t maxLinearDepth;
+	};
+	std::unique_ptr<Wolf::Buffer> m_depthBoundsBuffer; // one per frame in flight, read back by the CPU when the slot is reused
+
+	/* Depth pyramids */
+	std::array<std::unique_ptr<Wolf::Image>, CASCADE_COUNT> m_depthPyramids;
+	std::unique_ptr<Wolf::ShaderParser> m_depthPyramidShaderParser;
+	std::unique_ptr<ComputePipeline> m_depthPyramidPipeline;
+	Wolf::DescriptorSetLayoutGenerator m_depthPyramidDescriptorSetLayoutGenerator;
+	std::unique_ptr<Wolf::DescriptorSetLayout> m_depthPyramidDescriptorSetLayout;
+	struct DepthPyramidUBData
+	{
+		glm::uvec2 sourceOffset; // cascade position in the source depth image
+		glm::uvec2 padding;
+	};
+	// Separate shadow map or atlas as source, created with the images they read
+	std::array<std::unique_ptr<Wolf::Buffer>, CASCADE_COUNT> m_depthPyramidUniformBuffers;
+	std::array<std::unique_ptr<Wolf::DescriptorSet>, CASCADE_COUNT> m_depthPyramidDescriptorSets;
 };
\ No newline at end of file
@@ -5,6 +5,8 @@
 namespace CommonDescriptorLayouts
 {
 	extern VkDescriptorSetLayout g_commonForwardDescriptorSetLayout;
+	extern VkDescriptorSetLayout g_singlePassShadowMapDescriptorSetLayout;
+	extern VkDescriptorSetLayout g_virtualShadowMapPagesDescriptorSetLayout;
 }
 
 namespace CommonCameraIndices
@@ -13,12 +15,15 @@ namespace CommonCameraIndices
 	constexpr uint32_t CAMERA_IDX_SHADOW_CASCADE_0  = 1; // make sure to keep cascade idx in the same order
 	constexpr uint32_t CAMERA_IDX_SHADOW_CASCADE_1  = 2;
 	constexpr uint32_t CAMERA_IDX_SHADOW_CASCADE_2  = 3;
-	constexpr uint32_t CAMERA_IDX_SHADOW_CASCADE_3  = 4;
+	constexpr uint32_t CAMERA_IDX_SHADOW_CASCADE_3  = 4; // cascade i uses CAMERA_IDX_SHADOW_CASCADE_0 + i, up to CascadeSettings::CASCADE_COUNT
 }
 
 namespace CommonPipelineIndices
 {
-	constexpr uint32_t PIPELINE_IDX_PRE_DEPTH  = 0;
-	constexpr uint32_t PIPELINE_IDX_SHADOW_MAP = 1;
-	constexpr uint32_t PIPELINE_IDX_FORWARD    = 2;
+	constexpr uint32_t PIPELINE_IDX_PRE_DEPTH              = 0;
+	constexpr uint32_t PIPELINE_IDX_SHADOW_MAP             = 1; // dynamic models, rendered in the cascades each update
+	constexpr uint32_t PIPELINE_IDX_FORWARD                = 2;
+	constexpr uint32_t PIPELINE_IDX_STATIC_SHADOW_MAP      = 3; // static models, rendered in the cached cascade depth
+	constexpr uint32_t PIPELINE_IDX_SINGLE_PASS_SHADOW_MAP = 4; // every model, all cascades in one draw
+	constexpr uint32_t PIPELINE_IDX_VIRTUAL_SHADOW_MAP_PAGES = 5; // every model, all virtual shadow map pages rendered this frame in one draw
 }
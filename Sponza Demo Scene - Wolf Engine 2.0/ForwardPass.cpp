@@ -4,6 +4,7 @@
 
 #include <Attachment.h>
 #include <CameraList.h>
+#include <Configuration.h>
 #include <DebugMarker.h>
 #include <DescriptorSetGenerator.h>
 #include <Image.h>
@@ -14,6 +15,7 @@
 #include "CommonLayout.h"
 #include "PreDepthPass.h"
 #include "GameContext.h"
+#include "GPUProfiler.h"
 #include "ShadowMaskComputePass.h"
 #include "Vertex2DTextured.h"
 #include "RenderMeshList.h"
@@ -23,8 +25,8 @@ using namespace Wolf;
 
 VkDescriptorSetLayout CommonDescriptorLayouts::g_commonForwardDescriptorSetLayout;
 
-ForwardPass::ForwardPass(const ResourceNonOwner<PreDepthPass>& preDepthPass, const Wolf::ResourceNonOwner<ShadowMaskBasePass>& shadowMaskPass, const Wolf::ResourceNonOwner<RTGIPass>& rayTracedGIPass)
-	: m_preDepthPass(preDepthPass), m_shadowMaskPass(shadowMaskPass), m_rayTracedGIPass(rayTracedGIPass)
+ForwardPass::ForwardPass(const ResourceNonOwner<PreDepthPass>& preDepthPass, const std::vector<ResourceNonOwner<ShadowMaskBasePass>>& shadowMaskPasses, const Wolf::ResourceNonOwner<RTGIPass>& rayTracedGIPass)
+	: m_preDepthPass(preDepthPass), m_outputImages(g_configuration->getMaxCachedFrames()), m_shadowMaskPasses(shadowMaskPasses), m_rayTracedGIPass(rayTracedGIPass)
 {
 	m_preDepthPassSemaphore = preDepthPass->getSemaphore();
 }
@@ -59,13 +61,10 @@ void ForwardPass::initializeResources(const InitializationContext& context)
 
 	createDescriptorSetLayout();
 
-	m_userInterfaceVertexShaderParser.reset(new ShaderParser("Shaders/UI.vert"));
-	m_userInterfaceFragmentShaderParser.reset(new ShaderParser("Shaders/UI.frag"));
-
 	// Object resources
 	{
 		m_sampler.reset(new Sampler(VK_SAMPLER_ADDRESS_MODE_REPEAT, 11, VK_FILTER_LINEAR));
-		m_lightUniformBuffer.reset(new Buffer(sizeof(LightUBData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::NEVER));
+		m_lightUniformBuffer.reset(new Buffer(sizeof(LightUBData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::EACH_FRAME));
 
 		createDescriptorSets(true);
 	}
@@ -97,9 +96,18 @@ void ForwardPass::initializeResources(const InitializationContext& context)
 		};
 
 		m_fullscreenRect.reset(new Mesh(vertices, indices));
+
+		createOrUpdateDebugDescriptorSets();
 	}
 
-	createUIPipeline(context.swapChainWidth, context.swapChainHeight);
+	// Shader compilation and pipeline creation don't use the queue, they run on a worker thread while the next passes are initialized
+	m_pipelineCreation = std::async(std::launch::async, [this, width = context.swapChainWidth, height = context.swapChainHeight]
+	{
+		Timer timer("UI pipeline creation");
+		m_userInterfaceVertexShaderParser.reset(new ShaderParser("Shaders/UI.vert"));
+		m_userInterfaceFragmentShaderParser.reset(new ShaderParser("Shaders/UI.frag"));
+		createUIPipeline(width, height);
+	});
 }
 
 void ForwardPass::resize(const Wolf::InitializationContext& context)
@@ -126,8 +134,10 @@ void ForwardPass::resize(const Wolf::InitializationContext& context)
 		m_frameBuffers[i].reset(new Framebuffer(m_renderPass->getRenderPass(), { depth, color, velocity }));
 	}
 
+	waitForPipelineCreation();
 	createUIPipeline(context.swapChainWidth, context.swapChainHeight);
 	createDescriptorSets(false);
+	createOrUpdateDebugDescriptorSets();
 
 	DescriptorSetGenerator descriptorSetGenerator(m_drawFullScreenImageDescriptorSetLayoutGenerator.getDescriptorLayouts());
 	descriptorSetGenerator.setCombinedImageSampler(0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, context.userInterfaceImage->getDefaultImageView(), *m_sampler);
@@ -136,29 +146,33 @@ void ForwardPass::resize(const Wolf::InitializationContext& context)
 
 void ForwardPass::record(const Wolf::RecordContext& context)
 {
+	waitForPipelineCreation();
+
 	const GameContext* gameContext = static_cast<const GameContext*>(context.gameContext);
-	const uint32_t currentMaskIdx = context.currentFrameIdx % ShadowMaskComputePass::MASK_COUNT;
+	const uint32_t currentMaskIdx = context.currentFrameIdx % ShadowMaskBasePass::getMaskCount();
+	const bool isShadowMaskUpsampled = gameContext->shadowMaskResolutionDivisor > 1; // same choice as the shadow mask pass this frame
+	Image* usedDebugImage = getUsedDebugImage();
 	const CameraInterface* camera = context.cameraList->getCamera(CommonCameraIndices::CAMERA_IDX_ACTIVE);
 
 	LightUBData lightUBData;
 	lightUBData.colorDirectionalLight = gameContext->sunColor;
 	lightUBData.directionDirectionalLight = glm::transpose(glm::inverse(camera->getViewMatrix())) * glm::vec4(gameContext->sunDirection, 1.0f);
 	lightUBData.outputSize = glm::uvec2(m_preDepthPass->getOutput()->getExtent().width, m_preDepthPass->getOutput()->getExtent().height);
-	m_lightUniformBuffer->transferCPUMemory(&lightUBData, sizeof(lightUBData), 0 /* srcOffet */);
+	m_lightUniformBuffer->transferCPUMemory(&lightUBData, sizeof(lightUBData), 0 /* srcOffet */, context.commandBufferIdx);
 
 	/* Command buffer record */
 	const uint32_t frameBufferIdx = context.currentFrameIdx % m_outputImages.size();
 
 	m_commandBuffer->beginCommandBuffer(context.commandBufferIdx);
 
-	DebugMarker::beginRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), DebugMarker::renderPassDebugColor, "Forward pass");
+	GPUProfiler::beginPassRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), DebugMarker::renderPassDebugColor, "Forward pass", true);
 
 	m_preDepthPass->getOutput()->setImageLayoutWithoutOperation(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL); // at this point, preDepthPass should have set layout with render pass
 	m_preDepthPass->getOutput()->transitionImageLayout(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
 		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT });
 
-	if (m_usedDebugImage)
-		m_usedDebugImage->transitionImageLayout(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), Image::SampledInFragmentShader(0));
+	if (usedDebugImage)
+		usedDebugImage->transitionImageLayout(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), Image::SampledInFragmentShader(0));
 
 	std::vector<VkClearValue> clearValues(3);
 	clearValues[0] = { 0.0f };
@@ -168,7 +182,7 @@ void ForwardPass::record(const Wolf::RecordContext& context)
 
 	context.renderMeshList->draw(context, m_commandBuffer->getCommandBuffer(context.commandBufferIdx), m_renderPass.get(), CommonPipelineIndices::PIPELINE_IDX_FORWARD, CommonCameraIndices::CAMERA_IDX_ACTIVE,
 		{
-			{ 3, m_descriptorSets[currentMaskIdx].get() }
+			{ 3, m_descriptorSets[m_currentShadowMaskPassIdx][isShadowMaskUpsampled][currentMaskIdx].get() }
 		});
 
 	/* UI and debug */
@@ -178,26 +192,26 @@ void ForwardPass::record(const Wolf::RecordContext& context)
 		m_userInterfaceDescriptorSet->getDescriptorSet(), 0, nullptr);
 	m_fullscreenRect->draw(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), RenderMeshList::NO_CAMERA_IDX);
 
-	if (m_usedDebugImage)
+	if (usedDebugImage)
 	{
 		vkCmdBindDescriptorSets(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_BIND_POINT_GRAPHICS, m_drawFullScreenImagePipeline->getPipelineLayout(), 0, 1,
-			m_debugDescriptorSet->getDescriptorSet(), 0, nullptr);
+			m_debugDescriptorSets[m_currentShadowMaskPassIdx]->getDescriptorSet(), 0, nullptr);
 		m_fullscreenRect->draw(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), RenderMeshList::NO_CAMERA_IDX);
 	}
 
 	m_renderPass->endRenderPass(m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
 
-	if (m_usedDebugImage)
-		m_usedDebugImage->transitionImageLayout(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), { VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
+	if (usedDebugImage)
+		usedDebugImage->transitionImageLayout(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), { VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
 
-	DebugMarker::endRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
+	GPUProfiler::endPassRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
 
 	m_commandBuffer->endCommandBuffer(context.commandBufferIdx);
 }
 
 void ForwardPass::submit(const SubmitContext& context)
 {
-	const std::vector waitSemaphores{ m_shadowMaskPass->getSemaphore(), context.userInterfaceImageAvailableSemaphore };
+	const std::vector waitSemaphores{ m_shadowMaskPasses[m_currentShadowMaskPassIdx]->getSemaphore(), context.userInterfaceImageAvailableSemaphore };
 	const std::vector signalSemaphores{ m_semaphore->getSemaphore() };
 	m_commandBuffer->submit(context.commandBufferIdx, waitSemaphores, signalSemaphores, VK_NULL_HANDLE);
 
@@ -214,27 +228,17 @@ void ForwardPass::submit(const SubmitContext& context)
 	}
 }
 
-void ForwardPass::setShadowMaskPass(const ResourceNonOwner<ShadowMaskBasePass>& shadowMaskPass)
+void ForwardPass::setDebugMode(DebugMode debugMode)
 {
-	m_shadowMaskPass = shadowMaskPass;
-	createDescriptorSetLayout();
-	createDescriptorSets(true);
+	m_debugMode = debugMode;
 }
 
-void ForwardPass::setDebugMode(DebugMode debugMode)
+Image* ForwardPass::getUsedDebugImage() const
 {
-	switch (debugMode)
-	{
-		case DebugMode::None:
-			m_usedDebugImage = nullptr;
-			break;
-		case DebugMode::Shadows:
-			m_usedDebugImage = m_shadowMaskPass->getDebugImage();
-			break;
-	}
+	if (m_debugMode == DebugMode::Shadows)
+		return m_shadowMaskPasses[m_currentShadowMaskPassIdx]->getDebugImage();
 
-	if (m_usedDebugImage)
-		createOrUpdateDebugDescriptorSet();
+	return nullptr;
 }
 
 void ForwardPass::createOutputImages(uint32_t width, uint32_t height)
@@ -306,58 +310,66 @@ void ForwardPass::createUIPipeline(uint32_t width, uint32_t height)
 	m_swapChainHeight = height;
 }
 
+void ForwardPass::waitForPipelineCreation()
+{
+	if (m_pipelineCreation.valid())
+		m_pipelineCreation.get();
+}
+
 void ForwardPass::createDescriptorSetLayout()
 {
 	m_descriptorSetLayoutGenerator.reset();
 	m_descriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_FRAGMENT_BIT, 3); // shadow mask
 	m_descriptorSetLayoutGenerator.addUniformBuffer(VK_SHADER_STAGE_FRAGMENT_BIT, 4); // light ub
-	m_descriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 5, 1); // depth buffer
-	if (m_shadowMaskPass->getDenoisingPatternImage())
-	{
-		m_descriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 6, 1); // denoising sampling pattern	
-	}
 	m_descriptorSetLayout.reset(new DescriptorSetLayout(m_descriptorSetLayoutGenerator.getDescriptorLayouts()));
 	CommonDescriptorLayouts::g_commonForwardDescriptorSetLayout = m_descriptorSetLayout->getDescriptorSetLayout();
 }
 
 void ForwardPass::createDescriptorSets(bool forceReset)
 {
-	DescriptorSetGenerator descriptorSetGenerator(m_descriptorSetLayoutGenerator.getDescriptorLayouts());
-	
-	DescriptorSetGenerator::ImageDescription shadowMaskDesc;
-	descriptorSetGenerator.setBuffer(4, *m_lightUniformBuffer);
-
-	DescriptorSetGenerator::ImageDescription depthBufferDescription;
-	depthBufferDescription.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	depthBufferDescription.imageView = m_preDepthPass->getCopy()->getDefaultImageView();
-	descriptorSetGenerator.setImages(5, { depthBufferDescription });
-
-	if(Image* denoisingPatternImage = m_shadowMaskPass->getDenoisingPatternImage())
+	m_descriptorSets.resize(m_shadowMaskPasses.size());
+	for (uint32_t shadowMaskPassIdx = 0; shadowMaskPassIdx < m_shadowMaskPasses.size(); ++shadowMaskPassIdx)
 	{
-		DescriptorSetGenerator::ImageDescription denoisingPatternTextureDescription;
-		denoisingPatternTextureDescription.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-		denoisingPatternTextureDescription.imageView = denoisingPatternImage->getDefaultImageView();
-		descriptorSetGenerator.setImages(6, { denoisingPatternTextureDescription });
-	}
+		const ResourceNonOwner<ShadowMaskBasePass>& shadowMaskPass = m_shadowMaskPasses[shadowMaskPassIdx];
 
-	for (uint32_t i = 0; i < ShadowMaskComputePass::MASK_COUNT; ++i)
-	{
-		shadowMaskDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-		shadowMaskDesc.imageView = m_shadowMaskPass->getOutput(i)->getDefaultImageView();
-		descriptorSetGenerator.setImage(3, shadowMaskDesc);
+		DescriptorSetGenerator descriptorSetGenerator(m_descriptorSetLayoutGenerator.getDescriptorLayouts());
 
-		if (!m_descriptorSets[i] || forceReset)
-			m_descriptorSets[i].reset(new DescriptorSet(m_descriptorSetLayout->getDescriptorSetLayout(), UpdateRate::NEVER));
-		m_descriptorSets[i]->update(descriptorSetGenerator.getDescriptorSetCreateInfo());
+		DescriptorSetGenerator::ImageDescription shadowMaskDesc;
+		descriptorSetGenerator.setBuffer(4, *m_lightUniformBuffer);
+
+		for (uint32_t upsampled = 0; upsampled < m_descriptorSets[shadowMaskPassIdx].size(); ++upsampled)
+		{
+			m_descriptorSets[shadowMaskPassIdx][upsampled].resize(ShadowMaskBasePass::getMaskCount());
+			for (uint32_t i = 0; i < ShadowMaskBasePass::getMaskCount(); ++i)
+			{
+				shadowMaskDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+				shadowMaskDesc.imageView = shadowMaskPass->getOutput(i, upsampled)->getDefaultImageView();
+				descriptorSetGenerator.setImage(3, shadowMaskDesc);
+
+				std::unique_ptr<DescriptorSet>& descriptorSet = m_descriptorSets[shadowMaskPassIdx][upsampled][i];
+				if (!descriptorSet || forceReset)
+					descriptorSet.reset(new DescriptorSet(m_descriptorSetLayout->getDescriptorSetLayout(), UpdateRate::EACH_FRAME));
+				descriptorSet->update(descriptorSetGenerator.getDescriptorSetCreateInfo());
+			}
+		}
 	}
 }
 
-void ForwardPass::createOrUpdateDebugDescriptorSet()
+void ForwardPass::createOrUpdateDebugDescriptorSets()
 {
-	DescriptorSetGenerator debugDescriptorSetGenerator(m_drawFullScreenImageDescriptorSetLayoutGenerator.getDescriptorLayouts());
-	debugDescriptorSetGenerator.setCombinedImageSampler(0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_usedDebugImage->getDefaultImageView(), *m_sampler);
+	m_debugDescriptorSets.resize(m_shadowMaskPasses.size());
+	for (uint32_t shadowMaskPassIdx = 0; shadowMaskPassIdx < m_shadowMaskPasses.size(); ++shadowMaskPassIdx)
+	{
+		Image* debugImage = m_shadowMaskPasses[shadowMaskPassIdx]->getDebugImage();
+		if (!debugImage)
+			continue;
+
+		DescriptorSetGenerator debugDescriptorSetGenerator(m_drawFullScreenImageDescriptorSetLayoutGenerator.getDescriptorLayouts());
+		debugDescriptorSetGenerator.setCombinedImageSampler(0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, debugImage->getDefaultImageView(), *m_sampler);
 
-	if (!m_debugDescriptorSet)
-		m_debugDescriptorSet.reset(new DescriptorSet(m_drawFullScreenImageDescriptorSetLayout->getDescriptorSetLayout(), UpdateRate::NEVER));
-	m_debugDescriptorSet->update(debugDescriptorSetGenerator.getDescriptorSetCreateInfo());
+		std::unique_ptr<DescriptorSet>& debugDescriptorSet = m_debugDescriptorSets[shadowMaskPassIdx];
+		if (!debugDescriptorSet)
+			debugDescriptorSet.reset(new DescriptorSet(m_drawFullScreenImageDescriptorSetLayout->getDescriptorSetLayout(), UpdateRate::NEVER));
+		debugDescriptorSet->update(debugDescriptorSetGenerator.getDescriptorSetCreateInfo());
+	}
 }
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <future>
 #include <glm/glm.hpp>
 #include <vector>
 
@@ -26,7 +28,8 @@ class SceneElements;
 class ForwardPass : public Wolf::CommandRecordBase
 {
 public:
-	ForwardPass(const Wolf::ResourceNonOwner<PreDepthPass>& preDepthPass, const Wolf::ResourceNonOwner<ShadowMaskBasePass>& shadowMaskPass, const Wolf::ResourceNonOwner<RTGIPass>& rayTracedGIPass);
+	// Descriptor sets are created for every shadow mask pass so that switching between them doesn't need to wait for the GPU
+	ForwardPass(const Wolf::ResourceNonOwner<PreDepthPass>& preDepthPass, const std::vector<Wolf::ResourceNonOwner<ShadowMaskBasePass>>& shadowMaskPasses, const Wolf::ResourceNonOwner<RTGIPass>& rayTracedGIPass);
 
 	void initializeResources(const Wolf::InitializationContext& context) override;
 	void resize(const Wolf::InitializationContext& context) override;
@@ -37,7 +40,7 @@ public:
 	Wolf::ResourceNonOwner<Wolf::Image> getOutputImage(uint32_t idx) { return m_outputImages[idx].createNonOwnerResource(); }
 	Wolf::ResourceNonOwner<Wolf::Image> getVelocityImage() { return m_velocityImage.createNonOwnerResource(); }
 	
-	void setShadowMaskPass(const Wolf::ResourceNonOwner<ShadowMaskBasePass>& shadowMaskPass);
+	void setShadowMaskPassIdx(uint32_t shadowMaskPassIdx) { m_currentShadowMaskPassIdx = shadowMaskPassIdx; }
 
 	enum class DebugMode { None, Shadows, RTGI };
 	void setDebugMode(DebugMode debugMode);
@@ -45,20 +48,23 @@ public:
 private:
 	void createOutputImages(uint32_t width, uint32_t height);
 	void createUIPipeline(uint32_t width, uint32_t height);
+	void waitForPipelineCreation();
 	void createDescriptorSetLayout();
 	void createDescriptorSets(bool forceReset);
-	void createOrUpdateDebugDescriptorSet();
+	void createOrUpdateDebugDescriptorSets();
+	Wolf::Image* getUsedDebugImage() const;
 
 private:
 	std::unique_ptr<Wolf::RenderPass> m_renderPass;
 	Wolf::ResourceNonOwner<PreDepthPass> m_preDepthPass;
 	
-	std::array<Wolf::ResourceUniqueOwner<Wolf::Image>, 2> m_outputImages;
+	std::vector<Wolf::ResourceUniqueOwner<Wolf::Image>> m_outputImages; // one per frame in flight, TAA reads the previous one as history
 	Wolf::ResourceUniqueOwner<Wolf::Image> m_velocityImage;
 	std::vector<std::unique_ptr<Wolf::Framebuffer>> m_frameBuffers;
 	
 	const Wolf::Semaphore* m_preDepthPassSemaphore;
-	Wolf::ResourceNonOwner<ShadowMaskBasePass> m_shadowMaskPass;
+	std::vector<Wolf::ResourceNonOwner<ShadowMaskBasePass>> m_shadowMaskPasses;
+	uint32_t m_currentShadowMaskPassIdx = 0;
 	Wolf::ResourceNonOwner<RTGIPass> m_rayTracedGIPass;
 
 	/* Pipeline */
@@ -66,6 +72,7 @@ private:
 	std::unique_ptr<Wolf::ShaderParser> m_userInterfaceFragmentShaderParser;
 	
 	std::unique_ptr<Wolf::Pipeline> m_drawFullScreenImagePipeline;
+	std::future<void> m_pipelineCreation;
 	uint32_t m_swapChainWidth;
 	uint32_t m_swapChainHeight;
 
@@ -86,13 +93,13 @@ private:
 
 	std::unique_ptr<Wolf::DescriptorSetLayout> m_descriptorSetLayout;
 	Wolf::DescriptorSetLayoutGenerator m_descriptorSetLayoutGenerator;
-	std::array<std::unique_ptr<Wolf::DescriptorSet>, ShadowMaskBasePass::MASK_COUNT> m_descriptorSets;
+	std::vector<std::array<std::vector<std::unique_ptr<Wolf::DescriptorSet>>, 2>> m_descriptorSets; // [shadow mask pass][upsampled][mask], reduced masks are read upsampled
 
 	/* UI and debug resources */
 	Wolf::DescriptorSetLayoutGenerator m_drawFullScreenImageDescriptorSetLayoutGenerator;
 	std::unique_ptr<Wolf::DescriptorSetLayout> m_drawFullScreenImageDescriptorSetLayout;
 	std::unique_ptr<Wolf::DescriptorSet> m_userInterfaceDescriptorSet;
-	std::unique_ptr<Wolf::DescriptorSet> m_debugDescriptorSet;
+	std::vector<std::unique_ptr<Wolf::DescriptorSet>> m_debugDescriptorSets; // per shadow mask pass, null if it doesn't have debug image
 	std::unique_ptr<Wolf::Mesh> m_fullscreenRect;
-	Wolf::Image* m_usedDebugImage;
+	DebugMode m_debugMode = DebugMode::None;
 };
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "FrameTimeTracker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include <Debug.h>
+
+using namespace Wolf;
+
+FrameTimeTracker::FrameTimeTracker()
+{
+	for (std::atomic<float>& frameTime : m_frameTimesInMs)
+		frameTime.store(0.0f, std::memory_order_relaxed);
+}
+
+void FrameTimeTracker::addFrame(float frameTimeInMs)
+{
+	const uint64_t writtenFrameCount = m_writtenFrameCount.load(std::memory_order_relaxed);
+	m_frameTimesInMs[writtenFrameCount % CAPACITY].store(frameTimeInMs, std::memory_order_relaxed);
+	m_writtenFrameCount.store(writtenFrameCount + 1, std::memory_order_release);
+}
+
+void FrameTimeTracker::computeStatistics(Statistics& output) const
+{
+	output = {};
+
+	std::array<float, CAPACITY> frameTimes;
+	const uint32_t sampleCount = copyLatestFrameTimes(frameTimes);
+	if (sampleCount == 0)
+		return;
+
+	output.sampleCount = sampleCount;
+
+	float totalTimeInMs = 0.0f;
+	float totalJitterInMs = 0.0f;
+	for (uint32_t i = 0; i < sampleCount; ++i)
+	{
+		totalTimeInMs += frameTimes[i];
+		if (i > 0)
+			totalJitterInMs += std::abs(frameTimes[i] - frameTimes[i - 1]);
+	}
+	output.averageFPS = totalTimeInMs > 0.0f ? 1000.0f * static_cast<float>(sampleCount) / totalTimeInMs : 0.0f;
+	output.jitterInMs = sampleCount > 1 ? totalJitterInMs / static_cast<float>(sampleCount - 1) : 0.0f;
+
+	std::sort(frameTimes.begin(), frameTimes.begin() + sampleCount);
+	auto percentile = [&frameTimes, sampleCount](float p)
+	{
+		const uint32_t idx = std::min(static_cast<uint32_t>(std::ceil(p * static_cast<float>(sampleCount))), sampleCount) - 1;
+		return frameTimes[idx];
+	};
+	output.p50InMs = percentile(0.50f);
+	output.p95InMs = percentile(0.95f);
+	output.p99InMs = percentile(0.99f);
+	output.maxInMs = frameTimes[sampleCount - 1];
+
+	const float hitchThreshold = 2.0f * output.p50InMs;
+	output.hitchCount = static_cast<uint32_t>(frameTimes.begin() + sampleCount - std::upper_bound(frameTimes.begin(), frameTimes.begin() + sampleCount, hitchThreshold));
+}
+
+void FrameTimeTracker::dumpToFile(const std::string& filename) const
+{
+	std::array<float, CAPACITY> frameTimes;
+	const uint32_t sampleCount = copyLatestFrameTimes(frameTimes);
+
+	std::ofstream outFile(filename);
+	if (!outFile.is_open())
+	{
+		Debug::sendError("Can't open frame time output file " + filename);
+		return;
+	}
+
+	outFile << "frame,frameTimeMs\n";
+	for (uint32_t i = 0; i < sampleCount; ++i)
+		outFile << i << "," << frameTimes[i] << "\n";
+
+	Statistics statistics;
+	computeStatistics(statistics);
+	Debug::sendInfo("Frame times over the last " + std::to_string(statistics.sampleCount) + " frames: p50 " + std::to_string(statistics.p50InMs) + " ms, p95 " + std::to_string(statistics.p95InMs) +
+		" ms, p99 " + std::to_string(statistics.p99InMs) + " ms, max " + std::to_string(statistics.maxInMs) + " ms, " + std::to_string(statistics.hitchCount) + " hitches");
+}
+
+uint32_t FrameTimeTracker::copyLatestFrameTimes(std::array<float, CAPACITY>& output) const
+{
+	// Oldest entries may be overwritten while copying, this only affects the first values of the window
+	const uint64_t writtenFrameCount = m_writtenFrameCount.load(std::memory_order_acquire);
+	const uint32_t sampleCount = static_cast<uint32_t>(std::min<uint64_t>(writtenFrameCount, CAPACITY));
+	const uint64_t firstFrame = writtenFrameCount - sampleCount;
+	for (uint32_t i = 0; i < sampleCount; ++i)
+		output[i] = m_frameTimesInMs[(firstFrame + i) % CAPACITY].load(std::memory_order_relaxed);
+
+	return sampleCount;
+}
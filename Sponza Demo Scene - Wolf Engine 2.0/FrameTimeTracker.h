@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string>
+
+class FrameTimeTracker
+{
+public:
+	FrameTimeTracker();
+
+	// Single producer (main loop), statistics can be computed from any thread without locking
+	void addFrame(float frameTimeInMs);
+
+	struct Statistics
+	{
+		uint32_t sampleCount;
+		float averageFPS;
+		float p50InMs;
+		float p95InMs;
+		float p99InMs;
+		float maxInMs;
+		float jitterInMs; // mean absolute difference between consecutive frame times
+		uint32_t hitchCount; // frames taking more than twice the median
+	};
+	void computeStatistics(Statistics& output) const;
+
+	void dumpToFile(const std::string& filename) const;
+
+private:
+	static constexpr uint32_t CAPACITY = 1024;
+
+	uint32_t copyLatestFrameTimes(std::array<float, CAPACITY>& output) const;
+
+	std::array<std::atomic<float>, CAPACITY> m_frameTimesInMs;
+	std::atomic<uint64_t> m_writtenFrameCount = 0;
+};
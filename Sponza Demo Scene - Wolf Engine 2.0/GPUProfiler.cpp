@@ -0,0 +1,220 @@
+#include "GPUProfiler.h"
+
+#include <algorithm>
+
+#include <DebugMarker.h>
+#include <Debug.h>
+#include <Vulkan.h>
+
+using namespace Wolf;
+
+GPUProfiler* g_gpuProfiler = nullptr;
+
+GPUProfiler::GPUProfiler(bool collectPipelineStatistics, uint32_t maxFramesInFlight) : m_maxFramesInFlight(maxFramesInFlight)
+{
+	if (maxFramesInFlight >= QUERY_SLOT_COUNT)
+		Debug::sendWarning("GPU profiler has " + std::to_string(QUERY_SLOT_COUNT) + " query slots per region which is not enough for " + std::to_string(maxFramesInFlight) + " frames in flight, timings will be dropped");
+
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(g_vulkanInstance->getPhysicalDevice(), &physicalDeviceProperties);
+	m_timestampPeriodInNs = physicalDeviceProperties.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo queryPoolCreateInfo{};
+	queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCreateInfo.queryCount = MAX_REGION_COUNT * QUERY_SLOT_COUNT * 2;
+	if (vkCreateQueryPool(g_vulkanInstance->getDevice(), &queryPoolCreateInfo, nullptr, &m_timestampQueryPool) != VK_SUCCESS)
+		Debug::sendError("Failed to create timestamp query pool");
+
+	if (collectPipelineStatistics)
+	{
+		// Requires the pipelineStatisticsQuery device feature
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+		queryPoolCreateInfo.queryCount = MAX_REGION_COUNT * QUERY_SLOT_COUNT;
+		queryPoolCreateInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+		if (vkCreateQueryPool(g_vulkanInstance->getDevice(), &queryPoolCreateInfo, nullptr, &m_pipelineStatisticsQueryPool) != VK_SUCCESS)
+		{
+			Debug::sendWarning("Pipeline statistics queries are not available, only timings will be collected");
+			m_pipelineStatisticsQueryPool = VK_NULL_HANDLE;
+		}
+	}
+
+	m_regions.reserve(MAX_REGION_COUNT);
+}
+
+GPUProfiler::~GPUProfiler()
+{
+	vkDestroyQueryPool(g_vulkanInstance->getDevice(), m_timestampQueryPool, nullptr);
+	if (m_pipelineStatisticsQueryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(g_vulkanInstance->getDevice(), m_pipelineStatisticsQueryPool, nullptr);
+}
+
+void GPUProfiler::beginPassRegion(VkCommandBuffer commandBuffer, const float* color, const std::string& name, bool isGraphicsQueue)
+{
+	DebugMarker::beginRegion(commandBuffer, color, name);
+	if (g_gpuProfiler)
+		g_gpuProfiler->beginRegion(commandBuffer, name, isGraphicsQueue);
+}
+
+void GPUProfiler::endPassRegion(VkCommandBuffer commandBuffer)
+{
+	if (g_gpuProfiler)
+		g_gpuProfiler->endRegion(commandBuffer);
+	DebugMarker::endRegion(commandBuffer);
+}
+
+void GPUProfiler::collectResults()
+{
+	// The engine waits for the fence of frame N - maxFramesInFlight before recording frame N.
+	// Before that, the availability bits of a reused slot may still be the ones of its previous use
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const uint32_t currentFrameIdx = m_frameIdx++;
+
+	for (Region& region : m_regions)
+	{
+		const uint32_t regionIdx = static_cast<uint32_t>(&region - m_regions.data());
+		for (uint32_t slot = 0; slot < QUERY_SLOT_COUNT; ++slot)
+		{
+			if (!region.pendingSlots[slot] || region.slotFrameIndices[slot] + m_maxFramesInFlight > currentFrameIdx)
+				continue;
+
+			// Each query is followed by its availability value
+			std::array<uint64_t, 4> timestamps{};
+			const uint32_t firstQuery = (regionIdx * QUERY_SLOT_COUNT + slot) * 2;
+			vkGetQueryPoolResults(g_vulkanInstance->getDevice(), m_timestampQueryPool, firstQuery, 2, sizeof(timestamps), timestamps.data(), 2 * sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+			if (timestamps[1] == 0 || timestamps[3] == 0)
+				continue; // the frame has completed so this shouldn't happen, try again next frame
+
+			std::array<uint64_t, static_cast<size_t>(PipelineStatistic::COUNT) + 1> pipelineStatistics{};
+			if (region.slotsWithPipelineStatistics[slot])
+			{
+				vkGetQueryPoolResults(g_vulkanInstance->getDevice(), m_pipelineStatisticsQueryPool, regionIdx * QUERY_SLOT_COUNT + slot, 1, sizeof(pipelineStatistics), pipelineStatistics.data(),
+					sizeof(pipelineStatistics), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+				if (pipelineStatistics.back() == 0)
+					continue;
+
+				region.hasPipelineStatistics = true;
+				std::copy_n(pipelineStatistics.begin(), region.lastPipelineStatistics.size(), region.lastPipelineStatistics.begin());
+			}
+
+			region.pendingSlots[slot] = false;
+
+			region.lastTimeInMs = static_cast<float>(static_cast<double>(timestamps[2] - timestamps[0]) * m_timestampPeriodInNs / 1'000'000.0);
+			region.history[region.historyNextIdx] = region.lastTimeInMs;
+			region.historyNextIdx = (region.historyNextIdx + 1) % HISTORY_SIZE;
+			region.historyCount = std::min(region.historyCount + 1, HISTORY_SIZE);
+		}
+	}
+}
+
+void GPUProfiler::getResults(std::vector<RegionResult>& output) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	output.clear();
+	output.reserve(m_regions.size());
+	for (const Region& region : m_regions)
+	{
+		RegionResult& result = output.emplace_back();
+		result.name = region.name;
+		result.lastTimeInMs = region.lastTimeInMs;
+		result.averageTimeInMs = 0.0f;
+		result.maxTimeInMs = 0.0f;
+		for (uint32_t i = 0; i < region.historyCount; ++i)
+		{
+			result.averageTimeInMs += region.history[i];
+			result.maxTimeInMs = std::max(result.maxTimeInMs, region.history[i]);
+		}
+		if (region.historyCount > 0)
+			result.averageTimeInMs /= static_cast<float>(region.historyCount);
+		result.hasPipelineStatistics = region.hasPipelineStatistics;
+		result.lastPipelineStatistics = region.lastPipelineStatistics;
+	}
+}
+
+void GPUProfiler::beginRegion(VkCommandBuffer commandBuffer, const std::string& name, bool isGraphicsQueue)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const uint32_t regionIdx = getOrCreateRegionForThisFrame(name);
+	if (regionIdx == MAX_REGION_COUNT)
+	{
+		m_openedRegions.push_back({ commandBuffer, regionIdx, 0, false });
+		return;
+	}
+
+	Region& region = m_regions[regionIdx];
+	region.lastBeginFrameIdx = m_frameIdx;
+	const uint32_t slot = region.nextSlot;
+	region.nextSlot = (region.nextSlot + 1) % QUERY_SLOT_COUNT;
+	region.pendingSlots[slot] = false; // results not read in time are dropped
+	region.slotFrameIndices[slot] = m_frameIdx;
+
+	// Graphics statistics can only be queried on a queue supporting graphics operations
+	const bool collectsPipelineStatistics = isGraphicsQueue && m_pipelineStatisticsQueryPool != VK_NULL_HANDLE;
+	region.slotsWithPipelineStatistics[slot] = collectsPipelineStatistics;
+
+	const uint32_t firstQuery = (regionIdx * QUERY_SLOT_COUNT + slot) * 2;
+	vkCmdResetQueryPool(commandBuffer, m_timestampQueryPool, firstQuery, 2);
+	if (collectsPipelineStatistics)
+	{
+		vkCmdResetQueryPool(commandBuffer, m_pipelineStatisticsQueryPool, regionIdx * QUERY_SLOT_COUNT + slot, 1);
+		vkCmdBeginQuery(commandBuffer, m_pipelineStatisticsQueryPool, regionIdx * QUERY_SLOT_COUNT + slot, 0);
+	}
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampQueryPool, firstQuery);
+
+	m_openedRegions.push_back({ commandBuffer, regionIdx, slot, collectsPipelineStatistics });
+}
+
+void GPUProfiler::endRegion(VkCommandBuffer commandBuffer)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Last region opened on this command buffer, regions of other command buffers may have been opened since
+	const auto openedRegionIt = std::find_if(m_openedRegions.rbegin(), m_openedRegions.rend(), [commandBuffer](const OpenedRegion& openedRegion) { return openedRegion.commandBuffer == commandBuffer; });
+	if (openedRegionIt == m_openedRegions.rend())
+	{
+		Debug::sendError("GPU profiler region ended without being started");
+		return;
+	}
+
+	const OpenedRegion openedRegion = *openedRegionIt;
+	m_openedRegions.erase(std::next(openedRegionIt).base());
+	if (openedRegion.regionIdx == MAX_REGION_COUNT)
+		return;
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampQueryPool, (openedRegion.regionIdx * QUERY_SLOT_COUNT + openedRegion.slot) * 2 + 1);
+	if (openedRegion.collectsPipelineStatistics)
+		vkCmdEndQuery(commandBuffer, m_pipelineStatisticsQueryPool, openedRegion.regionIdx * QUERY_SLOT_COUNT + openedRegion.slot);
+
+	m_regions[openedRegion.regionIdx].pendingSlots[openedRegion.slot] = true;
+}
+
+uint32_t GPUProfiler::getOrCreateRegion(const std::string& name)
+{
+	for (uint32_t i = 0; i < m_regions.size(); ++i)
+	{
+		if (m_regions[i].name == name)
+			return i;
+	}
+
+	if (m_regions.size() == MAX_REGION_COUNT)
+	{
+		Debug::sendWarning("Too many GPU profiler regions, " + name + " won't be profiled");
+		return MAX_REGION_COUNT;
+	}
+
+	m_regions.emplace_back().name = name;
+	return static_cast<uint32_t>(m_regions.size() - 1);
+}
+
+uint32_t GPUProfiler::getOrCreateRegionForThisFrame(const std::string& name)
+{
+	// Query slots of a region are sized for one use per frame, a second use in the same frame would reuse a slot still read by a frame in flight
+	uint32_t regionIdx = getOrCreateRegion(name);
+	for (uint32_t occurrence = 2; regionIdx != MAX_REGION_COUNT && m_regions[regionIdx].lastBeginFrameIdx == m_frameIdx; ++occurrence)
+		regionIdx = getOrCreateRegion(name + " #" + std::to_string(occurrence));
+
+	return regionIdx;
+}
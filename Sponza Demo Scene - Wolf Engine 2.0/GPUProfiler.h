@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+class GPUProfiler
+{
+public:
+	GPUProfiler(bool collectPipelineStatistics, uint32_t maxFramesInFlight);
+	GPUProfiler(const GPUProfiler&) = delete;
+	~GPUProfiler();
+
+	// Replace DebugMarker::beginRegion/endRegion, timestamps are only written when a profiler exists.
+	// Can be called from several threads, a region is ended on the command buffer it was begun on. A name used several times in a frame gets one region per occurrence ("name #2", ...)
+	static void beginPassRegion(VkCommandBuffer commandBuffer, const float* color, const std::string& name, bool isGraphicsQueue);
+	static void endPassRegion(VkCommandBuffer commandBuffer);
+
+	// Called once per frame after it has been submitted. Non blocking: only reads back queries of frames whose fence has been waited on by the engine
+	void collectResults();
+
+	enum class PipelineStatistic { INPUT_ASSEMBLY_PRIMITIVES, VERTEX_SHADER_INVOCATIONS, CLIPPING_PRIMITIVES, FRAGMENT_SHADER_INVOCATIONS, COMPUTE_SHADER_INVOCATIONS, COUNT };
+	struct RegionResult
+	{
+		std::string name;
+		float lastTimeInMs;
+		float averageTimeInMs;
+		float maxTimeInMs;
+		bool hasPipelineStatistics;
+		std::array<uint64_t, static_cast<size_t>(PipelineStatistic::COUNT)> lastPipelineStatistics;
+	};
+	void getResults(std::vector<RegionResult>& output) const;
+
+private:
+	void beginRegion(VkCommandBuffer commandBuffer, const std::string& name, bool isGraphicsQueue);
+	void endRegion(VkCommandBuffer commandBuffer);
+	uint32_t getOrCreateRegion(const std::string& name);
+	uint32_t getOrCreateRegionForThisFrame(const std::string& name);
+
+	static constexpr uint32_t MAX_REGION_COUNT = 32;
+	static constexpr uint32_t QUERY_SLOT_COUNT = 4; // must be greater than the max number of frames in flight
+	static constexpr uint32_t HISTORY_SIZE = 128;
+
+	VkQueryPool m_timestampQueryPool = VK_NULL_HANDLE;
+	VkQueryPool m_pipelineStatisticsQueryPool = VK_NULL_HANDLE;
+	float m_timestampPeriodInNs;
+	uint32_t m_maxFramesInFlight;
+	uint32_t m_frameIdx = 0; // frame being recorded, incremented by collectResults
+
+	struct Region
+	{
+		std::string name;
+		uint32_t lastBeginFrameIdx = 0xFFFFFFFF; // a second begin in the same frame goes to the next occurrence
+		uint32_t nextSlot = 0;
+		std::array<bool, QUERY_SLOT_COUNT> pendingSlots{};
+		std::array<uint32_t, QUERY_SLOT_COUNT> slotFrameIndices{}; // the in-command-buffer reset of a slot has only run on the GPU once the fence of this frame has signaled
+		std::array<bool, QUERY_SLOT_COUNT> slotsWithPipelineStatistics{};
+
+		std::array<float, HISTORY_SIZE> history{};
+		uint32_t historyCount = 0;
+		uint32_t historyNextIdx = 0;
+		float lastTimeInMs = 0.0f;
+		bool hasPipelineStatistics = false;
+		std::array<uint64_t, static_cast<size_t>(PipelineStatistic::COUNT)> lastPipelineStatistics{};
+	};
+	std::vector<Region> m_regions;
+
+	struct OpenedRegion
+	{
+		VkCommandBuffer commandBuffer;
+		uint32_t regionIdx;
+		uint32_t slot;
+		bool collectsPipelineStatistics;
+	};
+	std::vector<OpenedRegion> m_openedRegions;
+
+	mutable std::mutex m_mutex; // regions and opened regions, passes may be recorded by other threads than the one collecting the results
+};
+
+extern GPUProfiler* g_gpuProfiler;
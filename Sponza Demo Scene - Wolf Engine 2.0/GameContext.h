@@ -9,9 +9,21 @@ struct GameContext
 	float sunAreaAngle;
 	glm::vec3 sunColor;
 	bool enableTAA;
+	bool singlePassCascades;
+	uint32_t cascadeResolutionDivisor; // 1, 2 or 4, see CascadeSettings::MAX_RESOLUTION_DIVISOR
+	bool temporalShadowMask;
+	uint32_t shadowMaskResolutionDivisor; // 1, 2 or 4, see ShadowMaskSettings
 
 	bool shadowmapScreenshotsRequested;
 
+	// Scripted playback (benchmark)
+	bool offscreen = false; // the final image isn't copied to the swapchain
+	bool overrideCamera = false;
+	glm::vec3 cameraOverridePosition;
+	glm::vec3 cameraOverrideTarget;
+	bool useFixedAnimationTime = false;
+	float animationTimeInSeconds = 0.0f;
+
 	GameContext(const glm::vec3& defaultSunDirection, const glm::vec3& defaultSunColor)
 	{
 		sunDirection = defaultSunDirection;
@@ -0,0 +1,64 @@
+#include "LoadingProgress.h"
+
+#include <algorithm>
+#include <array>
+#include <string>
+
+#include <Debug.h>
+
+using namespace Wolf;
+
+// Approximate share of the total loading time spent in each step
+static constexpr std::array<float, 4> STEP_WEIGHTS = { 0.15f, 0.65f, 0.15f, 0.05f };
+
+void LoadingProgress::setStep(Step step, float stepProgress)
+{
+	float progress = 1.0f;
+	if (step != Step::DONE)
+	{
+		progress = 0.0f;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(step); ++i)
+			progress += STEP_WEIGHTS[i];
+		progress += STEP_WEIGHTS[static_cast<uint32_t>(step)] * std::clamp(stepProgress, 0.0f, 1.0f);
+	}
+
+	const Step previousStep = m_step.exchange(step, std::memory_order_acq_rel);
+	m_progress.store(progress, std::memory_order_release);
+
+	if (previousStep != step)
+		Debug::sendInfo(std::string("Loading: ") + getStepName(step));
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_version++;
+	}
+	m_conditionVariable.notify_all();
+}
+
+bool LoadingProgress::waitForUpdate(uint32_t& lastSeenVersion, std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	const bool updated = m_conditionVariable.wait_for(lock, timeout, [this, lastSeenVersion] { return m_version != lastSeenVersion; });
+	lastSeenVersion = m_version;
+
+	return updated;
+}
+
+const char* LoadingProgress::getStepName(Step step)
+{
+	switch (step)
+	{
+	case Step::PASSES_INITIALIZATION:
+		return "passes initialization";
+	case Step::MODEL_LOADING:
+		return "models and textures";
+	case Step::ACCELERATION_STRUCTURES_BUILD:
+		return "acceleration structures";
+	case Step::PIPELINES_CREATION:
+		return "pipelines creation";
+	case Step::DONE:
+		return "done";
+	}
+
+	return "";
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+class LoadingProgress
+{
+public:
+	enum class Step
+	{
+		PASSES_INITIALIZATION, // models are loaded in parallel during this step
+		MODEL_LOADING, // geometry parse and texture decode are done in the same engine call
+		ACCELERATION_STRUCTURES_BUILD,
+		PIPELINES_CREATION,
+		DONE
+	};
+
+	// Called by the loading thread, 'stepProgress' is between 0 and 1
+	void setStep(Step step, float stepProgress = 0.0f);
+	void setFinished() { setStep(Step::DONE); }
+
+	float getProgress() const { return m_progress.load(std::memory_order_acquire); }
+	bool isFinished() const { return m_step.load(std::memory_order_acquire) == Step::DONE; }
+
+	// Blocks until the progress changes or the timeout elapses, returns true if something changed since 'lastSeenVersion'
+	bool waitForUpdate(uint32_t& lastSeenVersion, std::chrono::milliseconds timeout);
+
+private:
+	static const char* getStepName(Step step);
+
+	std::atomic<Step> m_step = Step::PASSES_INITIALIZATION;
+	std::atomic<float> m_progress = 0.0f;
+
+	std::mutex m_mutex;
+	std::condition_variable m_conditionVariable;
+	uint32_t m_version = 0;
+};
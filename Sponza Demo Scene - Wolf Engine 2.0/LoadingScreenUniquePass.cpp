@@ -38,6 +38,7 @@ void LoadingScreenUniquePass::initializeResources(const Wolf::InitializationCont
 
 	DescriptorSetLayoutGenerator loadingScreenDescriptorSetLayoutGenerator;
 	loadingScreenDescriptorSetLayoutGenerator.addCombinedImageSampler(VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+	loadingScreenDescriptorSetLayoutGenerator.addUniformBuffer(VK_SHADER_STAGE_FRAGMENT_BIT, 1);
 	m_loadingScreenDescriptorSetLayout.reset(new DescriptorSetLayout(loadingScreenDescriptorSetLayoutGenerator.getDescriptorLayouts()));
 
 	DescriptorSetLayoutGenerator loadingIconDescriptorSetLayoutGenerator;
@@ -63,11 +64,13 @@ void LoadingScreenUniquePass::initializeResources(const Wolf::InitializationCont
 	m_sampler.reset(new Sampler(VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER, 1.0f, VK_FILTER_LINEAR));
 
 	m_loadingIconUniformBuffer.reset(new Buffer(sizeof(glm::mat4), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::EACH_FRAME));
+	m_loadingScreenUniformBuffer.reset(new Buffer(sizeof(glm::vec4), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::EACH_FRAME));
 
 	DescriptorSetGenerator loadingScreenDescriptorSetGenerator(loadingScreenDescriptorSetLayoutGenerator.getDescriptorLayouts());
 	loadingScreenDescriptorSetGenerator.setCombinedImageSampler(0, m_loadingScreenTexture->getImageLayout(), m_loadingScreenTexture->getDefaultImageView(), *m_sampler);
+	loadingScreenDescriptorSetGenerator.setBuffer(1, *m_loadingScreenUniformBuffer);
 
-	m_loadingScreenDescriptorSet.reset(new DescriptorSet(m_loadingScreenDescriptorSetLayout->getDescriptorSetLayout(), UpdateRate::NEVER));
+	m_loadingScreenDescriptorSet.reset(new DescriptorSet(m_loadingScreenDescriptorSetLayout->getDescriptorSetLayout(), UpdateRate::EACH_FRAME));
 	m_loadingScreenDescriptorSet->update(loadingScreenDescriptorSetGenerator.getDescriptorSetCreateInfo());
 
 	m_loadingScreenVertexShaderParser.reset(new ShaderParser("Shaders/loadingScreen/loadingScreen.vert"));
@@ -127,6 +130,8 @@ void LoadingScreenUniquePass::record(const Wolf::RecordContext& context)
 	const float timeDiff = std::chrono::duration_cast<std::chrono::milliseconds>(currentTimer - m_startTimer).count() / 1'000.0f;
 	const glm::mat4 transform = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.8f, 0.75f, 0.0f)), timeDiff * 2.0f, glm::vec3(0.0f, 0.0f, 1.0f)), glm::vec3(0.15f, 0.15f, 1.0f));
 	m_loadingIconUniformBuffer->transferCPUMemory(&transform, sizeof(transform), 0, context.commandBufferIdx);
+	const glm::vec4 progress(m_progress, 0.0f, 0.0f, 0.0f);
+	m_loadingScreenUniformBuffer->transferCPUMemory(&progress, sizeof(progress), 0, context.commandBufferIdx);
 
 	/* Command buffer record */
 	const uint32_t frameBufferIdx = context.swapChainImageIdx;
@@ -139,7 +144,7 @@ void LoadingScreenUniquePass::record(const Wolf::RecordContext& context)
 	m_renderPass->beginRenderPass(m_frameBuffers[frameBufferIdx]->getFramebuffer(), clearValues, m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
 
 	vkCmdBindPipeline(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_BIND_POINT_GRAPHICS, m_loadingScreenPipeline->getPipeline());
-	vkCmdBindDescriptorSets(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_BIND_POINT_GRAPHICS, m_loadingScreenPipeline->getPipelineLayout(), 0, 1, m_loadingScreenDescriptorSet->getDescriptorSet(), 0, nullptr);
+	vkCmdBindDescriptorSets(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_BIND_POINT_GRAPHICS, m_loadingScreenPipeline->getPipelineLayout(), 0, 1, m_loadingScreenDescriptorSet->getDescriptorSet(context.commandBufferIdx), 0, nullptr);
 	m_rectMesh->draw(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), RenderMeshList::NO_CAMERA_IDX);
 
 	vkCmdBindPipeline(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_BIND_POINT_GRAPHICS, m_loadingIconPipeline->getPipeline());
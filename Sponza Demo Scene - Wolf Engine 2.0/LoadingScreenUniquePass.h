@@ -23,6 +23,8 @@ public:
 
 	const Wolf::Semaphore* getSemaphore() const override { return m_semaphore.get(); }
 
+	void setProgress(float progress) { m_progress = progress; }
+
 private:
 	void createPipelines(uint32_t width, uint32_t height);
 
@@ -49,6 +51,8 @@ private:
 	std::unique_ptr<Wolf::Sampler> m_sampler;
 	std::chrono::steady_clock::time_point m_startTimer = std::chrono::steady_clock::now();
 	std::unique_ptr<Wolf::Buffer> m_loadingIconUniformBuffer;
+	std::unique_ptr<Wolf::Buffer> m_loadingScreenUniformBuffer;
+	float m_progress = 0.0f;
 	std::unique_ptr<Wolf::DescriptorSetLayout> m_loadingScreenDescriptorSetLayout;
 	std::unique_ptr<Wolf::DescriptorSet> m_loadingScreenDescriptorSet;
 	std::unique_ptr<Wolf::DescriptorSetLayout> m_loadingIconDescriptorSetLayout;
@@ -0,0 +1,94 @@
+#include "LoadingTaskScheduler.h"
+
+#include <algorithm>
+
+LoadingTaskScheduler::LoadingTaskScheduler(std::mutex* vulkanQueueLock) : m_vulkanQueueLock(vulkanQueueLock)
+{
+	// The main thread keeps drawing the loading screen and the submission thread mostly waits on the GPU
+	const uint32_t cpuWorkerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	m_cpuWorkers.reserve(cpuWorkerCount);
+	for (uint32_t i = 0; i < cpuWorkerCount; ++i)
+		m_cpuWorkers.emplace_back(&LoadingTaskScheduler::runWorker, this, std::ref(m_cpuTasks));
+
+	m_gpuSubmissionThread = std::thread(&LoadingTaskScheduler::runWorker, this, std::ref(m_gpuTasks));
+}
+
+LoadingTaskScheduler::~LoadingTaskScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cpuTasks.conditionVariable.notify_all();
+	m_gpuTasks.conditionVariable.notify_all();
+
+	for (std::thread& cpuWorker : m_cpuWorkers)
+		cpuWorker.join();
+	m_gpuSubmissionThread.join();
+}
+
+std::shared_future<void> LoadingTaskScheduler::addCPUTask(std::function<void()> task)
+{
+	return addTask(m_cpuTasks, { std::packaged_task<void()>(std::move(task)), {}, false });
+}
+
+std::shared_future<void> LoadingTaskScheduler::addGPUTask(std::function<void()> task, const std::vector<std::shared_future<void>>& cpuDependencies, bool lockQueue)
+{
+	return addTask(m_gpuTasks, { std::packaged_task<void()>(std::move(task)), cpuDependencies, lockQueue });
+}
+
+void LoadingTaskScheduler::waitIdle()
+{
+	std::vector<std::shared_future<void>> addedTasks;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		addedTasks.swap(m_addedTasks);
+	}
+
+	// Rethrows exceptions of the tasks on the waiting thread
+	for (const std::shared_future<void>& addedTask : addedTasks)
+		addedTask.get();
+}
+
+std::shared_future<void> LoadingTaskScheduler::addTask(TaskQueue& queue, Task&& task)
+{
+	std::shared_future<void> result = task.function.get_future().share();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		queue.tasks.push_back(std::move(task));
+		m_addedTasks.push_back(result);
+	}
+	queue.conditionVariable.notify_one();
+
+	return result;
+}
+
+void LoadingTaskScheduler::runWorker(TaskQueue& queue)
+{
+	while (true)
+	{
+		Task task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			queue.conditionVariable.wait(lock, [this, &queue] { return m_stop || !queue.tasks.empty(); });
+			if (queue.tasks.empty())
+				return;
+
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+
+		for (const std::shared_future<void>& dependency : task.dependencies)
+			dependency.wait();
+
+		if (task.lockQueue)
+		{
+			std::lock_guard<std::mutex> lock(*m_vulkanQueueLock);
+			task.function();
+		}
+		else
+		{
+			task.function();
+		}
+	}
+}
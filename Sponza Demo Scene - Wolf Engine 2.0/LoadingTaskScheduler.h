@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tasks of the scene loading.
+// CPU tasks (model parsing and texture decoding) run on a pool sized by the core count.
+// GPU tasks (pass resources, acceleration structures) run one after the other on a single submission thread in the order they were added,
+// so a task only depends explicitly on CPU tasks, the GPU tasks added before it have always completed
+class LoadingTaskScheduler
+{
+public:
+	// 'vulkanQueueLock' is taken around each GPU task, the engine still takes it for model uploads and loading screen frames
+	LoadingTaskScheduler(std::mutex* vulkanQueueLock);
+	LoadingTaskScheduler(const LoadingTaskScheduler&) = delete;
+	~LoadingTaskScheduler();
+
+	std::shared_future<void> addCPUTask(std::function<void()> task);
+
+	// 'cpuDependencies' are waited on by the submission thread before the task runs.
+	// 'lockQueue' is false for tasks that load models themselves, the engine takes the lock for them
+	std::shared_future<void> addGPUTask(std::function<void()> task, const std::vector<std::shared_future<void>>& cpuDependencies = {}, bool lockQueue = true);
+
+	// Blocks until every task added so far has completed
+	void waitIdle();
+
+private:
+	struct Task
+	{
+		std::packaged_task<void()> function;
+		std::vector<std::shared_future<void>> dependencies;
+		bool lockQueue;
+	};
+	struct TaskQueue
+	{
+		std::deque<Task> tasks;
+		std::condition_variable conditionVariable;
+	};
+
+	std::shared_future<void> addTask(TaskQueue& queue, Task&& task);
+	void runWorker(TaskQueue& queue);
+
+	std::mutex* m_vulkanQueueLock;
+
+	std::mutex m_mutex; // task queues and m_stop
+	TaskQueue m_cpuTasks;
+	TaskQueue m_gpuTasks;
+	bool m_stop = false;
+
+	std::vector<std::thread> m_cpuWorkers;
+	std::thread m_gpuSubmissionThread;
+
+	std::vector<std::shared_future<void>> m_addedTasks; // for waitIdle
+};
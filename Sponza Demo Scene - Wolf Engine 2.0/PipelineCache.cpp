@@ -0,0 +1,255 @@
+#include "PipelineCache.h"
+
+#include <cstring>
+#include <fstream>
+
+#include <Debug.h>
+#include <Vulkan.h>
+
+using namespace Wolf;
+
+PipelineCache* g_pipelineCache = nullptr;
+
+PipelineCache::PipelineCache(const std::string& filename) : m_filename(filename)
+{
+	// The physical device version isn't the version of the created device, a core 1.3 command is only returned by vkGetDeviceProcAddr when the device was created for 1.3
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(g_vulkanInstance->getPhysicalDevice(), &physicalDeviceProperties);
+	m_hasCreationFeedback = physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_3 && vkGetDeviceProcAddr(g_vulkanInstance->getDevice(), "vkCmdPipelineBarrier2") != nullptr;
+	if (!m_hasCreationFeedback)
+		Debug::sendInfo("Pipeline creation feedback isn't available, pipeline cache hits won't be counted");
+
+	std::vector<char> initialData;
+	readFile(initialData);
+
+	VkPipelineCacheCreateInfo pipelineCacheCreateInfo{};
+	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	pipelineCacheCreateInfo.initialDataSize = initialData.size();
+	pipelineCacheCreateInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+	if (vkCreatePipelineCache(g_vulkanInstance->getDevice(), &pipelineCacheCreateInfo, nullptr, &m_pipelineCache) != VK_SUCCESS)
+	{
+		// The driver may still reject data that passed the header check, start with an empty cache
+		pipelineCacheCreateInfo.initialDataSize = 0;
+		pipelineCacheCreateInfo.pInitialData = nullptr;
+		if (vkCreatePipelineCache(g_vulkanInstance->getDevice(), &pipelineCacheCreateInfo, nullptr, &m_pipelineCache) != VK_SUCCESS)
+			Debug::sendError("Failed to create pipeline cache");
+	}
+}
+
+PipelineCache::~PipelineCache()
+{
+	vkDestroyPipelineCache(g_vulkanInstance->getDevice(), m_pipelineCache, nullptr);
+}
+
+void PipelineCache::addPipelineCreation(const VkPipelineCreationFeedback& feedback)
+{
+	if (!(feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT))
+		++m_unknownCount;
+	else if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT)
+		++m_hitCount;
+	else
+		++m_missCount;
+}
+
+void PipelineCache::save() const
+{
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(g_vulkanInstance->getDevice(), m_pipelineCache, &dataSize, nullptr) != VK_SUCCESS)
+	{
+		Debug::sendWarning("Failed to get pipeline cache size, " + m_filename + " is not updated");
+		return;
+	}
+
+	std::vector<char> data(dataSize);
+	if (vkGetPipelineCacheData(g_vulkanInstance->getDevice(), m_pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+	{
+		Debug::sendWarning("Failed to get pipeline cache data, " + m_filename + " is not updated");
+		return;
+	}
+
+	FileHeader fileHeader;
+	fillFileHeader(fileHeader);
+	fileHeader.dataSize = static_cast<uint32_t>(dataSize);
+
+	std::ofstream outFile(m_filename, std::ios::binary);
+	outFile.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+	outFile.write(data.data(), static_cast<std::streamsize>(dataSize));
+
+	Debug::sendInfo("Pipeline cache saved to " + m_filename + " (" + std::to_string(dataSize >> 10) + " KB), " + std::to_string(m_hitCount) + " hits, " + std::to_string(m_missCount) + " misses" +
+		(m_unknownCount > 0 ? ", " + std::to_string(m_unknownCount) + " pipelines without creation feedback" : ""));
+}
+
+void PipelineCache::fillFileHeader(FileHeader& output) const
+{
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	vkGetPhysicalDeviceProperties(g_vulkanInstance->getPhysicalDevice(), &physicalDeviceProperties);
+
+	output.magic = FILE_MAGIC;
+	output.dataSize = 0;
+	output.vendorID = physicalDeviceProperties.vendorID;
+	output.deviceID = physicalDeviceProperties.deviceID;
+	output.driverVersion = physicalDeviceProperties.driverVersion;
+	memcpy(output.pipelineCacheUUID, physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+void PipelineCache::readFile(std::vector<char>& outData) const
+{
+	std::ifstream inFile(m_filename, std::ios::binary);
+	if (!inFile)
+	{
+		Debug::sendInfo("No pipeline cache found, " + m_filename + " will be created on exit");
+		return;
+	}
+
+	FileHeader expectedHeader;
+	fillFileHeader(expectedHeader);
+
+	FileHeader fileHeader;
+	if (!inFile.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader)) || fileHeader.magic != FILE_MAGIC)
+	{
+		Debug::sendWarning("Pipeline cache " + m_filename + " is invalid, it's ignored");
+		return;
+	}
+
+	// Data of another GPU or driver would be rejected by the driver (or worse), it's rebuilt from scratch
+	if (fileHeader.vendorID != expectedHeader.vendorID || fileHeader.deviceID != expectedHeader.deviceID || fileHeader.driverVersion != expectedHeader.driverVersion ||
+		memcmp(fileHeader.pipelineCacheUUID, expectedHeader.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		Debug::sendInfo("Pipeline cache " + m_filename + " comes from another device or driver, it's ignored");
+		return;
+	}
+
+	outData.resize(fileHeader.dataSize);
+	if (!inFile.read(outData.data(), static_cast<std::streamsize>(fileHeader.dataSize)))
+	{
+		Debug::sendWarning("Pipeline cache " + m_filename + " is truncated, it's ignored");
+		outData.clear();
+		return;
+	}
+
+	Debug::sendInfo("Pipeline cache loaded from " + m_filename + " (" + std::to_string(outData.size() >> 10) + " KB)");
+}
+
+static VkPipelineLayout createPipelineLayout(const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts)
+{
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+	pipelineLayoutCreateInfo.pSetLayouts = descriptorSetLayouts.data();
+
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	if (vkCreatePipelineLayout(g_vulkanInstance->getDevice(), &pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		Debug::sendError("Failed to create pipeline layout");
+	return pipelineLayout;
+}
+
+static VkShaderModule createShaderModule(const ShaderCreateInfo& shaderCreateInfo)
+{
+	VkShaderModuleCreateInfo shaderModuleCreateInfo{};
+	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderModuleCreateInfo.codeSize = shaderCreateInfo.shaderCode.size();
+	shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCreateInfo.shaderCode.data());
+
+	VkShaderModule shaderModule = VK_NULL_HANDLE;
+	if (vkCreateShaderModule(g_vulkanInstance->getDevice(), &shaderModuleCreateInfo, nullptr, &shaderModule) != VK_SUCCESS)
+		Debug::sendError("Failed to create shader module");
+	return shaderModule;
+}
+
+ComputePipeline::ComputePipeline(const ShaderCreateInfo& shaderCreateInfo, const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts)
+{
+	const VkDevice device = g_vulkanInstance->getDevice();
+
+	m_pipelineLayout = createPipelineLayout(descriptorSetLayouts);
+	const VkShaderModule shaderModule = createShaderModule(shaderCreateInfo);
+
+	VkComputePipelineCreateInfo pipelineCreateInfo{};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineCreateInfo.stage.module = shaderModule;
+	pipelineCreateInfo.stage.pName = "main";
+	pipelineCreateInfo.layout = m_pipelineLayout;
+
+	// Tells if the pipeline came from the cache
+	VkPipelineCreationFeedback pipelineFeedback{};
+	VkPipelineCreationFeedback stageFeedback{};
+	VkPipelineCreationFeedbackCreateInfo creationFeedbackCreateInfo{};
+	creationFeedbackCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO;
+	creationFeedbackCreateInfo.pPipelineCreationFeedback = &pipelineFeedback;
+	creationFeedbackCreateInfo.pipelineStageCreationFeedbackCount = 1;
+	creationFeedbackCreateInfo.pPipelineStageCreationFeedbacks = &stageFeedback;
+	if (g_pipelineCache && g_pipelineCache->hasCreationFeedback())
+		pipelineCreateInfo.pNext = &creationFeedbackCreateInfo;
+
+	const VkPipelineCache pipelineCache = g_pipelineCache ? g_pipelineCache->getPipelineCache() : VK_NULL_HANDLE;
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &m_pipeline) != VK_SUCCESS)
+		Debug::sendError("Failed to create compute pipeline");
+
+	if (g_pipelineCache)
+		g_pipelineCache->addPipelineCreation(pipelineFeedback);
+
+	vkDestroyShaderModule(device, shaderModule, nullptr);
+}
+
+ComputePipeline::~ComputePipeline()
+{
+	vkDestroyPipeline(g_vulkanInstance->getDevice(), m_pipeline, nullptr);
+	vkDestroyPipelineLayout(g_vulkanInstance->getDevice(), m_pipelineLayout, nullptr);
+}
+
+RayTracingPipeline::RayTracingPipeline(const std::vector<ShaderCreateInfo>& shaderCreateInfos, const std::vector<VkRayTracingShaderGroupCreateInfoKHR>& shaderGroupCreateInfos,
+	const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts)
+{
+	const VkDevice device = g_vulkanInstance->getDevice();
+
+	m_pipelineLayout = createPipelineLayout(descriptorSetLayouts);
+
+	std::vector<VkShaderModule> shaderModules(shaderCreateInfos.size());
+	std::vector<VkPipelineShaderStageCreateInfo> shaderStageCreateInfos(shaderCreateInfos.size());
+	for (uint32_t i = 0; i < shaderCreateInfos.size(); ++i)
+	{
+		shaderModules[i] = createShaderModule(shaderCreateInfos[i]);
+
+		shaderStageCreateInfos[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStageCreateInfos[i].stage = shaderCreateInfos[i].stage;
+		shaderStageCreateInfos[i].module = shaderModules[i];
+		shaderStageCreateInfos[i].pName = "main";
+	}
+
+	VkRayTracingPipelineCreateInfoKHR pipelineCreateInfo{};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR;
+	pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStageCreateInfos.size());
+	pipelineCreateInfo.pStages = shaderStageCreateInfos.data();
+	pipelineCreateInfo.groupCount = static_cast<uint32_t>(shaderGroupCreateInfos.size());
+	pipelineCreateInfo.pGroups = shaderGroupCreateInfos.data();
+	pipelineCreateInfo.maxPipelineRayRecursionDepth = 1;
+	pipelineCreateInfo.layout = m_pipelineLayout;
+
+	// Tells if the pipeline came from the cache, one stage feedback per shader
+	VkPipelineCreationFeedback pipelineFeedback{};
+	std::vector<VkPipelineCreationFeedback> stageFeedbacks(shaderStageCreateInfos.size());
+	VkPipelineCreationFeedbackCreateInfo creationFeedbackCreateInfo{};
+	creationFeedbackCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO;
+	creationFeedbackCreateInfo.pPipelineCreationFeedback = &pipelineFeedback;
+	creationFeedbackCreateInfo.pipelineStageCreationFeedbackCount = static_cast<uint32_t>(stageFeedbacks.size());
+	creationFeedbackCreateInfo.pPipelineStageCreationFeedbacks = stageFeedbacks.data();
+	if (g_pipelineCache && g_pipelineCache->hasCreationFeedback())
+		pipelineCreateInfo.pNext = &creationFeedbackCreateInfo;
+
+	const VkPipelineCache pipelineCache = g_pipelineCache ? g_pipelineCache->getPipelineCache() : VK_NULL_HANDLE;
+	if (vkCreateRayTracingPipelinesKHR(device, VK_NULL_HANDLE, pipelineCache, 1, &pipelineCreateInfo, nullptr, &m_pipeline) != VK_SUCCESS)
+		Debug::sendError("Failed to create ray tracing pipeline");
+
+	if (g_pipelineCache)
+		g_pipelineCache->addPipelineCreation(pipelineFeedback);
+
+	for (const VkShaderModule shaderModule : shaderModules)
+		vkDestroyShaderModule(device, shaderModule, nullptr);
+}
+
+RayTracingPipeline::~RayTracingPipeline()
+{
+	vkDestroyPipeline(g_vulkanInstance->getDevice(), m_pipeline, nullptr);
+	vkDestroyPipelineLayout(g_vulkanInstance->getDevice(), m_pipelineLayout, nullptr);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <Pipeline.h>
+
+// VkPipelineCache saved on exit and loaded at startup. The file is only used when it comes from the same device, driver and pipeline cache UUID.
+// Compute and ray tracing pipelines of the demo (ComputePipeline, RayTracingPipeline) use it. Graphics pipelines are built by the engine from RenderingPipelineCreateInfo
+// and PipelineSet, which take no cache handle, so they stay uncached
+class PipelineCache
+{
+public:
+	PipelineCache(const std::string& filename);
+	PipelineCache(const PipelineCache&) = delete;
+	~PipelineCache();
+
+	VkPipelineCache getPipelineCache() const { return m_pipelineCache; }
+	bool hasCreationFeedback() const { return m_hasCreationFeedback; }
+
+	// Thread safe, pipelines are created by the workers of the passes
+	void addPipelineCreation(const VkPipelineCreationFeedback& feedback);
+	void save() const;
+
+private:
+	// Prepended to the data given by vkGetPipelineCacheData
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t dataSize;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	};
+	static constexpr uint32_t FILE_MAGIC = 0x48435057; // "WPCH"
+
+	void fillFileHeader(FileHeader& output) const;
+	void readFile(std::vector<char>& outData) const;
+
+	std::string m_filename;
+	VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+	bool m_hasCreationFeedback; // core in Vulkan 1.3, only when the created device uses it
+
+	std::atomic<uint32_t> m_hitCount = 0;
+	std::atomic<uint32_t> m_missCount = 0;
+	std::atomic<uint32_t> m_unknownCount = 0; // the driver didn't tell
+};
+
+extern PipelineCache* g_pipelineCache;
+
+// Compute pipeline created with g_pipelineCache when it exists, same accessors as Wolf::Pipeline
+class ComputePipeline
+{
+public:
+	ComputePipeline(const Wolf::ShaderCreateInfo& shaderCreateInfo, const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts);
+	ComputePipeline(const ComputePipeline&) = delete;
+	~ComputePipeline();
+
+	VkPipeline getPipeline() const { return m_pipeline; }
+	VkPipelineLayout getPipelineLayout() const { return m_pipelineLayout; }
+
+private:
+	VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline m_pipeline = VK_NULL_HANDLE;
+};
+
+// Ray tracing pipeline created with g_pipelineCache when it exists, same accessors as Wolf::Pipeline. Rays can't be traced from hit or miss shaders
+class RayTracingPipeline
+{
+public:
+	RayTracingPipeline(const std::vector<Wolf::ShaderCreateInfo>& shaderCreateInfos, const std::vector<VkRayTracingShaderGroupCreateInfoKHR>& shaderGroupCreateInfos,
+		const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts);
+	RayTracingPipeline(const RayTracingPipeline&) = delete;
+	~RayTracingPipeline();
+
+	VkPipeline getPipeline() const { return m_pipeline; }
+	VkPipelineLayout getPipelineLayout() const { return m_pipelineLayout; }
+
+private:
+	VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline m_pipeline = VK_NULL_HANDLE;
+};
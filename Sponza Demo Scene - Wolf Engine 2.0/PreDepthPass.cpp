@@ -6,6 +6,8 @@
 #include <Timer.h>
 
 #include "CommonLayout.h"
+#include "DebugMarker.h"
+#include "GPUProfiler.h"
 #include "RenderMeshList.h"
 
 using namespace Wolf;
@@ -40,6 +42,8 @@ void PreDepthPass::record(const Wolf::RecordContext& context)
 	/* Command buffer record */
 	m_commandBuffer->beginCommandBuffer(context.commandBufferIdx);
 
+	GPUProfiler::beginPassRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), DebugMarker::renderPassDebugColor, "Pre Depth Pass", true);
+
 	DepthPassBase::record(context);
 
 	VkImageCopy copyRegion{};
@@ -62,6 +66,8 @@ void PreDepthPass::record(const Wolf::RecordContext& context)
 	m_copyImage->recordCopyGPUImage(*m_depthImage, copyRegion, m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
 	m_depthImage->transitionImageLayout(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
 
+	GPUProfiler::endPassRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
+
 	m_commandBuffer->endCommandBuffer(context.commandBufferIdx);
 }
 
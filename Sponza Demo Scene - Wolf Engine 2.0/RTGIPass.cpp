@@ -105,6 +105,9 @@ void RTGIPass::initializeDebugPipelineSet()
 	pipelineInfo.descriptorSetLayouts = { m_sphereModel->getDescriptorSetLayout(), CommonDescriptorLayouts::g_commonForwardDescriptorSetLayout };
 
 	m_debugPipelineSet->addPipeline(pipelineInfo, CommonPipelineIndices::PIPELINE_IDX_FORWARD);
+	m_debugPipelineSet->addEmptyPipeline(CommonPipelineIndices::PIPELINE_IDX_STATIC_SHADOW_MAP);
+	m_debugPipelineSet->addEmptyPipeline(CommonPipelineIndices::PIPELINE_IDX_SINGLE_PASS_SHADOW_MAP);
+	m_debugPipelineSet->addEmptyPipeline(CommonPipelineIndices::PIPELINE_IDX_VIRTUAL_SHADOW_MAP_PAGES);
 
 	m_sphereModel->setPipelineSet(m_debugPipelineSet.get());
 }
@@ -8,13 +8,16 @@
 #include <DescriptorSetGenerator.h>
 #include <DescriptorSetLayoutGenerator.h>
 #include <RayTracingShaderGroupGenerator.h>
+#include <Timer.h>
 
 #include "CameraList.h"
 #include "CommonLayout.h"
 #include "DebugMarker.h"
 #include "PreDepthPass.h"
 #include "GameContext.h"
+#include "GPUProfiler.h"
 #include "GraphicCameraInterface.h"
+#include "ShadowMaskSettings.h"
 
 using namespace Wolf;
 
@@ -29,18 +32,15 @@ void RayTracedShadowsPass::initializeResources(const InitializationContext& cont
 	m_commandBuffer.reset(new CommandBuffer(QueueType::RAY_TRACING, false /* isTransient */));
 	m_semaphore.reset(new Semaphore(VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR));
 
-	m_rayGenShaderParser.reset(new ShaderParser("Shaders/rayTracedShadows/shader.rgen", {}, 1));
-	m_rayMissShaderParser.reset(new ShaderParser("Shaders/rayTracedShadows/shader.rmiss"));
-	m_closestHitShaderParser.reset(new ShaderParser("Shaders/rayTracedShadows/shader.rchit"));
-
 	m_descriptorSetLayoutGenerator.addAccelerationStructure(VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 0); // TLAS
 	m_descriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_RAYGEN_BIT_KHR,                                                1); // output image
 	m_descriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR,                    2, 1); // input depth
 	m_descriptorSetLayoutGenerator.addUniformBuffer(VK_SHADER_STAGE_RAYGEN_BIT_KHR,											      3); // uniform buffer
 	m_descriptorSetLayoutGenerator.addCombinedImageSampler(VK_SHADER_STAGE_RAYGEN_BIT_KHR,                                        4); // noise map
+	m_descriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_RAYGEN_BIT_KHR,                                                5); // clean image
 	m_descriptorSetLayout.reset(new DescriptorSetLayout(m_descriptorSetLayoutGenerator.getDescriptorLayouts()));
 
-	m_uniformBuffer.reset(new Buffer(sizeof(ShadowUBData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::NEVER));
+	m_uniformBuffer.reset(new Buffer(sizeof(ShadowUBData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::EACH_FRAME));
 
 	// Noise
 	CreateImageInfo noiseImageCreateInfo;
@@ -95,25 +95,59 @@ void RayTracedShadowsPass::initializeResources(const InitializationContext& cont
 	m_denoiseSamplingPattern->copyCPUBuffer(reinterpret_cast<unsigned char*>(samplingPoints.data()), { VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT , VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT });
 
 	// Debug
-	m_debugComputeShaderParser.reset(new ShaderParser("Shaders/rayTracedShadows/debug.comp", {}, 1));
-
 	m_debugDescriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT, 0); // output
 	m_debugDescriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1, 1); // denoising sampling pattern
 	m_debugDescriptorSetLayoutGenerator.addUniformBuffer(VK_SHADER_STAGE_COMPUTE_BIT, 2); // uniform buffer
 	m_debugDescriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 3, 1); // input depth
 	m_debugDescriptorSetLayout.reset(new DescriptorSetLayout(m_debugDescriptorSetLayoutGenerator.getDescriptorLayouts()));
 
-	m_debugUniformBuffer.reset(new Buffer(sizeof(DebugUBData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::NEVER));
+	m_debugUniformBuffer.reset(new Buffer(sizeof(DebugUBData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::EACH_FRAME));
+
+	// Temporal accumulation
+	m_temporalAccumulationDescriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0, 1); // input depth
+	m_temporalAccumulationDescriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT, 1); // noisy mask
+	m_temporalAccumulationDescriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT, 2); // previous history
+	m_temporalAccumulationDescriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT, 3); // output history
+	m_temporalAccumulationDescriptorSetLayoutGenerator.addUniformBuffer(VK_SHADER_STAGE_COMPUTE_BIT, 4); // uniform buffer
+	m_temporalAccumulationDescriptorSetLayout.reset(new DescriptorSetLayout(m_temporalAccumulationDescriptorSetLayoutGenerator.getDescriptorLayouts()));
+
+	m_temporalAccumulationUniformBuffer.reset(new Buffer(sizeof(TemporalAccumulationUBData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::EACH_FRAME));
 
-	createPipelines();
+	// Denoise
+	m_denoiseDescriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0, 1); // input depth
+	m_denoiseDescriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT, 1); // input mask
+	m_denoiseDescriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT, 2); // output mask
+	m_denoiseDescriptorSetLayout.reset(new DescriptorSetLayout(m_denoiseDescriptorSetLayoutGenerator.getDescriptorLayouts()));
+
+	// Shader compilation and pipeline creation don't use the queue, they run on a worker thread while the next passes are initialized
+	m_pipelineCreation = std::async(std::launch::async, [this]
+	{
+		Timer timer("Ray traced shadows pipelines creation");
+		m_rayGenShaderParser.reset(new ShaderParser("Shaders/rayTracedShadows/shader.rgen", {}, 1));
+		m_rayMissShaderParser.reset(new ShaderParser("Shaders/rayTracedShadows/shader.rmiss"));
+		m_closestHitShaderParser.reset(new ShaderParser("Shaders/rayTracedShadows/shader.rchit"));
+		m_debugComputeShaderParser.reset(new ShaderParser("Shaders/rayTracedShadows/debug.comp", {}, 1));
+		for (uint32_t divisorIdx = 0; divisorIdx < ShadowMaskSettings::RESOLUTION_DIVISOR_COUNT; ++divisorIdx)
+		{
+			const std::string resolutionDivisorShaderBlock = ShadowMaskSettings::getResolutionDivisorShaderBlock(ShadowMaskSettings::RESOLUTION_DIVISORS[divisorIdx]);
+			m_temporalAccumulationShaderParsers[divisorIdx].reset(new ShaderParser("Shaders/rayTracedShadows/temporalAccumulation.comp", { resolutionDivisorShaderBlock }, 1));
+			m_denoiseShaderParsers[DENOISE_HORIZONTAL][divisorIdx].reset(new ShaderParser("Shaders/rayTracedShadows/denoise.comp", { "HORIZONTAL", resolutionDivisorShaderBlock }, 1));
+			m_denoiseShaderParsers[DENOISE_VERTICAL][divisorIdx].reset(new ShaderParser("Shaders/rayTracedShadows/denoise.comp", { "VERTICAL", resolutionDivisorShaderBlock }, 1));
+		}
+		createPipelines();
+	});
 	createOutputImages(context.swapChainWidth, context.swapChainHeight);
 	createDescriptorSet();
+
+	m_upsampler.reset(new ShadowMaskUpsampler(m_preDepthPass));
+	m_upsampler->initializeResources(context.swapChainWidth, context.swapChainHeight, m_outputMasks);
 }
 
 void RayTracedShadowsPass::resize(const InitializationContext& context)
 {
 	createOutputImages(context.swapChainWidth, context.swapChainHeight);
 	createDescriptorSet();
+	m_upsampler->resize(context.swapChainWidth, context.swapChainHeight, m_outputMasks);
 }
 
 static bool willDoScreenshotsThisFrame = false;
@@ -121,13 +155,17 @@ static uint32_t frameCounter = 0;
 static uint32_t imageCounter = 101;
 void RayTracedShadowsPass::record(const RecordContext& context)
 {
+	waitForPipelineCreation();
+
 	const GameContext* gameContext = static_cast<const GameContext*>(context.gameContext);
 	const CameraInterface* camera = context.cameraList->getCamera(CommonCameraIndices::CAMERA_IDX_ACTIVE);
+	const uint32_t currentMaskIdx = context.currentFrameIdx % getMaskCount();
+	const uint32_t previousMaskIdx = (context.currentFrameIdx + getMaskCount() - 1) % getMaskCount();
 
 	if (gameContext->shadowmapScreenshotsRequested)
 	{
 		willDoScreenshotsThisFrame = true;
-		saveMaskToFile("Exports/noisyImage_" + std::to_string(imageCounter) + ".jpg");
+		saveMaskToFile("Exports/noisyImage_" + std::to_string(imageCounter) + ".jpg", previousMaskIdx);
 
 		//m_preDepthPass->getOutput()->exportToFile("depthMap.jpg");
 
@@ -141,7 +179,7 @@ void RayTracedShadowsPass::record(const RecordContext& context)
 
 			if (frameCounter == 0)
 			{
-				saveMaskToFile("Exports/cleanImage_" + std::to_string(imageCounter) + ".jpg");
+				saveCleanMaskToFile("Exports/cleanImage_" + std::to_string(imageCounter) + ".jpg");
 				willDoScreenshotsThisFrame = false;
 
 				std::ofstream exportPositionsFile;
@@ -168,14 +206,44 @@ void RayTracedShadowsPass::record(const RecordContext& context)
 		}
 	}
 
+	// Masks are allocated at the screen resolution, a reduced one only fills the top left part
+	const uint32_t resolutionDivisor = gameContext->shadowMaskResolutionDivisor;
+	const VkExtent2D maskExtent = { ShadowMaskSettings::getReducedSize(m_noisyMasks[currentMaskIdx]->getExtent().width, resolutionDivisor),
+		ShadowMaskSettings::getReducedSize(m_noisyMasks[currentMaskIdx]->getExtent().height, resolutionDivisor) };
+	m_maskPixelCount = maskExtent.width * maskExtent.height;
+
+	// Clean images accumulate every pixel
+	const RayRate rayRate = frameCounter == 0 ? m_rayRate : RayRate::Full;
+	const VkExtent2D rayLaunchExtent = getRayLaunchExtent(rayRate, maskExtent);
+	m_rayCount = rayLaunchExtent.width * rayLaunchExtent.height;
+
 	/* Update data */
 	ShadowUBData shadowUBData;
-	shadowUBData.sunDirectionAndNoiseIndex = glm::vec4(-gameContext->sunDirection, context.currentFrameIdx % NOISE_TEXTURE_VECTOR_COUNT);
+	// A pixel gets a new noise vector each time the pattern comes back to it
+	shadowUBData.sunDirectionAndNoiseIndex = glm::vec4(-gameContext->sunDirection, (context.currentFrameIdx / getRayPatternCycleLength(rayRate)) % NOISE_TEXTURE_VECTOR_COUNT);
 	shadowUBData.drawWithoutNoiseFrameIndex = frameCounter;
 	shadowUBData.sunAreaAngle = gameContext->sunAreaAngle;
+	shadowUBData.resolutionDivisor = resolutionDivisor;
+	shadowUBData.rayRate = static_cast<glm::uint>(rayRate);
+	shadowUBData.rayPatternIndex = context.currentFrameIdx;
 
 	m_uniformBuffer->transferCPUMemory(&shadowUBData, sizeof(shadowUBData), 0, context.commandBufferIdx);
 
+	TemporalAccumulationUBData temporalAccumulationUBData;
+	// The partial sums of a clean capture aren't blended into the history, it restarts once the capture is done
+	const bool isHistoryValid = m_isHistoryValid && context.currentFrameIdx == m_lastRecordedFrameIdx + 1;
+	temporalAccumulationUBData.enableTemporalAccumulation = frameCounter == 0 && gameContext->temporalShadowMask && isHistoryValid && gameContext->sunDirection == m_previousSunDirection &&
+		gameContext->sunAreaAngle == m_previousSunAreaAngle && resolutionDivisor == m_previousResolutionDivisor ? 1 : 0;
+	m_previousSunDirection = gameContext->sunDirection;
+	m_previousSunAreaAngle = gameContext->sunAreaAngle;
+	m_previousResolutionDivisor = resolutionDivisor;
+	m_isHistoryValid = frameCounter == 0;
+	m_lastRecordedFrameIdx = context.currentFrameIdx;
+	temporalAccumulationUBData.rayRate = shadowUBData.rayRate;
+	temporalAccumulationUBData.rayPatternIndex = shadowUBData.rayPatternIndex;
+
+	m_temporalAccumulationUniformBuffer->transferCPUMemory(&temporalAccumulationUBData, sizeof(temporalAccumulationUBData), 0, context.commandBufferIdx);
+
 	DebugUBData debugUBData;
 	debugUBData.worldSpaceNormal = glm::vec3(0.0f, 1.0f, 0.0f);
 	debugUBData.pixelUV = glm::vec2(0.5f, 0.5f);
@@ -186,11 +254,28 @@ void RayTracedShadowsPass::record(const RecordContext& context)
 
 	m_commandBuffer->beginCommandBuffer(context.commandBufferIdx);
 
-	DebugMarker::beginRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), DebugMarker::rayTracePassDebugColor, "Ray Trace Shadow Pass");
+	GPUProfiler::beginPassRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), DebugMarker::rayTracePassDebugColor, "Ray Trace Shadow Pass", false);
+
+	if (frameCounter != 0)
+	{
+		// Each slice of the clean image adds to the one traced by the previous frame
+		VkImageMemoryBarrier imageMemoryBarrier{};
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.image = m_cleanMask->getImage();
+		imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vkCmdPipelineBarrier(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 0, nullptr, 0, nullptr,
+			1, &imageMemoryBarrier);
+	}
 
 	vkCmdBindPipeline(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_pipeline->getPipeline());
 	vkCmdBindDescriptorSets(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_pipeline->getPipelineLayout(), 0, 1, 
-		m_descriptorSet->getDescriptorSet(context.commandBufferIdx), 0, nullptr);
+		m_descriptorSets[currentMaskIdx]->getDescriptorSet(context.commandBufferIdx), 0, nullptr);
 	vkCmdBindDescriptorSets(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_pipeline->getPipelineLayout(), 1, 1,
 		camera->getDescriptorSet()->getDescriptorSet(), 0, nullptr);
 
@@ -214,15 +299,21 @@ void RayTracedShadowsPass::record(const RecordContext& context)
 	vkCmdTraceRaysKHR(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), &rgenRegion,
 		&rmissRegion,
 		&rhitRegion,
-		&callRegion, m_outputMask->getExtent().width, m_outputMask->getExtent().height, 1);
+		&callRegion, rayLaunchExtent.width, rayLaunchExtent.height, 1);
+
+	GPUProfiler::endPassRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
+
+	recordTemporalAccumulation(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), context, resolutionDivisor, maskExtent);
+	recordDenoising(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), context, resolutionDivisor, maskExtent);
 
-	DebugMarker::endRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
+	if (resolutionDivisor > 1)
+		m_upsampler->record(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), context, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, resolutionDivisor);
 
 	VkClearColorValue black = { 0.0f, 0.0f, 0.0f };
 	VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT , 0, 1, 0, 1 };
 	vkCmdClearColorImage(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), m_debugOutputImage->getImage(), VK_IMAGE_LAYOUT_GENERAL, &black, 1, &range);
 
-	DebugMarker::beginRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), DebugMarker::rayTracePassDebugColor, "Debug ray Trace shadow denoising");
+	GPUProfiler::beginPassRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), DebugMarker::rayTracePassDebugColor, "Debug ray Trace shadow denoising", false);
 
 	vkCmdBindDescriptorSets(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_BIND_POINT_COMPUTE, m_debugPipeline->getPipelineLayout(), 0, 1,
 		m_debugDescriptorSet->getDescriptorSet(context.commandBufferIdx), 0, nullptr);
@@ -235,7 +326,7 @@ void RayTracedShadowsPass::record(const RecordContext& context)
 	const uint32_t groupSizeX = m_denoiseSamplingPattern->getExtent().width % dispatchGroups.width != 0 ? m_denoiseSamplingPattern->getExtent().width / dispatchGroups.width + 1 : m_denoiseSamplingPattern->getExtent().width / dispatchGroups.width;
 	vkCmdDispatch(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), groupSizeX, dispatchGroups.height, dispatchGroups.depth);
 
-	DebugMarker::endRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
+	GPUProfiler::endPassRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
 
 	m_commandBuffer->endCommandBuffer(context.commandBufferIdx);
 }
@@ -253,17 +344,37 @@ void RayTracedShadowsPass::submit(const SubmitContext& context)
 		anyShaderModified = true;
 	if (m_debugComputeShaderParser->compileIfFileHasBeenModified())
 		anyShaderModified = true;
+	for (const std::unique_ptr<ShaderParser>& temporalAccumulationShaderParser : m_temporalAccumulationShaderParsers)
+	{
+		if (temporalAccumulationShaderParser->compileIfFileHasBeenModified())
+			anyShaderModified = true;
+	}
+	for (const std::array<std::unique_ptr<ShaderParser>, ShadowMaskSettings::RESOLUTION_DIVISOR_COUNT>& directionShaderParsers : m_denoiseShaderParsers)
+	{
+		for (const std::unique_ptr<ShaderParser>& denoiseShaderParser : directionShaderParsers)
+		{
+			if (denoiseShaderParser->compileIfFileHasBeenModified())
+				anyShaderModified = true;
+		}
+	}
 
 	if (anyShaderModified)
 	{
 		vkDeviceWaitIdle(context.device);
 		createPipelines();
 	}
+
+	m_upsampler->reloadShaderIfModified(context);
+}
+
+void RayTracedShadowsPass::saveMaskToFile(const std::string& filename, uint32_t maskIdx) const
+{
+	m_noisyMasks[maskIdx]->exportToFile(filename);
 }
 
-void RayTracedShadowsPass::saveMaskToFile(const std::string& filename) const
+void RayTracedShadowsPass::saveCleanMaskToFile(const std::string& filename) const
 {
-	m_outputMask->exportToFile(filename);
+	m_cleanMask->exportToFile(filename);
 }
 
 void RayTracedShadowsPass::createPipelines()
@@ -275,8 +386,6 @@ void RayTracedShadowsPass::createPipelines()
 	hitGroup.closestHitShaderIdx = 2;
 	shaderGroupGenerator.addHitGroup(hitGroup);
 
-	RayTracingPipelineCreateInfo pipelineCreateInfo;
-
 	std::vector<char> rayGenShaderCode;
 	m_rayGenShaderParser->readCompiledShader(rayGenShaderCode);
 	std::vector<char> rayMissShaderCode;
@@ -291,12 +400,9 @@ void RayTracedShadowsPass::createPipelines()
 	shaders[1].stage = VK_SHADER_STAGE_MISS_BIT_KHR;
 	shaders[2].shaderCode = closestHitShaderCode;
 	shaders[2].stage = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
-	pipelineCreateInfo.shaderCreateInfos = shaders;
-
-	pipelineCreateInfo.shaderGroupsCreateInfos = shaderGroupGenerator.getShaderGroups();
 
 	std::vector<VkDescriptorSetLayout> descriptorSetLayouts = { m_descriptorSetLayout->getDescriptorSetLayout(), GraphicCameraInterface::getDescriptorSetLayout() };
-	m_pipeline.reset(new Pipeline(pipelineCreateInfo, descriptorSetLayouts));
+	m_pipeline.reset(new RayTracingPipeline(shaders, shaderGroupGenerator.getShaderGroups(), descriptorSetLayouts));
 
 	m_shaderBindingTable.reset(new ShaderBindingTable(static_cast<uint32_t>(shaders.size()), m_pipeline->getPipeline()));
 
@@ -309,24 +415,68 @@ void RayTracedShadowsPass::createPipelines()
 	debugComputeShaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
 
 	std::vector<VkDescriptorSetLayout> debugDescriptorSetLayouts = { m_debugDescriptorSetLayout->getDescriptorSetLayout(), GraphicCameraInterface::getDescriptorSetLayout() };
-	m_debugPipeline.reset(new Pipeline(debugComputeShaderCreateInfo, debugDescriptorSetLayouts));
+	m_debugPipeline.reset(new ComputePipeline(debugComputeShaderCreateInfo, debugDescriptorSetLayouts));
+
+	// Temporal accumulation
+	std::vector<VkDescriptorSetLayout> temporalAccumulationDescriptorSetLayouts = { m_temporalAccumulationDescriptorSetLayout->getDescriptorSetLayout(), GraphicCameraInterface::getDescriptorSetLayout() };
+	for (uint32_t divisorIdx = 0; divisorIdx < ShadowMaskSettings::RESOLUTION_DIVISOR_COUNT; ++divisorIdx)
+	{
+		std::vector<char> temporalAccumulationShaderCode;
+		m_temporalAccumulationShaderParsers[divisorIdx]->readCompiledShader(temporalAccumulationShaderCode);
+
+		ShaderCreateInfo temporalAccumulationShaderCreateInfo;
+		temporalAccumulationShaderCreateInfo.shaderCode = temporalAccumulationShaderCode;
+		temporalAccumulationShaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		m_temporalAccumulationPipelines[divisorIdx].reset(new ComputePipeline(temporalAccumulationShaderCreateInfo, temporalAccumulationDescriptorSetLayouts));
+	}
+
+	// Denoise
+	std::vector<VkDescriptorSetLayout> denoiseDescriptorSetLayouts = { m_denoiseDescriptorSetLayout->getDescriptorSetLayout(), GraphicCameraInterface::getDescriptorSetLayout() };
+	for (uint32_t direction = 0; direction < DENOISE_DIRECTION_COUNT; ++direction)
+	{
+		for (uint32_t divisorIdx = 0; divisorIdx < ShadowMaskSettings::RESOLUTION_DIVISOR_COUNT; ++divisorIdx)
+		{
+			std::vector<char> denoiseComputeShaderCode;
+			m_denoiseShaderParsers[direction][divisorIdx]->readCompiledShader(denoiseComputeShaderCode);
+
+			ShaderCreateInfo denoiseComputeShaderCreateInfo;
+			denoiseComputeShaderCreateInfo.shaderCode = denoiseComputeShaderCode;
+			denoiseComputeShaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+
+			m_denoisePipelines[direction][divisorIdx].reset(new ComputePipeline(denoiseComputeShaderCreateInfo, denoiseDescriptorSetLayouts));
+		}
+	}
+}
+
+void RayTracedShadowsPass::waitForPipelineCreation()
+{
+	if (m_pipelineCreation.valid())
+		m_pipelineCreation.get();
 }
 
 void RayTracedShadowsPass::createDescriptorSet()
 {
-	DescriptorSetGenerator::ImageDescription outputImageDesc(VK_IMAGE_LAYOUT_GENERAL, m_outputMask->getDefaultImageView());
 	DescriptorSetGenerator::ImageDescription preDepthImageDesc{ VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_preDepthPass->getCopy()->getDefaultImageView() };
 
 	DescriptorSetGenerator descriptorSetGenerator(m_descriptorSetLayoutGenerator.getDescriptorLayouts());
 	descriptorSetGenerator.setAccelerationStructure(0, *m_topLevelAccelerationStructure);
-	descriptorSetGenerator.setImage(1, outputImageDesc);
 	descriptorSetGenerator.setImage(2, preDepthImageDesc);
 	descriptorSetGenerator.setBuffer(3, *m_uniformBuffer);
 	descriptorSetGenerator.setCombinedImageSampler(4, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_noiseImage->getDefaultImageView(), *m_noiseSampler);
+	DescriptorSetGenerator::ImageDescription cleanImageDesc(VK_IMAGE_LAYOUT_GENERAL, m_cleanMask->getDefaultImageView());
+	descriptorSetGenerator.setImage(5, cleanImageDesc);
+
+	m_descriptorSets.resize(getMaskCount());
+	for (uint32_t i = 0; i < getMaskCount(); ++i)
+	{
+		DescriptorSetGenerator::ImageDescription outputImageDesc(VK_IMAGE_LAYOUT_GENERAL, m_noisyMasks[i]->getDefaultImageView());
+		descriptorSetGenerator.setImage(1, outputImageDesc);
 
-	if (!m_descriptorSet)
-		m_descriptorSet.reset(new DescriptorSet(m_descriptorSetLayout->getDescriptorSetLayout(), UpdateRate::NEVER));
-	m_descriptorSet->update(descriptorSetGenerator.getDescriptorSetCreateInfo());
+		if (!m_descriptorSets[i])
+			m_descriptorSets[i].reset(new DescriptorSet(m_descriptorSetLayout->getDescriptorSetLayout(), UpdateRate::EACH_FRAME));
+		m_descriptorSets[i]->update(descriptorSetGenerator.getDescriptorSetCreateInfo());
+	}
 
 	DescriptorSetGenerator debugDescriptorSetGenerator(m_debugDescriptorSetLayoutGenerator.getDescriptorLayouts());
 	DescriptorSetGenerator::ImageDescription debugOutputImageDesc{ VK_IMAGE_LAYOUT_GENERAL, m_debugOutputImage->getDefaultImageView() };
@@ -337,22 +487,95 @@ void RayTracedShadowsPass::createDescriptorSet()
 	debugDescriptorSetGenerator.setImage(3, preDepthImageDesc);
 
 	if (!m_debugDescriptorSet)
-		m_debugDescriptorSet.reset(new DescriptorSet(m_debugDescriptorSetLayout->getDescriptorSetLayout(), UpdateRate::NEVER));
+		m_debugDescriptorSet.reset(new DescriptorSet(m_debugDescriptorSetLayout->getDescriptorSetLayout(), UpdateRate::EACH_FRAME));
 	m_debugDescriptorSet->update(debugDescriptorSetGenerator.getDescriptorSetCreateInfo());
+
+	// Temporal accumulation
+	DescriptorSetGenerator temporalAccumulationDescriptorSetGenerator(m_temporalAccumulationDescriptorSetLayoutGenerator.getDescriptorLayouts());
+	temporalAccumulationDescriptorSetGenerator.setImage(0, preDepthImageDesc);
+	temporalAccumulationDescriptorSetGenerator.setBuffer(4, *m_temporalAccumulationUniformBuffer);
+	m_temporalAccumulationDescriptorSets.resize(getMaskCount());
+	for (uint32_t i = 0; i < getMaskCount(); ++i)
+	{
+		DescriptorSetGenerator::ImageDescription noisyMaskDesc{ VK_IMAGE_LAYOUT_GENERAL, m_noisyMasks[i]->getDefaultImageView() };
+		temporalAccumulationDescriptorSetGenerator.setImage(1, noisyMaskDesc);
+		DescriptorSetGenerator::ImageDescription previousHistoryDesc{ VK_IMAGE_LAYOUT_GENERAL, m_historyMasks[(i + getMaskCount() - 1) % getMaskCount()]->getDefaultImageView() };
+		temporalAccumulationDescriptorSetGenerator.setImage(2, previousHistoryDesc);
+		DescriptorSetGenerator::ImageDescription historyDesc{ VK_IMAGE_LAYOUT_GENERAL, m_historyMasks[i]->getDefaultImageView() };
+		temporalAccumulationDescriptorSetGenerator.setImage(3, historyDesc);
+
+		if (!m_temporalAccumulationDescriptorSets[i])
+			m_temporalAccumulationDescriptorSets[i].reset(new DescriptorSet(m_temporalAccumulationDescriptorSetLayout->getDescriptorSetLayout(), UpdateRate::EACH_FRAME));
+		m_temporalAccumulationDescriptorSets[i]->update(temporalAccumulationDescriptorSetGenerator.getDescriptorSetCreateInfo());
+	}
+
+	// Denoise
+	DescriptorSetGenerator denoiseDescriptorSetGenerator(m_denoiseDescriptorSetLayoutGenerator.getDescriptorLayouts());
+	denoiseDescriptorSetGenerator.setImage(0, preDepthImageDesc);
+	for (uint32_t direction = 0; direction < DENOISE_DIRECTION_COUNT; ++direction)
+	{
+		const std::vector<std::unique_ptr<Image>>& inputMasks = direction == DENOISE_HORIZONTAL ? m_historyMasks : m_denoiseIntermediateMasks;
+		const std::vector<std::unique_ptr<Image>>& outputMasks = direction == DENOISE_HORIZONTAL ? m_denoiseIntermediateMasks : m_outputMasks;
+		m_denoiseDescriptorSets[direction].resize(getMaskCount());
+		for (uint32_t i = 0; i < getMaskCount(); ++i)
+		{
+			DescriptorSetGenerator::ImageDescription inputMaskDesc{ VK_IMAGE_LAYOUT_GENERAL, inputMasks[i]->getDefaultImageView() };
+			denoiseDescriptorSetGenerator.setImage(1, inputMaskDesc);
+			DescriptorSetGenerator::ImageDescription outputMaskDesc{ VK_IMAGE_LAYOUT_GENERAL, outputMasks[i]->getDefaultImageView() };
+			denoiseDescriptorSetGenerator.setImage(2, outputMaskDesc);
+
+			if (!m_denoiseDescriptorSets[direction][i])
+				m_denoiseDescriptorSets[direction][i].reset(new DescriptorSet(m_denoiseDescriptorSetLayout->getDescriptorSetLayout(), UpdateRate::NEVER));
+			m_denoiseDescriptorSets[direction][i]->update(denoiseDescriptorSetGenerator.getDescriptorSetCreateInfo());
+		}
+	}
 }
 
 void RayTracedShadowsPass::createOutputImages(uint32_t width, uint32_t height)
 {
 	CreateImageInfo createImageInfo;
-	createImageInfo.extent = { width, height, 1 };
+	createImageInfo.extent = { width, height, 1 }; // the mask resolution can be reduced at runtime without recreating them
 	createImageInfo.format = VK_FORMAT_R32_SFLOAT;
 	createImageInfo.mipLevelCount = 1;
 	createImageInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
 	createImageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
-	m_outputMask.reset(new Image(createImageInfo));
-	m_outputMask->setImageLayout({ VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR });
+	m_noisyMasks.resize(getMaskCount());
+	for (std::unique_ptr<Image>& noisyMask : m_noisyMasks)
+	{
+		noisyMask.reset(new Image(createImageInfo));
+		noisyMask->setImageLayout({ VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR });
+	}
+	m_cleanMask.reset(new Image(createImageInfo));
+	m_cleanMask->setImageLayout({ VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR });
+
+	createImageInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT; // shadow mean, shadow second moment, history length, linear depth
+	m_historyMasks.resize(getMaskCount());
+	for (std::unique_ptr<Image>& historyMask : m_historyMasks)
+	{
+		historyMask.reset(new Image(createImageInfo));
+		historyMask->setImageLayout({ VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
+	}
+	m_isHistoryValid = false; // new images are uninitialized
+
+	createImageInfo.format = VK_FORMAT_R32G32_SFLOAT; // shadow, filter radius
+	m_denoiseIntermediateMasks.resize(getMaskCount());
+	for (std::unique_ptr<Image>& intermediateMask : m_denoiseIntermediateMasks)
+	{
+		intermediateMask.reset(new Image(createImageInfo));
+		intermediateMask->setImageLayout({ VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
+	}
+
+	createImageInfo.format = VK_FORMAT_R32_SFLOAT;
+	createImageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT; // sampled by the upsampling
+	m_outputMasks.resize(getMaskCount());
+	for (std::unique_ptr<Image>& outputMask : m_outputMasks)
+	{
+		outputMask.reset(new Image(createImageInfo));
+		outputMask->setImageLayout({ VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
+	}
 
 	// Debug
+	createImageInfo.extent = { width, height, 1 };
 	createImageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
 	createImageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT; // needed to clear the image
 	createImageInfo.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
@@ -360,6 +583,117 @@ void RayTracedShadowsPass::createOutputImages(uint32_t width, uint32_t height)
 	m_debugOutputImage->setImageLayout({ VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
 }
 
+VkExtent2D RayTracedShadowsPass::getRayLaunchExtent(RayRate rayRate, const VkExtent3D& maskExtent)
+{
+	switch (rayRate)
+	{
+	case RayRate::Full:
+		return { maskExtent.width, maskExtent.height };
+	case RayRate::Checkerboard:
+		return { (maskExtent.width + 1) / 2, maskExtent.height };
+	case RayRate::Half:
+		return { (maskExtent.width + 1) / 2, (maskExtent.height + 1) / 2 };
+	case RayRate::Quarter:
+		return { (maskExtent.width + 3) / 4, (maskExtent.height + 3) / 4 };
+	}
+
+	return { maskExtent.width, maskExtent.height };
+}
+
+uint32_t RayTracedShadowsPass::getRayPatternCycleLength(RayRate rayRate)
+{
+	switch (rayRate)
+	{
+	case RayRate::Full:
+		return 1;
+	case RayRate::Checkerboard:
+		return 2;
+	case RayRate::Half:
+		return 4;
+	case RayRate::Quarter:
+		return 16;
+	}
+
+	return 1;
+}
+
+void RayTracedShadowsPass::recordTemporalAccumulation(VkCommandBuffer commandBuffer, const RecordContext& context, uint32_t resolutionDivisor, const VkExtent2D& maskExtent) const
+{
+	const ComputePipeline* pipeline = m_temporalAccumulationPipelines[ShadowMaskSettings::getResolutionDivisorIdx(resolutionDivisor)].get();
+	const uint32_t currentMaskIdx = context.currentFrameIdx % getMaskCount();
+	const uint32_t previousMaskIdx = (context.currentFrameIdx + getMaskCount() - 1) % getMaskCount();
+	const CameraInterface* camera = context.cameraList->getCamera(CommonCameraIndices::CAMERA_IDX_ACTIVE);
+
+	GPUProfiler::beginPassRegion(commandBuffer, DebugMarker::computePassDebugColor, "Ray traced shadows temporal accumulation", false);
+
+	// Noisy mask traced just before, history written by the previous frame
+	std::array<VkImageMemoryBarrier, 2> imageMemoryBarriers{};
+	for (VkImageMemoryBarrier& imageMemoryBarrier : imageMemoryBarriers)
+	{
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	}
+	imageMemoryBarriers[0].image = m_noisyMasks[currentMaskIdx]->getImage();
+	imageMemoryBarriers[1].image = m_historyMasks[previousMaskIdx]->getImage();
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+		static_cast<uint32_t>(imageMemoryBarriers.size()), imageMemoryBarriers.data());
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipeline());
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(), 0, 1,
+		m_temporalAccumulationDescriptorSets[currentMaskIdx]->getDescriptorSet(context.commandBufferIdx), 0, nullptr);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(), 1, 1, camera->getDescriptorSet()->getDescriptorSet(), 0, nullptr);
+
+	constexpr VkExtent3D dispatchGroups = { 16, 16, 1 };
+	const uint32_t groupSizeX = (maskExtent.width + dispatchGroups.width - 1) / dispatchGroups.width;
+	const uint32_t groupSizeY = (maskExtent.height + dispatchGroups.height - 1) / dispatchGroups.height;
+	vkCmdDispatch(commandBuffer, groupSizeX, groupSizeY, dispatchGroups.depth);
+
+	GPUProfiler::endPassRegion(commandBuffer);
+}
+
+void RayTracedShadowsPass::recordDenoising(VkCommandBuffer commandBuffer, const RecordContext& context, uint32_t resolutionDivisor, const VkExtent2D& maskExtent) const
+{
+	const uint32_t divisorIdx = ShadowMaskSettings::getResolutionDivisorIdx(resolutionDivisor);
+	const uint32_t currentMaskIdx = context.currentFrameIdx % getMaskCount();
+	const CameraInterface* camera = context.cameraList->getCamera(CommonCameraIndices::CAMERA_IDX_ACTIVE);
+
+	GPUProfiler::beginPassRegion(commandBuffer, DebugMarker::computePassDebugColor, "Ray traced shadows denoising", false);
+
+	constexpr VkExtent3D dispatchGroups = { 16, 16, 1 };
+	const uint32_t groupSizeX = (maskExtent.width + dispatchGroups.width - 1) / dispatchGroups.width;
+	const uint32_t groupSizeY = (maskExtent.height + dispatchGroups.height - 1) / dispatchGroups.height;
+
+	for (uint32_t direction = 0; direction < DENOISE_DIRECTION_COUNT; ++direction)
+	{
+		// Each pass reads what the previous one wrote
+		VkImageMemoryBarrier imageMemoryBarrier{};
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.image = direction == DENOISE_HORIZONTAL ? m_historyMasks[currentMaskIdx]->getImage() : m_denoiseIntermediateMasks[currentMaskIdx]->getImage();
+		imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+		const ComputePipeline* pipeline = m_denoisePipelines[direction][divisorIdx].get();
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipeline());
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(), 0, 1, m_denoiseDescriptorSets[direction][currentMaskIdx]->getDescriptorSet(), 0, nullptr);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(), 1, 1, camera->getDescriptorSet()->getDescriptorSet(), 0, nullptr);
+		vkCmdDispatch(commandBuffer, groupSizeX, groupSizeY, dispatchGroups.depth);
+	}
+
+	GPUProfiler::endPassRegion(commandBuffer);
+}
+
 float RayTracedShadowsPass::jitter()
 {
 	static std::default_random_engine generator;
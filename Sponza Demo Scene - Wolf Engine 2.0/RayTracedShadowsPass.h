@@ -1,5 +1,6 @@
 #pragma once
 
+#include <future>
 #include <glm/glm.hpp>
 
 #include <CommandRecordBase.h>
@@ -21,31 +22,47 @@ class PreDepthPass;
 class ObjectModel;
 class SharedGPUResources;
 
+#include "PipelineCache.h"
 #include "Sampler.h"
 #include "ShadowMaskBasePass.h"
+#include "ShadowMaskSettings.h"
+#include "ShadowMaskUpsampler.h"
 
 class RayTracedShadowsPass : public Wolf::CommandRecordBase, public ShadowMaskBasePass
 {
 public:
 	RayTracedShadowsPass(const Wolf::TopLevelAccelerationStructure* topLevelAccelerationStructure, const Wolf::ResourceNonOwner<PreDepthPass>& preDepthPass);
 
+	// Part of the mask pixels traced each frame, the others are reconstructed from their neighbours and the history. Values are also in "Shaders/rayTracedShadows/rayRate.glsl"
+	enum class RayRate { Full, Checkerboard, Half, Quarter };
+	void setRayRate(RayRate rayRate) { m_rayRate = rayRate; }
+
 	void initializeResources(const Wolf::InitializationContext& context) override;
 	void resize(const Wolf::InitializationContext& context) override;
 	void record(const Wolf::RecordContext& context) override;
 	void submit(const Wolf::SubmitContext& context) override;
 
-	Wolf::Image* getOutput(uint32_t frameIdx) override { return m_outputMask.get(); }
+	Wolf::Image* getOutput(uint32_t frameIdx, bool upsampled) override { return upsampled ? m_upsampler->getOutput(frameIdx % getMaskCount()) : m_outputMasks[frameIdx % getMaskCount()].get(); }
 	const Wolf::Semaphore* getSemaphore() const override { return Wolf::CommandRecordBase::getSemaphore(); }
-	void getConditionalBlocksToEnableWhenReadingMask(std::vector<std::string>& conditionalBlocks) const override { conditionalBlocks.emplace_back("RAYTRACED_SHADOWS"); }
-	Wolf::Image* getDenoisingPatternImage() override { return m_denoiseSamplingPattern.get(); }
+	void getConditionalBlocksToEnableWhenReadingMask(std::vector<std::string>& conditionalBlocks) const override {}
 	Wolf::Image* getDebugImage() const override { return m_debugOutputImage.get(); }
 
-	void saveMaskToFile(const std::string& filename) const;
+	void saveMaskToFile(const std::string& filename, uint32_t maskIdx) const;
+	void saveCleanMaskToFile(const std::string& filename) const;
+
+	// Ray budget of the last recorded frame
+	uint32_t getRayCount() const { return m_rayCount; }
+	uint32_t getMaskPixelCount() const { return m_maskPixelCount; }
 
 private:
 	void createPipelines();
+	void waitForPipelineCreation();
 	void createDescriptorSet();
 	void createOutputImages(uint32_t width, uint32_t height);
+	static VkExtent2D getRayLaunchExtent(RayRate rayRate, const VkExtent3D& maskExtent);
+	static uint32_t getRayPatternCycleLength(RayRate rayRate);
+	void recordTemporalAccumulation(VkCommandBuffer commandBuffer, const Wolf::RecordContext& context, uint32_t resolutionDivisor, const VkExtent2D& maskExtent) const;
+	void recordDenoising(VkCommandBuffer commandBuffer, const Wolf::RecordContext& context, uint32_t resolutionDivisor, const VkExtent2D& maskExtent) const;
 
 	static float jitter();
 
@@ -53,7 +70,8 @@ private:
 	const Wolf::TopLevelAccelerationStructure* m_topLevelAccelerationStructure;
 	Wolf::ResourceNonOwner<PreDepthPass> m_preDepthPass;
 
-	std::unique_ptr<Wolf::Pipeline> m_pipeline;
+	std::unique_ptr<RayTracingPipeline> m_pipeline;
+	std::future<void> m_pipelineCreation;
 
 	std::unique_ptr<Wolf::ShaderBindingTable> m_shaderBindingTable;
 	std::unique_ptr<Wolf::ShaderParser> m_rayGenShaderParser;
@@ -62,7 +80,7 @@ private:
 
 	std::unique_ptr<Wolf::DescriptorSetLayout> m_descriptorSetLayout;
 	Wolf::DescriptorSetLayoutGenerator m_descriptorSetLayoutGenerator;
-	std::unique_ptr<Wolf::DescriptorSet> m_descriptorSet;
+	std::vector<std::unique_ptr<Wolf::DescriptorSet>> m_descriptorSets;
 
 	struct ShadowUBData
 	{
@@ -70,9 +88,19 @@ private:
 
 		glm::uint drawWithoutNoiseFrameIndex; // 0 = draw with noise
 		float sunAreaAngle;
+		glm::uint resolutionDivisor;
+		glm::uint rayRate;
+		glm::uint rayPatternIndex; // traced pixels of the pattern, frame index for reduced ray rates
 	};
 	std::unique_ptr<Wolf::Buffer> m_uniformBuffer;
-	std::unique_ptr<Wolf::Image> m_outputMask;
+	std::vector<std::unique_ptr<Wolf::Image>> m_noisyMasks; // one ray per pixel, exported by the screenshots
+	std::unique_ptr<Wolf::Image> m_cleanMask; // the 16 frames of a clean screenshot add to the same image whatever the frame in flight
+	std::vector<std::unique_ptr<Wolf::Image>> m_outputMasks; // written and read by different queues, one per frame in flight. Allocated at the screen resolution, a reduced mask fills the top left part
+	std::unique_ptr<ShadowMaskUpsampler> m_upsampler; // only recorded with a reduced resolution
+
+	RayRate m_rayRate = RayRate::Full;
+	uint32_t m_rayCount = 0;
+	uint32_t m_maskPixelCount = 0;
 
 	// Noise
 	static constexpr uint32_t NOISE_TEXTURE_SIZE_PER_SIDE = 128;
@@ -82,7 +110,40 @@ private:
 
 	// Denoise
 	static constexpr uint32_t DENOISE_TEXTURE_SIZE = 25;
-	std::unique_ptr<Wolf::Image> m_denoiseSamplingPattern;
+	std::unique_ptr<Wolf::Image> m_denoiseSamplingPattern; // only used by the debug view
+
+	// Temporal accumulation of the noisy mask with its second moment, reprojected with the previous view matrix
+	std::vector<std::unique_ptr<Wolf::Image>> m_historyMasks; // one per frame in flight, each reads the previous one
+	std::array<std::unique_ptr<Wolf::ShaderParser>, ShadowMaskSettings::RESOLUTION_DIVISOR_COUNT> m_temporalAccumulationShaderParsers; // one per mask resolution
+	std::array<std::unique_ptr<ComputePipeline>, ShadowMaskSettings::RESOLUTION_DIVISOR_COUNT> m_temporalAccumulationPipelines;
+
+	std::unique_ptr<Wolf::DescriptorSetLayout> m_temporalAccumulationDescriptorSetLayout;
+	Wolf::DescriptorSetLayoutGenerator m_temporalAccumulationDescriptorSetLayoutGenerator;
+	std::vector<std::unique_ptr<Wolf::DescriptorSet>> m_temporalAccumulationDescriptorSets;
+	struct TemporalAccumulationUBData
+	{
+		glm::uint32_t enableTemporalAccumulation;
+		glm::uint32_t rayRate;
+		glm::uint32_t rayPatternIndex;
+	};
+	std::unique_ptr<Wolf::Buffer> m_temporalAccumulationUniformBuffer;
+	glm::vec3 m_previousSunDirection = glm::vec3(0.0f); // history is dropped when the light moves
+	float m_previousSunAreaAngle = 0.0f;
+	uint32_t m_previousResolutionDivisor = 1;
+	bool m_isHistoryValid = false;
+	uint32_t m_lastRecordedFrameIdx = 0; // history is dropped when the pass hasn't been recorded the previous frame (other shadow technique used)
+
+	// Separable blur of the accumulated mask, horizontal into the intermediate masks then vertical into the output masks. The radius follows the variance of the history
+	static constexpr uint32_t DENOISE_HORIZONTAL = 0;
+	static constexpr uint32_t DENOISE_VERTICAL = 1;
+	static constexpr uint32_t DENOISE_DIRECTION_COUNT = 2;
+	std::vector<std::unique_ptr<Wolf::Image>> m_denoiseIntermediateMasks;
+	std::array<std::array<std::unique_ptr<Wolf::ShaderParser>, ShadowMaskSettings::RESOLUTION_DIVISOR_COUNT>, DENOISE_DIRECTION_COUNT> m_denoiseShaderParsers; // [direction][mask resolution]
+	std::array<std::array<std::unique_ptr<ComputePipeline>, ShadowMaskSettings::RESOLUTION_DIVISOR_COUNT>, DENOISE_DIRECTION_COUNT> m_denoisePipelines;
+
+	std::unique_ptr<Wolf::DescriptorSetLayout> m_denoiseDescriptorSetLayout;
+	Wolf::DescriptorSetLayoutGenerator m_denoiseDescriptorSetLayoutGenerator;
+	std::array<std::vector<std::unique_ptr<Wolf::DescriptorSet>>, DENOISE_DIRECTION_COUNT> m_denoiseDescriptorSets;
 
 	// Debug
 	std::unique_ptr<Wolf::Image> m_debugOutputImage;
@@ -101,5 +162,5 @@ private:
 	};
 	std::unique_ptr<Wolf::Buffer> m_debugUniformBuffer;
 
-	std::unique_ptr<Wolf::Pipeline> m_debugPipeline;
+	std::unique_ptr<ComputePipeline> m_debugPipeline;
 };
\ No newline at end of file
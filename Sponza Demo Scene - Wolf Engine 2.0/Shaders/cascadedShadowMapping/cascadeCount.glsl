@@ -0,0 +1,22 @@
+// Number of cascades, the matching block is enabled by the C++ side (CascadeSettings.h)
+#if CASCADE_COUNT_2
+const uint CASCADES_COUNT = 2;
+#endif
+#if CASCADE_COUNT_3
+const uint CASCADES_COUNT = 3;
+#endif
+#if CASCADE_COUNT_4
+const uint CASCADES_COUNT = 4;
+#endif
+#if CASCADE_COUNT_5
+const uint CASCADES_COUNT = 5;
+#endif
+#if CASCADE_COUNT_6
+const uint CASCADES_COUNT = 6;
+#endif
+#if CASCADE_COUNT_7
+const uint CASCADES_COUNT = 7;
+#endif
+#if CASCADE_COUNT_8
+const uint CASCADES_COUNT = 8;
+#endif
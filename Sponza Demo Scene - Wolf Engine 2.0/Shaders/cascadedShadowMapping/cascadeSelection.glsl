@@ -0,0 +1,19 @@
+// Cascade selection shared by the shadow mask and its tile classification (tileClassification.comp), needs getCascadeSplit() and HALF_SEAM_RANGE
+
+// CASCADES_COUNT when the depth is beyond the last cascade
+uint selectCascade(in float viewDepth)
+{
+	for(uint i = 0; i < CASCADES_COUNT; ++i)
+	{
+		if(viewDepth <= getCascadeSplit(i))
+			return i;
+	}
+	return CASCADES_COUNT;
+}
+
+// Pixels close to a split are blended with the neighbour cascade
+bool isInCascadeSeam(in uint cascadeIndex, in float viewDepth)
+{
+	return (cascadeIndex != CASCADES_COUNT - 1 && getCascadeSplit(cascadeIndex) - viewDepth < HALF_SEAM_RANGE) ||
+		(cascadeIndex != 0 && viewDepth - getCascadeSplit(cascadeIndex - 1) < HALF_SEAM_RANGE);
+}
@@ -0,0 +1,10 @@
+#extension GL_ARB_separate_shader_objects : enable
+
+layout (location = 0) flat in vec4 inAtlasPixelBounds;
+
+void main()
+{
+    // Triangles crossing the cascade border would write in the neighbour cascades
+    if (any(lessThan(gl_FragCoord.xy, inAtlasPixelBounds.xy)) || any(greaterThanEqual(gl_FragCoord.xy, inAtlasPixelBounds.zw)))
+        discard;
+}
@@ -0,0 +1,20 @@
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0, set = 0) uniform UniformBufferTransform
+{
+    mat4 model;
+	mat4 previousModel;
+} ubTransform;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec3 inTangent;
+layout(location = 3) in vec2 inTexCoord;
+layout(location = 4) in uint inMaterialID;
+
+layout(location = 0) out vec3 outWorldPos;
+
+void main() 
+{
+	outWorldPos = (ubTransform.model * vec4(inPosition, 1.0)).xyz;
+}
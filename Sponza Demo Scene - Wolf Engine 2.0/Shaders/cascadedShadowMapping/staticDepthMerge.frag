@@ -0,0 +1,13 @@
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_samplerless_texture_functions : require
+
+layout (binding = 0) uniform texture2D staticDepthImage;
+
+void main()
+{
+    float staticDepth = texelFetch(staticDepthImage, ivec2(gl_FragCoord.xy), 0).r;
+    if (staticDepth >= 1.0) // no static caster, keep the cleared value
+        discard;
+
+    gl_FragDepth = staticDepth;
+}
@@ -1,10 +1,24 @@
 layout (binding = 0) uniform sampler2D tex;
 
+layout (binding = 1) uniform UniformBufferObject
+{
+	vec4 progress; // x: loading progress between 0 and 1
+} ubo;
+
 layout(location = 0) in vec2 inTexCoords;
 
 layout(location = 0) out vec4 outColor;
 
+const vec2 PROGRESS_BAR_MIN = vec2(0.1, 0.9);
+const vec2 PROGRESS_BAR_MAX = vec2(0.9, 0.915);
+
 void main() 
 {
 	outColor = vec4(texture(tex, inTexCoords).rgb , 1.0);
+
+	if (all(greaterThanEqual(inTexCoords, PROGRESS_BAR_MIN)) && all(lessThanEqual(inTexCoords, PROGRESS_BAR_MAX)))
+	{
+		float barPosition = (inTexCoords.x - PROGRESS_BAR_MIN.x) / (PROGRESS_BAR_MAX.x - PROGRESS_BAR_MIN.x);
+		outColor.rgb = barPosition <= ubo.progress.x ? vec3(0.8) : mix(outColor.rgb, vec3(0.1), 0.7);
+	}
 }
@@ -0,0 +1,42 @@
+// Ray rates of RayTracedShadowsPass::RayRate. Below the full rate, the pixels traced in a frame follow a pattern that cycles over the frames
+const uint RAY_RATE_FULL = 0;
+const uint RAY_RATE_CHECKERBOARD = 1; // 1 pixel out of 2, the parity alternates each frame
+const uint RAY_RATE_HALF = 2; // 1 pixel per 2x2 block
+const uint RAY_RATE_QUARTER = 3; // 1 pixel per 4x4 block
+
+// Order of the traced pixel in a block (Bayer), each pixel is traced once per cycle and successive ones are far apart
+const ivec2 BLOCK_2X2_ORDER[4] = ivec2[](ivec2(0, 0), ivec2(1, 1), ivec2(1, 0), ivec2(0, 1));
+const ivec2 BLOCK_4X4_ORDER[16] = ivec2[](ivec2(0, 0), ivec2(2, 2), ivec2(2, 0), ivec2(0, 2), ivec2(1, 1), ivec2(3, 3), ivec2(3, 1), ivec2(1, 3),
+    ivec2(1, 0), ivec2(3, 2), ivec2(3, 0), ivec2(1, 2), ivec2(0, 1), ivec2(2, 3), ivec2(2, 1), ivec2(0, 3));
+
+int getRayBlockSize(in uint rayRate)
+{
+    if (rayRate == RAY_RATE_HALF)
+        return 2;
+    if (rayRate == RAY_RATE_QUARTER)
+        return 4;
+    return 1;
+}
+
+// Mask pixel traced by a ray of the launch, may be out of the mask on its borders
+ivec2 getTracedPixel(in uvec2 launchId, in uint rayRate, in uint patternIndex)
+{
+    if (rayRate == RAY_RATE_CHECKERBOARD)
+        return ivec2(2 * launchId.x + ((launchId.y + patternIndex) & 1u), launchId.y);
+    if (rayRate == RAY_RATE_HALF)
+        return ivec2(launchId) * 2 + BLOCK_2X2_ORDER[patternIndex % 4];
+    if (rayRate == RAY_RATE_QUARTER)
+        return ivec2(launchId) * 4 + BLOCK_4X4_ORDER[patternIndex % 16];
+    return ivec2(launchId);
+}
+
+bool isTracedThisFrame(in ivec2 pixel, in uint rayRate, in uint patternIndex)
+{
+    if (rayRate == RAY_RATE_CHECKERBOARD)
+        return ((uint(pixel.x + pixel.y) + patternIndex) & 1u) == 0;
+    if (rayRate == RAY_RATE_HALF)
+        return all(equal(pixel % 2, BLOCK_2X2_ORDER[patternIndex % 4]));
+    if (rayRate == RAY_RATE_QUARTER)
+        return all(equal(pixel % 4, BLOCK_4X4_ORDER[patternIndex % 16]));
+    return true;
+}
@@ -29,30 +29,11 @@ layout(binding = 4, set = 3, std140) uniform readonly UniformBufferLighting
 layout (binding = 0, set = 2) uniform texture2D[] textures;
 layout (binding = 1, set = 2) uniform sampler textureSampler;
 
-#if RAYTRACED_SHADOWS
-layout (binding = 5, set = 3) uniform texture2D depthTexture;
-layout (binding = 6, set = 3, rg32f) uniform image2D denoisingSamplingPattern;
-#endif
-
 layout (location = 0) out vec4 outColor;
 layout (location = 1) out vec4 outVelocity;
 
 #include "ShaderCommon.glsl"
 
-#if RAYTRACED_SHADOWS
-vec3 viewPosFromDepth(vec2 screenSpaceUV)
-{
-    vec2 d = screenSpaceUV * 2.0f - 1.0f;
-    vec4 viewRay = getInvProjectionMatrix() * vec4(d.x, d.y, 1.0, 1.0);
-    float linearDepth = linearizeDepth(texture(sampler2D(depthTexture, textureSampler), screenSpaceUV).r);
-
-    return viewRay.xyz * linearDepth;
-}
-
-#define COMPUTE_SHADOWS
-#include "rayTracedShadows/denoising.glsl"
-#endif
-
 const mat4 biasMat = mat4( 
 	0.5, 0.0, 0.0, 0.0,
 	0.0, 0.5, 0.0, 0.0,
@@ -74,11 +55,7 @@ void main()
 	float metalness = texture(sampler2D(textures[inMaterialID * 5 + 3], textureSampler), inTexCoords).r;
     normal = normalize(normal);
 
-#if RAYTRACED_SHADOWS
-    float shadow = computeShadows();
-#else
-	float shadow = imageLoad(shadowMask, ivec2(gl_FragCoord.xy)).r;
-#endif
+	float shadow = imageLoad(shadowMask, ivec2(gl_FragCoord.xy)).r; // ray traced shadows are denoised by RayTracedShadowsPass
 
 	vec3 V = normalize(-inViewPos);
     vec3 R = reflect(-V, normal);
@@ -0,0 +1,14 @@
+#extension GL_ARB_separate_shader_objects : enable
+
+const uint PAGE_SIZE = 128;
+const uint STAGING_PAGE_COUNT_PER_SIDE = 8;
+
+layout (location = 0) flat in uint inStagingSlot;
+
+void main()
+{
+    // Triangles crossing the page border would write in the neighbour pages
+    vec2 pageMin = vec2(inStagingSlot % STAGING_PAGE_COUNT_PER_SIDE, inStagingSlot / STAGING_PAGE_COUNT_PER_SIDE) * float(PAGE_SIZE);
+    if (any(lessThan(gl_FragCoord.xy, pageMin)) || any(greaterThanEqual(gl_FragCoord.xy, pageMin + vec2(PAGE_SIZE))))
+        discard;
+}
@@ -0,0 +1,57 @@
+#include "ShadowAtlasLayout.h"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+static void packWithShelfWidth(std::span<const uint32_t> sizes, std::span<const uint32_t> sortedIndices, uint32_t maxShelfWidth, std::span<ShadowAtlasLayout::Rect> outRects, uint32_t& outWidth, uint32_t& outHeight)
+{
+	uint32_t x = 0, y = 0, shelfHeight = 0;
+	outWidth = 0;
+	for (const uint32_t idx : sortedIndices)
+	{
+		if (x > 0 && x + sizes[idx] > maxShelfWidth)
+		{
+			y += shelfHeight;
+			x = 0;
+			shelfHeight = 0;
+		}
+
+		outRects[idx] = { x, y, sizes[idx] };
+		x += sizes[idx];
+		shelfHeight = std::max(shelfHeight, sizes[idx]);
+		outWidth = std::max(outWidth, x);
+	}
+	outHeight = y + shelfHeight;
+}
+
+void ShadowAtlasLayout::pack(std::span<const uint32_t> sizes, std::span<Rect> outRects, uint32_t& outWidth, uint32_t& outHeight)
+{
+	std::vector<uint32_t> sortedIndices(sizes.size());
+	std::iota(sortedIndices.begin(), sortedIndices.end(), 0);
+	std::stable_sort(sortedIndices.begin(), sortedIndices.end(), [&sizes](uint32_t a, uint32_t b) { return sizes[a] > sizes[b]; });
+
+	std::vector<Rect> candidateRects(sizes.size());
+	uint64_t bestArea = UINT64_MAX;
+	uint32_t bestSide = UINT32_MAX;
+	uint32_t shelfWidth = 0;
+	for (const uint32_t idx : sortedIndices)
+	{
+		// The first shelf holds the largest maps up to this one
+		shelfWidth += sizes[idx];
+
+		uint32_t width, height;
+		packWithShelfWidth(sizes, sortedIndices, shelfWidth, candidateRects, width, height);
+
+		const uint64_t area = static_cast<uint64_t>(width) * height;
+		const uint32_t side = std::max(width, height);
+		if (area < bestArea || (area == bestArea && side < bestSide))
+		{
+			bestArea = area;
+			bestSide = side;
+			outWidth = width;
+			outHeight = height;
+			std::copy(candidateRects.begin(), candidateRects.end(), outRects.begin());
+		}
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+// Packing of square shadow maps of different sizes in a single atlas, doesn't depend on Vulkan so it can be checked on its own
+namespace ShadowAtlasLayout
+{
+	struct Rect
+	{
+		uint32_t x;
+		uint32_t y;
+		uint32_t size;
+	};
+
+	// Shelf packing, largest maps first. Every shelf width is tried and the smallest atlas is kept (the most square one when areas are equal)
+	void pack(std::span<const uint32_t> sizes, std::span<Rect> outRects, uint32_t& outWidth, uint32_t& outHeight);
+}
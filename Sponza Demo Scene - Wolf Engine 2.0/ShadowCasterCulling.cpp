@@ -0,0 +1,72 @@
+#include "ShadowCasterCulling.h"
+
+void ShadowCasterCulling::clear()
+{
+	m_centersX.clear();
+	m_centersY.clear();
+	m_centersZ.clear();
+	m_extentsX.clear();
+	m_extentsY.clear();
+	m_extentsZ.clear();
+	m_isDynamic.clear();
+}
+
+void ShadowCasterCulling::addCaster(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& transform, bool isDynamic)
+{
+	const glm::vec3 localCenter = (localMin + localMax) / 2.0f;
+	const glm::vec3 localExtent = (localMax - localMin) / 2.0f;
+
+	// World space AABB enclosing the transformed box
+	const glm::mat3 absoluteRotationScale(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2])));
+	const glm::vec3 center = transform * glm::vec4(localCenter, 1.0f);
+	const glm::vec3 extent = absoluteRotationScale * localExtent;
+
+	m_centersX.push_back(center.x);
+	m_centersY.push_back(center.y);
+	m_centersZ.push_back(center.z);
+	m_extentsX.push_back(extent.x);
+	m_extentsY.push_back(extent.y);
+	m_extentsZ.push_back(extent.z);
+	m_isDynamic.push_back(isDynamic ? 1 : 0);
+}
+
+void ShadowCasterCulling::cull(const glm::mat4& lightViewMatrix, const glm::vec2& lightSpaceCenter, float radius, float lightSpaceMaxZ, uint32_t& outVisibleCount, uint32_t& outVisibleDynamicCount) const
+{
+	// Rows of the light view matrix, the loop below only uses scalars to keep it easy to vectorize
+	const float r00 = lightViewMatrix[0][0], r01 = lightViewMatrix[1][0], r02 = lightViewMatrix[2][0], t0 = lightViewMatrix[3][0];
+	const float r10 = lightViewMatrix[0][1], r11 = lightViewMatrix[1][1], r12 = lightViewMatrix[2][1], t1 = lightViewMatrix[3][1];
+	const float r20 = lightViewMatrix[0][2], r21 = lightViewMatrix[1][2], r22 = lightViewMatrix[2][2], t2 = lightViewMatrix[3][2];
+
+	const float* centersX = m_centersX.data();
+	const float* centersY = m_centersY.data();
+	const float* centersZ = m_centersZ.data();
+	const float* extentsX = m_extentsX.data();
+	const float* extentsY = m_extentsY.data();
+	const float* extentsZ = m_extentsZ.data();
+	const uint32_t* isDynamic = m_isDynamic.data();
+
+	uint32_t visibleCount = 0;
+	uint32_t visibleDynamicCount = 0;
+	const uint32_t casterCount = getCasterCount();
+	for (uint32_t i = 0; i < casterCount; ++i)
+	{
+		const float lightSpaceX = r00 * centersX[i] + r01 * centersY[i] + r02 * centersZ[i] + t0;
+		const float lightSpaceY = r10 * centersX[i] + r11 * centersY[i] + r12 * centersZ[i] + t1;
+		const float lightSpaceZ = r20 * centersX[i] + r21 * centersY[i] + r22 * centersZ[i] + t2;
+
+		const float lightSpaceExtentX = glm::abs(r00) * extentsX[i] + glm::abs(r01) * extentsY[i] + glm::abs(r02) * extentsZ[i];
+		const float lightSpaceExtentY = glm::abs(r10) * extentsX[i] + glm::abs(r11) * extentsY[i] + glm::abs(r12) * extentsZ[i];
+		const float lightSpaceExtentZ = glm::abs(r20) * extentsX[i] + glm::abs(r21) * extentsY[i] + glm::abs(r22) * extentsZ[i];
+
+		const bool overlapsX = glm::abs(lightSpaceX - lightSpaceCenter.x) <= radius + lightSpaceExtentX;
+		const bool overlapsY = glm::abs(lightSpaceY - lightSpaceCenter.y) <= radius + lightSpaceExtentY;
+		const bool isInFrontOfReceivers = lightSpaceZ - lightSpaceExtentZ <= lightSpaceMaxZ;
+
+		const uint32_t isVisible = static_cast<uint32_t>(overlapsX & overlapsY & isInFrontOfReceivers);
+		visibleCount += isVisible;
+		visibleDynamicCount += isVisible & isDynamic[i];
+	}
+
+	outVisibleCount = visibleCount;
+	outVisibleDynamicCount = visibleDynamicCount;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Bounds of the shadow casting models added this frame, tested against the light-space volume of each cascade.
+// The render list draws whole models for every camera, the result only tells whether a cascade (or its dynamic part) has anything to draw, draws aren't filtered
+class ShadowCasterCulling
+{
+public:
+	void clear();
+	void addCaster(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& transform, bool isDynamic);
+
+	// A caster is kept if it overlaps the cascade square and isn't entirely behind the receivers.
+	// The volume is open toward the sun so that casters outside of the view still project their shadows
+	void cull(const glm::mat4& lightViewMatrix, const glm::vec2& lightSpaceCenter, float radius, float lightSpaceMaxZ, uint32_t& outVisibleCount, uint32_t& outVisibleDynamicCount) const;
+
+	uint32_t getCasterCount() const { return static_cast<uint32_t>(m_centersX.size()); }
+
+private:
+	// World space centers and half extents, stored as structure of arrays so that the culling loop is vectorized
+	std::vector<float> m_centersX, m_centersY, m_centersZ;
+	std::vector<float> m_extentsX, m_extentsY, m_extentsZ;
+	std::vector<uint32_t> m_isDynamic; // 0 or 1
+};
@@ -1 +1,10 @@
 #include "ShadowMaskBasePass.h"
+
+#include <Configuration.h>
+
+using namespace Wolf;
+
+uint32_t ShadowMaskBasePass::getMaskCount()
+{
+	return g_configuration->getMaxCachedFrames();
+}
@@ -13,12 +13,13 @@ namespace Wolf
 class ShadowMaskBasePass
 {
 public:
-	static constexpr uint32_t MASK_COUNT = 2;
+	// Masks are written and read by different queues, one per frame in flight
+	static uint32_t getMaskCount();
 
-	virtual Wolf::Image* getOutput(uint32_t frameIdx) = 0;
+	// Reduced resolution masks (ShadowMaskSettings) are read through their upsampled version
+	virtual Wolf::Image* getOutput(uint32_t frameIdx, bool upsampled) = 0;
 	virtual const Wolf::Semaphore* getSemaphore() const = 0;
 	virtual void getConditionalBlocksToEnableWhenReadingMask(std::vector<std::string>& conditionalBlocks) const = 0;
-	virtual Wolf::Image* getDenoisingPatternImage() = 0;
 	virtual Wolf::Image* getDebugImage() const { return nullptr; }
 };
 
@@ -1,16 +1,22 @@
 #include "ShadowMaskComputePass.h"
 
+#include <cstring>
 #include <random>
 
 #include <CameraInterface.h>
+#include <Configuration.h>
 #include <DescriptorSetGenerator.h>
 #include <ModelLoader.h>
+#include <Timer.h>
 
 #include "CameraList.h"
 #include "CommonLayout.h"
 #include "DebugMarker.h"
+#include "GameContext.h"
+#include "GPUProfiler.h"
 #include "GraphicCameraInterface.h"
 #include "PreDepthPass.h"
+#include "ShadowMaskSettings.h"
 
 using namespace Wolf;
 
@@ -24,20 +30,26 @@ void ShadowMaskComputePass::initializeResources(const Wolf::InitializationContex
 	m_commandBuffer.reset(new CommandBuffer(QueueType::COMPUTE, false /* isTransient */));
 	m_semaphore.reset(new Semaphore(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT));
 
-	m_computeShaderParser.reset(new ShaderParser("Shaders/cascadedShadowMapping/shader.comp", {}, 1));
-
 	m_descriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0, 1); // input depth
 	m_descriptorSetLayoutGenerator.addUniformBuffer(VK_SHADER_STAGE_COMPUTE_BIT, 1);
-	m_descriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2, CascadedShadowMapping::CASCADE_COUNT); // cascade depth images
+	m_descriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2, CascadedShadowMapping::CASCADE_COUNT + 1); // cascade depth images then the single pass atlas
 	m_descriptorSetLayoutGenerator.addSampler(VK_SHADER_STAGE_COMPUTE_BIT, 3);
 	m_descriptorSetLayoutGenerator.addCombinedImageSampler(VK_SHADER_STAGE_COMPUTE_BIT, 4); // noise map
-	m_descriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT, 5); // previous output mask
+	m_descriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT, 5); // previous output mask, history of the temporal accumulation
 	m_descriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT, 6); // output mask
+	m_descriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 7, CascadedShadowMapping::CASCADE_COUNT); // min/max depth pyramids
+	m_descriptorSetLayoutGenerator.addStorageBuffer(VK_SHADER_STAGE_COMPUTE_BIT, 8); // early-out statistics
+	m_descriptorSetLayoutGenerator.addStorageBuffer(VK_SHADER_STAGE_COMPUTE_BIT, 9); // tile lists
 	m_descriptorSetLayout.reset(new DescriptorSetLayout(m_descriptorSetLayoutGenerator.getDescriptorLayouts()));
 
-	m_uniformBuffer.reset(new Buffer(sizeof(ShadowUBData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::EACH_FRAME));
+	m_uniformBuffer.reset(new Buffer(sizeof(ShadowUBData<CascadedShadowMapping::CASCADE_COUNT>), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::EACH_FRAME));
 	m_shadowMapsSampler.reset(new Sampler(VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 1.0f, VK_FILTER_LINEAR));
 
+	m_earlyOutStatisticsBuffer.reset(new Buffer(sizeof(EarlyOutStatistics), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		UpdateRate::EACH_FRAME));
+	for (uint32_t i = 0; i < g_configuration->getMaxCachedFrames(); ++i)
+		m_earlyOutStatisticsBuffer->transferCPUMemory(&m_earlyOutStatistics, sizeof(m_earlyOutStatistics), 0, i);
+
 	// Noise
 	CreateImageInfo noiseImageCreateInfo;
 	noiseImageCreateInfo.extent = { NOISE_TEXTURE_SIZE_PER_SIDE, NOISE_TEXTURE_SIZE_PER_SIDE, NOISE_TEXTURE_PATTERN_SIZE_PER_SIDE * NOISE_TEXTURE_PATTERN_SIZE_PER_SIDE };
@@ -72,12 +84,27 @@ void ShadowMaskComputePass::initializeResources(const Wolf::InitializationContex
 
 	m_noiseSampler.reset(new Sampler(VK_SAMPLER_ADDRESS_MODE_REPEAT, 1.0f, VK_FILTER_NEAREST));
 
-	createPipeline();
+	// Shader compilation and pipeline creation don't use the queue, they run on a worker thread while the next passes are initialized
+	m_pipelineCreation = std::async(std::launch::async, [this]
+	{
+		Timer timer("Shadow mask pipeline creation");
+		m_tileClassificationShaderParser.reset(new ShaderParser("Shaders/cascadedShadowMapping/tileClassification.comp", { CascadeSettings::getCascadeCountShaderBlock() }, 1));
+		for (uint32_t tileListIdx = 0; tileListIdx < m_computeShaderParsers.size(); ++tileListIdx)
+		{
+			const std::string tileListShaderBlock = tileListIdx == SEAM_TILE_LIST ? "TILE_LIST_SEAMS" : "TILE_LIST_CASCADE_" + std::to_string(tileListIdx);
+			m_computeShaderParsers[tileListIdx].reset(new ShaderParser("Shaders/cascadedShadowMapping/shader.comp", { CascadeSettings::getCascadeCountShaderBlock(), tileListShaderBlock }, 1));
+		}
+		createPipelines();
+	});
 	createOutputImages(context.swapChainWidth, context.swapChainHeight);
+	createTileListsBuffer(context.swapChainWidth, context.swapChainHeight);
 
-	for(uint32_t i = 0; i < MASK_COUNT; ++i)
-		m_descriptorSets[i].reset(new DescriptorSet(m_descriptorSetLayout->getDescriptorSetLayout(), UpdateRate::EACH_FRAME));
+	m_upsampler.reset(new ShadowMaskUpsampler(m_preDepthPass));
+	m_upsampler->initializeResources(context.swapChainWidth, context.swapChainHeight, m_outputMasks);
+
+	createDescriptorSets();
 	updateDescriptorSet();
+	m_csmStorageVersion = m_csmPass->getStorageVersion();
 
 	for (float& noiseRotation : m_noiseRotations)
 	{
@@ -88,56 +115,141 @@ void ShadowMaskComputePass::initializeResources(const Wolf::InitializationContex
 void ShadowMaskComputePass::resize(const Wolf::InitializationContext& context)
 {
 	createOutputImages(context.swapChainWidth, context.swapChainHeight);
+	createTileListsBuffer(context.swapChainWidth, context.swapChainHeight);
+	m_upsampler->resize(context.swapChainWidth, context.swapChainHeight, m_outputMasks);
 	updateDescriptorSet();
 }
 
 void ShadowMaskComputePass::record(const Wolf::RecordContext& context)
 {
-	uint32_t currentMaskIdx = context.currentFrameIdx % MASK_COUNT;
+	waitForPipelineCreation();
+
+	// Cascade images are recreated by the cascade pass (recorded before) when its mode or resolution changes, the sets used by the frames in flight are kept until these frames are done
+	std::erase_if(m_retiredDescriptorSets, [&context](const auto& retiredDescriptorSets) { return context.currentFrameIdx - retiredDescriptorSets.first >= g_configuration->getMaxCachedFrames(); });
+	if (m_csmPass->getStorageVersion() != m_csmStorageVersion)
+	{
+		m_retiredDescriptorSets.emplace_back(context.currentFrameIdx, std::move(m_descriptorSets));
+		createDescriptorSets();
+		updateDescriptorSet();
+		m_csmStorageVersion = m_csmPass->getStorageVersion();
+	}
+
+	uint32_t currentMaskIdx = context.currentFrameIdx % getMaskCount();
 	const CameraInterface* camera = context.cameraList->getCamera(CommonCameraIndices::CAMERA_IDX_ACTIVE);
+	const GameContext* gameContext = static_cast<const GameContext*>(context.gameContext);
+
+	readStatistics(context.commandBufferIdx);
 
 	/* Update data */
-	ShadowUBData shadowUBData;
-		shadowUBData.cascadeSplits = glm::vec4(m_csmPass->getCascadeSplit(0), m_csmPass->getCascadeSplit(1), m_csmPass->getCascadeSplit(2), m_csmPass->getCascadeSplit(3));
+	ShadowUBData<CascadedShadowMapping::CASCADE_COUNT> shadowUBData{};
 	for (uint32_t cascadeIdx = 0; cascadeIdx < CascadedShadowMapping::CASCADE_COUNT; ++cascadeIdx)
 	{
 		m_csmPass->getCascadeMatrix(cascadeIdx, shadowUBData.cascadeMatrices[cascadeIdx]);
+		shadowUBData.cascadeSplits[cascadeIdx / 4][cascadeIdx % 4] = m_csmPass->getCascadeSplit(cascadeIdx);
+		shadowUBData.cascadeTextureSize[cascadeIdx / 4][cascadeIdx % 4] = m_csmPass->getCascadeTextureSize(cascadeIdx);
 	}
 
 	const glm::vec2 referenceScale = glm::vec2(glm::length(shadowUBData.cascadeMatrices[0][0]), glm::length(shadowUBData.cascadeMatrices[0][1]));
-	for (uint32_t cascadeIdx = 0; cascadeIdx < CascadedShadowMapping::CASCADE_COUNT / 2; ++cascadeIdx)
+	for (uint32_t cascadeIdx = 0; cascadeIdx < CascadedShadowMapping::CASCADE_COUNT; ++cascadeIdx)
 	{
-		glm::vec2 cascadeScale1 = glm::vec2(glm::length(shadowUBData.cascadeMatrices[2 * cascadeIdx][0]), glm::length(shadowUBData.cascadeMatrices[2 * cascadeIdx][1]));
-		glm::vec2 cascadeScale2 = glm::vec2(glm::length(shadowUBData.cascadeMatrices[2 * cascadeIdx + 1][0]), glm::length(shadowUBData.cascadeMatrices[2 * cascadeIdx + 1][1]));
-		shadowUBData.cascadeScales[cascadeIdx] = glm::vec4(cascadeScale1 / referenceScale, cascadeScale2 / referenceScale);
+		const glm::vec2 cascadeScale = glm::vec2(glm::length(shadowUBData.cascadeMatrices[cascadeIdx][0]), glm::length(shadowUBData.cascadeMatrices[cascadeIdx][1])) / referenceScale;
+		shadowUBData.cascadeScales[cascadeIdx / 2][2 * (cascadeIdx % 2)] = cascadeScale.x;
+		shadowUBData.cascadeScales[cascadeIdx / 2][2 * (cascadeIdx % 2) + 1] = cascadeScale.y;
 	}
 
-	shadowUBData.cascadeTextureSize = glm::uvec4(m_csmPass->getCascadeTextureSize(0), m_csmPass->getCascadeTextureSize(1), m_csmPass->getCascadeTextureSize(2), m_csmPass->getCascadeTextureSize(3));
+	shadowUBData.useShadowAtlas = m_csmPass->isSinglePassUsed() ? 1 : 0;
+	for (uint32_t cascadeIdx = 0; cascadeIdx < CascadedShadowMapping::CASCADE_COUNT; ++cascadeIdx)
+	{
+		m_csmPass->getCascadeAtlasScaleOffset(cascadeIdx, shadowUBData.cascadeAtlasScaleOffsets[cascadeIdx]);
+	}
 
 	shadowUBData.noiseRotation = m_noiseRotations[context.currentFrameIdx % m_noiseRotations.size()];
-	shadowUBData.screenSize = glm::uvec2(m_outputMasks[currentMaskIdx]->getExtent().width, m_outputMasks[currentMaskIdx]->getExtent().height);
+
+	// Rotations and pattern quarters both change each frame so that the history covers the whole pattern under different rotations
+	constexpr uint32_t PATTERN_PIXEL_COUNT = NOISE_TEXTURE_PATTERN_SIZE_PER_SIDE * NOISE_TEXTURE_PATTERN_SIZE_PER_SIDE;
+	shadowUBData.tapOffset = (context.currentFrameIdx * TEMPORAL_TAP_COUNT) % PATTERN_PIXEL_COUNT;
+	const uint32_t resolutionDivisor = gameContext->shadowMaskResolutionDivisor;
+	const bool isHistoryValid = m_isHistoryValid && context.currentFrameIdx == m_lastRecordedFrameIdx + 1 && resolutionDivisor == m_previousResolutionDivisor;
+	shadowUBData.enableTemporalAccumulation = gameContext->temporalShadowMask && isHistoryValid && gameContext->sunDirection == m_previousSunDirection ? 1 : 0;
+	m_previousSunDirection = gameContext->sunDirection;
+	m_previousResolutionDivisor = resolutionDivisor;
+	m_isHistoryValid = true;
+	m_lastRecordedFrameIdx = context.currentFrameIdx;
+	shadowUBData.screenSize = glm::uvec2(ShadowMaskSettings::getReducedSize(m_outputMasks[currentMaskIdx]->getExtent().width, resolutionDivisor),
+		ShadowMaskSettings::getReducedSize(m_outputMasks[currentMaskIdx]->getExtent().height, resolutionDivisor));
+	shadowUBData.maxTileCountPerList = m_maxTileCountPerList;
+	shadowUBData.resolutionDivisor = resolutionDivisor;
 
 	m_uniformBuffer->transferCPUMemory((void*)&shadowUBData, sizeof(shadowUBData), 0 /* srcOffet */, context.commandBufferIdx);
 
 	/* Command buffer record */
 	m_commandBuffer->beginCommandBuffer(context.commandBufferIdx);
+	const VkCommandBuffer commandBuffer = m_commandBuffer->getCommandBuffer(context.commandBufferIdx);
 
-	DebugMarker::beginRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), DebugMarker::computePassDebugColor, "Shadow Mask Compute Pass");
+	m_csmPass->recordDepthReduction(commandBuffer, context);
 
-	vkCmdBindDescriptorSets(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->getPipelineLayout(), 0, 1, 
+	// Statistics are cleared and every tile list is emptied
+	const VkBuffer earlyOutStatisticsBuffer = m_earlyOutStatisticsBuffer->getBuffer(context.commandBufferIdx);
+	vkCmdFillBuffer(commandBuffer, earlyOutStatisticsBuffer, 0, VK_WHOLE_SIZE, 0);
+
+	TileListsHeader tileListsHeader;
+	tileListsHeader.dispatchArgs.fill(glm::uvec4(0, 1, 1, 0));
+	const VkBuffer tileListsBuffer = m_tileListsBuffer->getBuffer(context.commandBufferIdx);
+	vkCmdUpdateBuffer(commandBuffer, tileListsBuffer, 0, sizeof(tileListsHeader), &tileListsHeader);
+
+	std::array<VkBufferMemoryBarrier, 2> bufferMemoryBarriers{};
+	for (VkBufferMemoryBarrier& bufferMemoryBarrier : bufferMemoryBarriers)
+	{
+		bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferMemoryBarrier.offset = 0;
+		bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+	}
+	bufferMemoryBarriers[0].buffer = earlyOutStatisticsBuffer;
+	bufferMemoryBarriers[1].buffer = tileListsBuffer;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, static_cast<uint32_t>(bufferMemoryBarriers.size()), bufferMemoryBarriers.data(), 0, nullptr);
+
+	GPUProfiler::beginPassRegion(commandBuffer, DebugMarker::computePassDebugColor, "Shadow Mask Compute Pass", false);
+
+	// Every pipeline has the same layout, descriptor sets stay bound
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_tileClassificationPipeline->getPipelineLayout(), 0, 1,
 		m_descriptorSets[currentMaskIdx]->getDescriptorSet(context.commandBufferIdx), 0, nullptr);
 
-	vkCmdBindDescriptorSets(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->getPipelineLayout(), 1, 1,
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_tileClassificationPipeline->getPipelineLayout(), 1, 1,
 		camera->getDescriptorSet()->getDescriptorSet(), 0, nullptr);
 
-	vkCmdBindPipeline(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->getPipeline());
+	// Tile classification
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_tileClassificationPipeline->getPipeline());
 
-	constexpr VkExtent3D dispatchGroups = { 16, 16, 1 };
-	const uint32_t groupSizeX = m_outputMasks[currentMaskIdx]->getExtent().width % dispatchGroups.width != 0 ? m_outputMasks[currentMaskIdx]->getExtent().width / dispatchGroups.width + 1 : m_outputMasks[currentMaskIdx]->getExtent().width / dispatchGroups.width;
-	const uint32_t groupSizeY = m_outputMasks[currentMaskIdx]->getExtent().height % dispatchGroups.height != 0 ? m_outputMasks[currentMaskIdx]->getExtent().height / dispatchGroups.height + 1 : m_outputMasks[currentMaskIdx]->getExtent().height / dispatchGroups.height;
-	vkCmdDispatch(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), groupSizeX, groupSizeY, dispatchGroups.depth);
+	const uint32_t tileCountX = (shadowUBData.screenSize.x + TILE_SIZE - 1) / TILE_SIZE;
+	const uint32_t tileCountY = (shadowUBData.screenSize.y + TILE_SIZE - 1) / TILE_SIZE;
+	vkCmdDispatch(commandBuffer, tileCountX, tileCountY, 1);
 
-	DebugMarker::endRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
+	bufferMemoryBarriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	bufferMemoryBarriers[1].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bufferMemoryBarriers[1], 0, nullptr);
+
+	// Shadow mask, skipped tiles have already been written by the classification
+	for (uint32_t tileListIdx = 0; tileListIdx < m_pipelines.size(); ++tileListIdx)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines[tileListIdx]->getPipeline());
+		vkCmdDispatchIndirect(commandBuffer, tileListsBuffer, tileListIdx * sizeof(glm::uvec4));
+	}
+
+	for (VkBufferMemoryBarrier& bufferMemoryBarrier : bufferMemoryBarriers)
+	{
+		bufferMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferMemoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	}
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, static_cast<uint32_t>(bufferMemoryBarriers.size()), bufferMemoryBarriers.data(), 0, nullptr);
+
+	GPUProfiler::endPassRegion(commandBuffer);
+
+	if (resolutionDivisor > 1)
+		m_upsampler->record(commandBuffer, context, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, resolutionDivisor);
 
 	m_commandBuffer->endCommandBuffer(context.commandBufferIdx);
 }
@@ -148,42 +260,83 @@ void ShadowMaskComputePass::submit(const Wolf::SubmitContext& context)
 	const std::vector signalSemaphores{ m_semaphore->getSemaphore() };
 	m_commandBuffer->submit(context.commandBufferIdx, waitSemaphores, signalSemaphores, VK_NULL_HANDLE);
 
-	if (m_computeShaderParser->compileIfFileHasBeenModified())
+	// Every parser is checked so that each of them compiles the modified file
+	bool isShaderModified = m_tileClassificationShaderParser->compileIfFileHasBeenModified();
+	for (const std::unique_ptr<ShaderParser>& computeShaderParser : m_computeShaderParsers)
+		isShaderModified |= computeShaderParser->compileIfFileHasBeenModified();
+
+	if (isShaderModified)
 	{
 		vkDeviceWaitIdle(context.device);
-		createPipeline();
+		createPipelines();
 	}
+
+	m_upsampler->reloadShaderIfModified(context);
 }
 
 void ShadowMaskComputePass::createOutputImages(uint32_t width, uint32_t height)
 {
 	CreateImageInfo createImageInfo;
 	createImageInfo.extent = { width, height, 1 };
-	createImageInfo.format = VK_FORMAT_R32G32_SFLOAT;
+	createImageInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT; // shadow, history length, view depth and normal to validate the history
 	createImageInfo.mipLevelCount = 1;
 	createImageInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
 	createImageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-	for (uint32_t i = 0; i < MASK_COUNT; ++i)
+	m_outputMasks.resize(getMaskCount());
+	for (uint32_t i = 0; i < getMaskCount(); ++i)
 	{
 		m_outputMasks[i].reset(new Image(createImageInfo));
 		m_outputMasks[i]->setImageLayout({ VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
 	}
+	m_isHistoryValid = false; // new images are uninitialized
 }
 
-void ShadowMaskComputePass::createPipeline()
+void ShadowMaskComputePass::createTileListsBuffer(uint32_t width, uint32_t height)
 {
-	// Compute shader parser
-	std::vector<char> computeShaderCode;
-	m_computeShaderParser->readCompiledShader(computeShaderCode);
+	m_maxTileCountPerList = ((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE);
 
-	ShaderCreateInfo computeShaderCreateInfo;
-	computeShaderCreateInfo.shaderCode = computeShaderCode;
-	computeShaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	const VkDeviceSize tileListsBufferSize = sizeof(TileListsHeader) + static_cast<VkDeviceSize>(TILE_LIST_COUNT) * m_maxTileCountPerList * sizeof(uint32_t);
+	m_tileListsBuffer.reset(new Buffer(tileListsBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::EACH_FRAME));
 
+	const TileListsHeader emptyTileListsHeader{};
+	for (uint32_t i = 0; i < g_configuration->getMaxCachedFrames(); ++i)
+		m_tileListsBuffer->transferCPUMemory(&emptyTileListsHeader, sizeof(emptyTileListsHeader), 0, i);
+}
+
+void ShadowMaskComputePass::createPipelines()
+{
 	std::vector<VkDescriptorSetLayout> descriptorSetLayouts(2);
 	descriptorSetLayouts[0] = m_descriptorSetLayout->getDescriptorSetLayout();
 	descriptorSetLayouts[1] = GraphicCameraInterface::getDescriptorSetLayout();
-	m_pipeline.reset(new Pipeline(computeShaderCreateInfo, descriptorSetLayouts));
+
+	auto createComputePipeline = [&descriptorSetLayouts](ShaderParser& computeShaderParser)
+	{
+		std::vector<char> computeShaderCode;
+		computeShaderParser.readCompiledShader(computeShaderCode);
+
+		ShaderCreateInfo computeShaderCreateInfo;
+		computeShaderCreateInfo.shaderCode = computeShaderCode;
+		computeShaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		return new ComputePipeline(computeShaderCreateInfo, descriptorSetLayouts);
+	};
+
+	m_tileClassificationPipeline.reset(createComputePipeline(*m_tileClassificationShaderParser));
+	for (uint32_t tileListIdx = 0; tileListIdx < m_pipelines.size(); ++tileListIdx)
+		m_pipelines[tileListIdx].reset(createComputePipeline(*m_computeShaderParsers[tileListIdx]));
+}
+
+void ShadowMaskComputePass::waitForPipelineCreation()
+{
+	if (m_pipelineCreation.valid())
+		m_pipelineCreation.get();
+}
+
+void ShadowMaskComputePass::createDescriptorSets()
+{
+	m_descriptorSets.resize(getMaskCount());
+	for (uint32_t i = 0; i < getMaskCount(); ++i)
+		m_descriptorSets[i].reset(new DescriptorSet(m_descriptorSetLayout->getDescriptorSetLayout(), UpdateRate::EACH_FRAME));
 }
 
 void ShadowMaskComputePass::updateDescriptorSet() const
@@ -195,21 +348,35 @@ void ShadowMaskComputePass::updateDescriptorSet() const
 	preDepthImageDesc.imageView = m_preDepthPass->getOutput()->getDefaultImageView();
 	descriptorSetGenerator.setImage(0, preDepthImageDesc);
 	descriptorSetGenerator.setBuffer(1, *m_uniformBuffer);
-	std::vector<DescriptorSetGenerator::ImageDescription> shadowMapImageDescriptions(CascadedShadowMapping::CASCADE_COUNT);
+	// Only the images of the current cascade mode exist, the slots of the other mode repeat one of them and aren't read
+	const Image* shadowAtlas = m_csmPass->getShadowAtlas();
+	std::vector<DescriptorSetGenerator::ImageDescription> shadowMapImageDescriptions(CascadedShadowMapping::CASCADE_COUNT + 1);
 	for (uint32_t i = 0; i < CascadedShadowMapping::CASCADE_COUNT; ++i)
 	{
+		const Image* shadowMap = m_csmPass->getShadowMap(i);
 		shadowMapImageDescriptions[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		shadowMapImageDescriptions[i].imageView = m_csmPass->getShadowMap(i)->getDefaultImageView();
+		shadowMapImageDescriptions[i].imageView = (shadowMap ? shadowMap : shadowAtlas)->getDefaultImageView();
 	}
+	shadowMapImageDescriptions[CascadedShadowMapping::CASCADE_COUNT].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	shadowMapImageDescriptions[CascadedShadowMapping::CASCADE_COUNT].imageView = (shadowAtlas ? shadowAtlas : m_csmPass->getShadowMap(0))->getDefaultImageView();
 	descriptorSetGenerator.setImages(2, shadowMapImageDescriptions);
 	descriptorSetGenerator.setSampler(3, *m_shadowMapsSampler);
 	descriptorSetGenerator.setCombinedImageSampler(4, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_noiseImage->getDefaultImageView(), *m_noiseSampler);
+	std::vector<DescriptorSetGenerator::ImageDescription> depthPyramidImageDescriptions(CascadedShadowMapping::CASCADE_COUNT);
+	for (uint32_t i = 0; i < CascadedShadowMapping::CASCADE_COUNT; ++i)
+	{
+		depthPyramidImageDescriptions[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		depthPyramidImageDescriptions[i].imageView = m_csmPass->getDepthPyramid(i)->getDefaultImageView();
+	}
+	descriptorSetGenerator.setImages(7, depthPyramidImageDescriptions);
+	descriptorSetGenerator.setBuffer(8, *m_earlyOutStatisticsBuffer);
+	descriptorSetGenerator.setBuffer(9, *m_tileListsBuffer);
 
-	for (uint32_t i = 0; i < MASK_COUNT; ++i)
+	for (uint32_t i = 0; i < getMaskCount(); ++i)
 	{
 		DescriptorSetGenerator::ImageDescription previousOutputImageDesc;
 		previousOutputImageDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-		previousOutputImageDesc.imageView = m_outputMasks[(i + 1) % MASK_COUNT]->getDefaultImageView();
+		previousOutputImageDesc.imageView = m_outputMasks[(i + getMaskCount() - 1) % getMaskCount()]->getDefaultImageView();
 		descriptorSetGenerator.setImage(5, previousOutputImageDesc);
 
 		DescriptorSetGenerator::ImageDescription outputImageDesc;
@@ -221,6 +388,20 @@ void ShadowMaskComputePass::updateDescriptorSet() const
 	}
 }
 
+void ShadowMaskComputePass::readStatistics(uint32_t commandBufferIdx)
+{
+	const void* mappedData = m_earlyOutStatisticsBuffer->map(commandBufferIdx);
+	memcpy(&m_earlyOutStatistics, mappedData, sizeof(m_earlyOutStatistics));
+	m_earlyOutStatisticsBuffer->unmap(commandBufferIdx);
+
+	TileListsHeader tileListsHeader;
+	mappedData = m_tileListsBuffer->map(commandBufferIdx);
+	memcpy(&tileListsHeader, mappedData, sizeof(tileListsHeader));
+	m_tileListsBuffer->unmap(commandBufferIdx);
+	for (uint32_t tileListIdx = 0; tileListIdx < TILE_LIST_COUNT; ++tileListIdx)
+		m_tileCounts[tileListIdx] = tileListsHeader.dispatchArgs[tileListIdx].x;
+}
+
 float ShadowMaskComputePass::jitter()
 {
 	static std::default_random_engine generator;
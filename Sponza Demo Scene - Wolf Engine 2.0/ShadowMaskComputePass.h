@@ -1,5 +1,6 @@
 #pragma once
 
+#include <future>
 #include <glm/glm.hpp>
 
 #include <CommandRecordBase.h>
@@ -11,7 +12,9 @@
 #include <ShaderParser.h>
 
 #include "CascadedShadowMapping.h"
+#include "PipelineCache.h"
 #include "ShadowMaskBasePass.h"
+#include "ShadowMaskUpsampler.h"
 
 class PreDepthPass;
 class SharedGPUResources;
@@ -26,52 +29,102 @@ public:
 	void record(const Wolf::RecordContext& context) override;
 	void submit(const Wolf::SubmitContext& context) override;
 
-	Wolf::Image* getOutput(uint32_t frameIdx) override { return m_outputMasks[frameIdx % MASK_COUNT].get(); }
+	Wolf::Image* getOutput(uint32_t frameIdx, bool upsampled) override { return upsampled ? m_upsampler->getOutput(frameIdx % getMaskCount()) : m_outputMasks[frameIdx % getMaskCount()].get(); }
 	const Wolf::Semaphore* getSemaphore() const override { return Wolf::CommandRecordBase::getSemaphore(); }
 	void getConditionalBlocksToEnableWhenReadingMask(std::vector<std::string>& conditionalBlocks) const override {}
-	Wolf::Image* getDenoisingPatternImage() override { return nullptr; }
+
+	// Cascade lookups of the last read back frame, lit and shadowed ones are decided with the depth pyramids without filtering
+	struct EarlyOutStatistics
+	{
+		uint32_t litLookupCount;
+		uint32_t shadowedLookupCount;
+		uint32_t filteredLookupCount;
+	};
+	const EarlyOutStatistics& getEarlyOutStatistics() const { return m_earlyOutStatistics; }
+
+	// Screen tiles are classified before the mask, each list is then dispatched indirectly with a kernel specialized for it. Same as tileClassification.comp
+	static constexpr uint32_t TILE_SIZE = 16;
+	static constexpr uint32_t SEAM_TILE_LIST = CascadedShadowMapping::CASCADE_COUNT; // tiles crossing a split or blending cascades, cascade is selected per pixel
+	static constexpr uint32_t SKIPPED_TILE_LIST = CascadedShadowMapping::CASCADE_COUNT + 1; // no receiver, written lit by the classification
+	static constexpr uint32_t TILE_LIST_COUNT = CascadedShadowMapping::CASCADE_COUNT + 2;
+	const std::array<uint32_t, TILE_LIST_COUNT>& getTileCounts() const { return m_tileCounts; } // last read back frame
 
 private:
 	void createOutputImages(uint32_t width, uint32_t height);
-	void createPipeline();
+	void createTileListsBuffer(uint32_t width, uint32_t height);
+	void createPipelines();
+	void waitForPipelineCreation();
+	void createDescriptorSets();
 	void updateDescriptorSet() const;
+	void readStatistics(uint32_t commandBufferIdx);
 
 	static float jitter();
 
 private:
-	/* Pipeline */
-	std::unique_ptr<Wolf::ShaderParser> m_computeShaderParser;
-	std::unique_ptr<Wolf::Pipeline> m_pipeline;
-	std::array<std::unique_ptr<Wolf::Image>, MASK_COUNT> m_outputMasks;
+	/* Pipelines */
+	std::unique_ptr<Wolf::ShaderParser> m_tileClassificationShaderParser;
+	std::unique_ptr<ComputePipeline> m_tileClassificationPipeline;
+	std::array<std::unique_ptr<Wolf::ShaderParser>, SKIPPED_TILE_LIST> m_computeShaderParsers; // one per dispatched tile list
+	std::array<std::unique_ptr<ComputePipeline>, SKIPPED_TILE_LIST> m_pipelines;
+	std::future<void> m_pipelineCreation;
+	std::vector<std::unique_ptr<Wolf::Image>> m_outputMasks; // allocated at the screen resolution, a reduced mask fills the top left part
+	std::unique_ptr<ShadowMaskUpsampler> m_upsampler; // only recorded with a reduced resolution
 
 	/* Resources */
 	Wolf::DescriptorSetLayoutGenerator m_descriptorSetLayoutGenerator;
 	std::unique_ptr<Wolf::DescriptorSetLayout> m_descriptorSetLayout;
-	std::array<std::unique_ptr<Wolf::DescriptorSet>, MASK_COUNT> m_descriptorSets;
+	std::vector<std::unique_ptr<Wolf::DescriptorSet>> m_descriptorSets;
 	std::array<float, 16> m_noiseRotations;
+	glm::vec3 m_previousSunDirection = glm::vec3(0.0f); // history is dropped when the light moves
+	uint32_t m_previousResolutionDivisor = 1; // or when the mask resolution changes
+	bool m_isHistoryValid = false;
+	uint32_t m_lastRecordedFrameIdx = 0; // history is dropped when the pass hasn't been recorded the previous frame (other shadow technique used)
 	Wolf::ResourceNonOwner<PreDepthPass> m_preDepthPass;
 	Wolf::ResourceNonOwner<CascadedShadowMapping> m_csmPass;
+	uint32_t m_csmStorageVersion = 0; // cascade images bound in the descriptor sets
+	// Sets of the previous cascade images, frames in flight may still use them
+	std::vector<std::pair<uint32_t /* retire frame */, std::vector<std::unique_ptr<Wolf::DescriptorSet>>>> m_retiredDescriptorSets;
+	// Scalars are packed in vec4 (split i is cascadeSplits[i / 4][i % 4]) to match the std140 layout of shader.comp
+	template <uint32_t CascadeCount>
 	struct ShadowUBData
 	{
 		glm::uvec2 screenSize;
-		glm::vec2 padding;
+		glm::uint32_t maxTileCountPerList;
+		glm::uint32_t resolutionDivisor;
 
-		std::array<glm::mat4, CascadedShadowMapping::CASCADE_COUNT> cascadeMatrices;
+		std::array<glm::mat4, CascadeCount> cascadeMatrices;
 
-		glm::vec4 cascadeSplits;
+		std::array<glm::vec4, (CascadeCount + 3) / 4> cascadeSplits;
 
-		std::array<glm::vec4, CascadedShadowMapping::CASCADE_COUNT / 2> cascadeScales;
+		std::array<glm::vec4, (CascadeCount + 1) / 2> cascadeScales;
 
-		glm::uvec4 cascadeTextureSize;
+		std::array<glm::uvec4, (CascadeCount + 3) / 4> cascadeTextureSize;
+
+		std::array<glm::vec4, CascadeCount> cascadeAtlasScaleOffsets; // only used with the single pass cascades
 
 		glm::float_t noiseRotation;
+		glm::uint32_t useShadowAtlas;
+		glm::uint32_t enableTemporalAccumulation;
+		glm::uint32_t tapOffset; // each frame takes TEMPORAL_TAP_COUNT taps of the noise pattern starting here
 	};
 	std::unique_ptr<Wolf::Buffer> m_uniformBuffer;
 	std::unique_ptr<Wolf::Sampler> m_shadowMapsSampler;
+	std::unique_ptr<Wolf::Buffer> m_earlyOutStatisticsBuffer; // one per frame in flight, read back by the CPU when the slot is reused
+	EarlyOutStatistics m_earlyOutStatistics{};
+
+	// Tile lists
+	struct TileListsHeader
+	{
+		std::array<glm::uvec4, TILE_LIST_COUNT> dispatchArgs; // VkDispatchIndirectCommand of each list, x is the tile count
+	};
+	std::unique_ptr<Wolf::Buffer> m_tileListsBuffer; // header then the tiles, one per frame in flight, the header is read back by the CPU when the slot is reused
+	uint32_t m_maxTileCountPerList = 0;
+	std::array<uint32_t, TILE_LIST_COUNT> m_tileCounts{};
 
 	// Noise
 	static constexpr uint32_t NOISE_TEXTURE_SIZE_PER_SIDE = 128;
 	static constexpr uint32_t NOISE_TEXTURE_PATTERN_SIZE_PER_SIDE = 4;
+	static constexpr uint32_t TEMPORAL_TAP_COUNT = 4; // also in shader.comp
 	std::unique_ptr<Wolf::Image> m_noiseImage;
 	std::unique_ptr<Wolf::Sampler> m_noiseSampler;
 };
\ No newline at end of file
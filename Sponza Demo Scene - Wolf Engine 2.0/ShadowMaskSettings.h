@@ -0,0 +1,28 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// Resolution of the shadow masks, selected at runtime (GameContext::shadowMaskResolutionDivisor).
+// Masks are allocated at the screen resolution and a reduced mask only fills their top left part, ShadowMaskUpsampler then brings it back to the screen resolution. Forward shading reads either of them the same way
+namespace ShadowMaskSettings
+{
+	constexpr std::array<uint32_t, 3> RESOLUTION_DIVISORS = { 1, 2, 4 }; // full, half and quarter resolution
+	constexpr uint32_t RESOLUTION_DIVISOR_COUNT = static_cast<uint32_t>(RESOLUTION_DIVISORS.size());
+
+	constexpr uint32_t getResolutionDivisorIdx(uint32_t resolutionDivisor)
+	{
+		for (uint32_t i = 0; i < RESOLUTION_DIVISOR_COUNT; ++i)
+		{
+			if (RESOLUTION_DIVISORS[i] == resolutionDivisor)
+				return i;
+		}
+		return 0;
+	}
+
+	constexpr uint32_t getReducedSize(uint32_t fullSize, uint32_t resolutionDivisor) { return (fullSize + resolutionDivisor - 1) / resolutionDivisor; }
+
+	// Shaders with a compile-time divisor get RESOLUTION_DIVISOR from this block, one pipeline per divisor
+	inline std::string getResolutionDivisorShaderBlock(uint32_t resolutionDivisor) { return "RESOLUTION_DIVISOR_" + std::to_string(resolutionDivisor); }
+}
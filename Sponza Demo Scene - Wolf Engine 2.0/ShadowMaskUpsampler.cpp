@@ -0,0 +1,168 @@
+#include "ShadowMaskUpsampler.h"
+
+#include <CameraInterface.h>
+#include <DescriptorSetGenerator.h>
+#include <Timer.h>
+
+#include "CameraList.h"
+#include "CommonLayout.h"
+#include "DebugMarker.h"
+#include "GPUProfiler.h"
+#include "GraphicCameraInterface.h"
+#include "PreDepthPass.h"
+#include "ShadowMaskSettings.h"
+
+using namespace Wolf;
+
+ShadowMaskUpsampler::ShadowMaskUpsampler(const Wolf::ResourceNonOwner<PreDepthPass>& preDepthPass) : m_preDepthPass(preDepthPass)
+{
+}
+
+void ShadowMaskUpsampler::initializeResources(uint32_t width, uint32_t height, const std::vector<std::unique_ptr<Wolf::Image>>& reducedMasks)
+{
+	m_descriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0, 1); // input depth
+	m_descriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1, 1); // reduced mask
+	m_descriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT, 2); // output mask
+	m_descriptorSetLayout.reset(new DescriptorSetLayout(m_descriptorSetLayoutGenerator.getDescriptorLayouts()));
+
+	// Shader compilation and pipeline creation don't use the queue, they run on a worker thread while the next passes are initialized
+	m_pipelineCreation = std::async(std::launch::async, [this]
+	{
+		Timer timer("Shadow mask upsampling pipeline creation");
+		for (uint32_t divisorIdx = 1; divisorIdx < ShadowMaskSettings::RESOLUTION_DIVISOR_COUNT; ++divisorIdx)
+		{
+			m_computeShaderParsers[divisorIdx].reset(new ShaderParser("Shaders/shadowMaskUpsampling/shader.comp",
+				{ ShadowMaskSettings::getResolutionDivisorShaderBlock(ShadowMaskSettings::RESOLUTION_DIVISORS[divisorIdx]) }, 1));
+		}
+		createPipeline();
+	});
+
+	m_descriptorSets.resize(reducedMasks.size());
+	for (std::unique_ptr<DescriptorSet>& descriptorSet : m_descriptorSets)
+		descriptorSet.reset(new DescriptorSet(m_descriptorSetLayout->getDescriptorSetLayout(), UpdateRate::NEVER));
+
+	resize(width, height, reducedMasks);
+}
+
+void ShadowMaskUpsampler::resize(uint32_t width, uint32_t height, const std::vector<std::unique_ptr<Wolf::Image>>& reducedMasks)
+{
+	m_reducedMasks.resize(reducedMasks.size());
+	for (uint32_t i = 0; i < reducedMasks.size(); ++i)
+		m_reducedMasks[i] = reducedMasks[i].get();
+	createOutputImages(width, height);
+	updateDescriptorSets();
+}
+
+void ShadowMaskUpsampler::record(VkCommandBuffer commandBuffer, const Wolf::RecordContext& context, VkPipelineStageFlags reducedMaskWriteStage, uint32_t resolutionDivisor)
+{
+	waitForPipelineCreation();
+
+	const ComputePipeline* pipeline = m_pipelines[ShadowMaskSettings::getResolutionDivisorIdx(resolutionDivisor)].get();
+	const uint32_t currentMaskIdx = context.currentFrameIdx % ShadowMaskBasePass::getMaskCount();
+	const CameraInterface* camera = context.cameraList->getCamera(CommonCameraIndices::CAMERA_IDX_ACTIVE);
+
+	GPUProfiler::beginPassRegion(commandBuffer, DebugMarker::computePassDebugColor, "Shadow mask upsampling", false);
+
+	VkImageMemoryBarrier imageMemoryBarrier{};
+	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.image = m_reducedMasks[currentMaskIdx]->getImage();
+	imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	vkCmdPipelineBarrier(commandBuffer, reducedMaskWriteStage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipeline());
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(), 0, 1, m_descriptorSets[currentMaskIdx]->getDescriptorSet(), 0, nullptr);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(), 1, 1, camera->getDescriptorSet()->getDescriptorSet(), 0, nullptr);
+
+	constexpr VkExtent3D dispatchGroups = { 16, 16, 1 };
+	const uint32_t groupSizeX = (m_outputMasks[currentMaskIdx]->getExtent().width + dispatchGroups.width - 1) / dispatchGroups.width;
+	const uint32_t groupSizeY = (m_outputMasks[currentMaskIdx]->getExtent().height + dispatchGroups.height - 1) / dispatchGroups.height;
+	vkCmdDispatch(commandBuffer, groupSizeX, groupSizeY, dispatchGroups.depth);
+
+	GPUProfiler::endPassRegion(commandBuffer);
+}
+
+void ShadowMaskUpsampler::reloadShaderIfModified(const Wolf::SubmitContext& context)
+{
+	// Every parser is checked so that each of them compiles the modified file
+	bool isShaderModified = false;
+	for (uint32_t divisorIdx = 1; divisorIdx < ShadowMaskSettings::RESOLUTION_DIVISOR_COUNT; ++divisorIdx)
+		isShaderModified |= m_computeShaderParsers[divisorIdx]->compileIfFileHasBeenModified();
+
+	if (isShaderModified)
+	{
+		vkDeviceWaitIdle(context.device);
+		createPipeline();
+	}
+}
+
+void ShadowMaskUpsampler::createOutputImages(uint32_t width, uint32_t height)
+{
+	CreateImageInfo createImageInfo;
+	createImageInfo.extent = { width, height, 1 };
+	createImageInfo.format = VK_FORMAT_R32_SFLOAT;
+	createImageInfo.mipLevelCount = 1;
+	createImageInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+	createImageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+	m_outputMasks.resize(m_reducedMasks.size());
+	for (std::unique_ptr<Image>& outputMask : m_outputMasks)
+	{
+		outputMask.reset(new Image(createImageInfo));
+		outputMask->setImageLayout({ VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
+	}
+}
+
+void ShadowMaskUpsampler::createPipeline()
+{
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts(2);
+	descriptorSetLayouts[0] = m_descriptorSetLayout->getDescriptorSetLayout();
+	descriptorSetLayouts[1] = GraphicCameraInterface::getDescriptorSetLayout();
+
+	for (uint32_t divisorIdx = 1; divisorIdx < ShadowMaskSettings::RESOLUTION_DIVISOR_COUNT; ++divisorIdx)
+	{
+		std::vector<char> computeShaderCode;
+		m_computeShaderParsers[divisorIdx]->readCompiledShader(computeShaderCode);
+
+		ShaderCreateInfo computeShaderCreateInfo;
+		computeShaderCreateInfo.shaderCode = computeShaderCode;
+		computeShaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		m_pipelines[divisorIdx].reset(new ComputePipeline(computeShaderCreateInfo, descriptorSetLayouts));
+	}
+}
+
+void ShadowMaskUpsampler::waitForPipelineCreation()
+{
+	if (m_pipelineCreation.valid())
+		m_pipelineCreation.get();
+}
+
+void ShadowMaskUpsampler::updateDescriptorSets() const
+{
+	DescriptorSetGenerator descriptorSetGenerator(m_descriptorSetLayoutGenerator.getDescriptorLayouts());
+
+	DescriptorSetGenerator::ImageDescription preDepthImageDesc;
+	preDepthImageDesc.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	preDepthImageDesc.imageView = m_preDepthPass->getOutput()->getDefaultImageView();
+	descriptorSetGenerator.setImage(0, preDepthImageDesc);
+
+	for (uint32_t i = 0; i < m_reducedMasks.size(); ++i)
+	{
+		DescriptorSetGenerator::ImageDescription reducedMaskDesc;
+		reducedMaskDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		reducedMaskDesc.imageView = m_reducedMasks[i]->getDefaultImageView();
+		descriptorSetGenerator.setImage(1, reducedMaskDesc);
+
+		DescriptorSetGenerator::ImageDescription outputImageDesc;
+		outputImageDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		outputImageDesc.imageView = m_outputMasks[i]->getDefaultImageView();
+		descriptorSetGenerator.setImage(2, outputImageDesc);
+
+		m_descriptorSets[i]->update(descriptorSetGenerator.getDescriptorSetCreateInfo());
+	}
+}
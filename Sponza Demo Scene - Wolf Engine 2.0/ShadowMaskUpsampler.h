@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <future>
+
+#include <CommandRecordBase.h>
+#include <DescriptorSet.h>
+#include <DescriptorSetLayout.h>
+#include <DescriptorSetLayoutGenerator.h>
+#include <Image.h>
+#include <Pipeline.h>
+#include <ResourceUniqueOwner.h>
+#include <ShaderParser.h>
+
+#include "PipelineCache.h"
+#include "ShadowMaskBasePass.h"
+#include "ShadowMaskSettings.h"
+
+class PreDepthPass;
+
+// Joint bilateral upsampling of a reduced resolution shadow mask (ShadowMaskSettings) to the screen resolution.
+// Owned by a shadow mask pass, it's recorded in the command buffer of the pass right after the reduced mask is written. Reduced masks are read in their red channel,
+// each reduced pixel holds the shadow of the full resolution pixel returned by getFullResolutionPixel in the producer shaders.
+// Reduced masks are allocated at the screen resolution so that the divisor can change without recreating them
+class ShadowMaskUpsampler
+{
+public:
+	ShadowMaskUpsampler(const Wolf::ResourceNonOwner<PreDepthPass>& preDepthPass);
+
+	void initializeResources(uint32_t width, uint32_t height, const std::vector<std::unique_ptr<Wolf::Image>>& reducedMasks);
+	void resize(uint32_t width, uint32_t height, const std::vector<std::unique_ptr<Wolf::Image>>& reducedMasks);
+	// 'reducedMaskWriteStage' is the stage writing the reduced mask in the same command buffer, 'resolutionDivisor' is the one used to write it (above 1)
+	void record(VkCommandBuffer commandBuffer, const Wolf::RecordContext& context, VkPipelineStageFlags reducedMaskWriteStage, uint32_t resolutionDivisor);
+	void reloadShaderIfModified(const Wolf::SubmitContext& context);
+
+	Wolf::Image* getOutput(uint32_t maskIdx) const { return m_outputMasks[maskIdx].get(); }
+
+private:
+	void createOutputImages(uint32_t width, uint32_t height);
+	void createPipeline();
+	void waitForPipelineCreation();
+	void updateDescriptorSets() const;
+
+	Wolf::ResourceNonOwner<PreDepthPass> m_preDepthPass;
+
+	// One per divisor, nothing to upsample at full resolution
+	std::array<std::unique_ptr<Wolf::ShaderParser>, ShadowMaskSettings::RESOLUTION_DIVISOR_COUNT> m_computeShaderParsers;
+	std::array<std::unique_ptr<ComputePipeline>, ShadowMaskSettings::RESOLUTION_DIVISOR_COUNT> m_pipelines;
+	std::future<void> m_pipelineCreation;
+
+	Wolf::DescriptorSetLayoutGenerator m_descriptorSetLayoutGenerator;
+	std::unique_ptr<Wolf::DescriptorSetLayout> m_descriptorSetLayout;
+	std::vector<std::unique_ptr<Wolf::DescriptorSet>> m_descriptorSets; // one per reduced mask
+	std::vector<Wolf::Image*> m_reducedMasks;
+	std::vector<std::unique_ptr<Wolf::Image>> m_outputMasks;
+};
@@ -1,86 +1,151 @@
 #include "SponzaScene.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <glm/ext.hpp>
 #include <fstream>
+#include <future>
 
+#include <Debug.h>
 #include <ImageFileLoader.h>
 #include <MipMapGenerator.h>
 
+#include "CascadeSettings.h"
 #include "CommonLayout.h"
 #include "GameContext.h"
+#include "LoadingTaskScheduler.h"
 
 using namespace Wolf;
 
-SponzaScene::SponzaScene(WolfEngine* wolfInstance, std::mutex* vulkanQueueLock)
+SponzaScene::SponzaScene(WolfEngine* wolfInstance, std::mutex* vulkanQueueLock, LoadingProgress* loadingProgress)
 {
+	const auto reportProgress = [loadingProgress](LoadingProgress::Step step, float stepProgress)
+	{
+		if (loadingProgress)
+			loadingProgress->setStep(step, stepProgress);
+	};
+
 	m_camera.reset(new FirstPersonCamera(glm::vec3(1.4f, 1.2f, 0.3f), glm::vec3(2.0f, 0.9f, -0.3f), glm::vec3(0.0f, 1.0f, 0.0f), 0.01f, 5.0f, 16.0f / 9.0f));
 
-	ModelLoadingInfo modelLoadingInfo;
-	modelLoadingInfo.filename = "Models/sponza/sponza.obj";
-	modelLoadingInfo.mtlFolder = "Models/sponza";
-	modelLoadingInfo.vulkanQueueLock = vulkanQueueLock;
-	modelLoadingInfo.loadMaterials = true;
-	modelLoadingInfo.materialIdOffset = 1;
+	// Models are parsed and their textures decoded on the CPU workers of the scheduler while its submission thread initializes the passes in dependency order.
+	// The engine uploads the models itself under 'vulkanQueueLock', which is also taken by the submission thread and the loading screen frames
+	LoadingTaskScheduler scheduler(vulkanQueueLock);
+
+	ModelLoadingInfo sponzaLoadingInfo;
+	sponzaLoadingInfo.filename = "Models/sponza/sponza.obj";
+	sponzaLoadingInfo.mtlFolder = "Models/sponza";
+	sponzaLoadingInfo.vulkanQueueLock = vulkanQueueLock;
+	sponzaLoadingInfo.loadMaterials = true;
+	sponzaLoadingInfo.materialIdOffset = 1;
 	if (wolfInstance->isRayTracingAvailable())
 	{
 		VkBufferUsageFlags rayTracingFlags = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-		modelLoadingInfo.additionalVertexBufferUsages = rayTracingFlags;
-		modelLoadingInfo.additionalIndexBufferUsages = rayTracingFlags;
+		sponzaLoadingInfo.additionalVertexBufferUsages = rayTracingFlags;
+		sponzaLoadingInfo.additionalIndexBufferUsages = rayTracingFlags;
 	}
-	m_sponzaModel.reset(new ModelBase(modelLoadingInfo, wolfInstance->isRayTracingAvailable(), wolfInstance->getBindlessDescriptor()));
-	m_sponzaModel->setTransform(glm::scale(glm::vec3(0.01f)));
-
-	modelLoadingInfo.filename = "Models/cube.obj";
-	modelLoadingInfo.mtlFolder = "Models";
-	modelLoadingInfo.loadMaterials = false;
-	modelLoadingInfo.materialIdOffset = 0;
-	m_cubeModel.reset(new ModelBase(modelLoadingInfo, wolfInstance->isRayTracingAvailable(), wolfInstance->getBindlessDescriptor()));
-
-	if (wolfInstance->isRayTracingAvailable())
+	const std::shared_future<void> sponzaLoading = scheduler.addCPUTask([this, wolfInstance, sponzaLoadingInfo]
 	{
-		BLASInstance blasInstance;
-		blasInstance.bottomLevelAS = m_sponzaModel->getBLAS();
-		blasInstance.hitGroupIndex = 0;
-		blasInstance.transform = m_sponzaModel->getTransform();
-		blasInstance.instanceID = 0;
-		std::vector<BLASInstance> blasInstances = { blasInstance };
-		m_tlas.reset(new TopLevelAccelerationStructure(blasInstances));
-	}
+		m_sponzaModel.reset(new ModelBase(sponzaLoadingInfo, wolfInstance->isRayTracingAvailable(), wolfInstance->getBindlessDescriptor()));
+		m_sponzaModel->setTransform(glm::scale(glm::vec3(0.01f)));
+	});
+
+	ModelLoadingInfo cubeLoadingInfo = sponzaLoadingInfo;
+	cubeLoadingInfo.filename = "Models/cube.obj";
+	cubeLoadingInfo.mtlFolder = "Models";
+	cubeLoadingInfo.loadMaterials = false;
+	cubeLoadingInfo.materialIdOffset = 0;
+	scheduler.addCPUTask([this, wolfInstance, cubeLoadingInfo]
+	{
+		m_cubeModel.reset(new ModelBase(cubeLoadingInfo, wolfInstance->isRayTracingAvailable(), wolfInstance->getBindlessDescriptor()));
+	});
 
+	constexpr float PASS_COUNT = 5.0f;
+	reportProgress(LoadingProgress::Step::PASSES_INITIALIZATION, 0.0f);
 	m_preDepthPass.reset(new PreDepthPass(true));
-	wolfInstance->initializePass(m_preDepthPass.createNonOwnerResource<CommandRecordBase>());
-
-	m_cascadedShadowMappingPass.reset(new CascadedShadowMapping);
-	wolfInstance->initializePass(m_cascadedShadowMappingPass.createNonOwnerResource<CommandRecordBase>());
-
+	m_cascadedShadowMappingPass.reset(new CascadedShadowMapping(m_preDepthPass.createNonOwnerResource()));
 	m_shadowMaskComputePass.reset(new ShadowMaskComputePass(m_preDepthPass.createNonOwnerResource(), m_cascadedShadowMappingPass.createNonOwnerResource()));
-	wolfInstance->initializePass(m_shadowMaskComputePass.createNonOwnerResource<CommandRecordBase>());
+	m_virtualShadowMapPass.reset(new VirtualShadowMapPass(m_preDepthPass.createNonOwnerResource()));
+	m_rayTracedGlobalIlluminationPass.reset(new RTGIPass(m_preDepthPass.createNonOwnerResource(), vulkanQueueLock));
+
+	const auto addPassInitialization = [&scheduler, wolfInstance, reportProgress](const ResourceNonOwner<CommandRecordBase>& pass, float progress)
+	{
+		scheduler.addGPUTask([wolfInstance, reportProgress, pass, progress]
+		{
+			wolfInstance->initializePass(pass);
+			reportProgress(LoadingProgress::Step::PASSES_INITIALIZATION, progress);
+		});
+	};
+	addPassInitialization(m_preDepthPass.createNonOwnerResource<CommandRecordBase>(), 1.0f / PASS_COUNT);
+	addPassInitialization(m_cascadedShadowMappingPass.createNonOwnerResource<CommandRecordBase>(), 2.0f / PASS_COUNT);
+	addPassInitialization(m_shadowMaskComputePass.createNonOwnerResource<CommandRecordBase>(), 3.0f / PASS_COUNT);
+	addPassInitialization(m_virtualShadowMapPass.createNonOwnerResource<CommandRecordBase>(), 4.0f / PASS_COUNT);
+	scheduler.addGPUTask([this, wolfInstance, reportProgress]
+	{
+		wolfInstance->initializePass(m_rayTracedGlobalIlluminationPass.createNonOwnerResource<CommandRecordBase>());
+		reportProgress(LoadingProgress::Step::MODEL_LOADING, 0.0f);
+	}, {}, false /* takes the lock itself to load its debug model */);
 
 	if (wolfInstance->isRayTracingAvailable())
 	{
-		m_rayTracedShadowsPass.reset(new RayTracedShadowsPass(m_tlas.get(), m_preDepthPass.createNonOwnerResource()));
-		wolfInstance->initializePass(m_rayTracedShadowsPass.createNonOwnerResource<CommandRecordBase>());
+		scheduler.addGPUTask([this, reportProgress]
+		{
+			reportProgress(LoadingProgress::Step::ACCELERATION_STRUCTURES_BUILD, 0.0f);
+
+			BLASInstance blasInstance;
+			blasInstance.bottomLevelAS = m_sponzaModel->getBLAS();
+			blasInstance.hitGroupIndex = 0;
+			blasInstance.transform = m_sponzaModel->getTransform();
+			blasInstance.instanceID = 0;
+			std::vector<BLASInstance> blasInstances = { blasInstance };
+			m_tlas.reset(new TopLevelAccelerationStructure(blasInstances));
+
+			m_rayTracedShadowsPass.reset(new RayTracedShadowsPass(m_tlas.get(), m_preDepthPass.createNonOwnerResource()));
+		}, { sponzaLoading });
+		scheduler.addGPUTask([this, wolfInstance] { wolfInstance->initializePass(m_rayTracedShadowsPass.createNonOwnerResource<CommandRecordBase>()); });
 	}
 
-	const ResourceNonOwner<ShadowMaskBasePass> shadowPass = m_currentPassState.shadowType == ShadowType::CSM ? m_shadowMaskComputePass.createNonOwnerResource<ShadowMaskBasePass>() : 
-		m_rayTracedShadowsPass.createNonOwnerResource<ShadowMaskBasePass>();
-
-	m_rayTracedGlobalIlluminationPass.reset(new RTGIPass(m_preDepthPass.createNonOwnerResource(), vulkanQueueLock));
+	// Indexed by ShadowType. The ray traced shadows pass is created by a GPU task, the forward pass is created after it on the submission thread
+	std::vector<ResourceNonOwner<ShadowMaskBasePass>> shadowPasses = { m_shadowMaskComputePass.createNonOwnerResource<ShadowMaskBasePass>(),
+		m_virtualShadowMapPass.createNonOwnerResource<ShadowMaskBasePass>() };
+	scheduler.addGPUTask([this, wolfInstance, reportProgress, &shadowPasses]
+	{
+		if (wolfInstance->isRayTracingAvailable())
+			shadowPasses.push_back(m_rayTracedShadowsPass.createNonOwnerResource<ShadowMaskBasePass>());
 
-	m_forwardPass.reset(new ForwardPass(m_preDepthPass.createNonOwnerResource(), shadowPass,
-		m_rayTracedGlobalIlluminationPass.createNonOwnerResource()));
-	wolfInstance->initializePass(m_forwardPass.createNonOwnerResource<CommandRecordBase>());
-	
-	m_taaComposePass.reset(new TemporalAntiAliasingPass(m_preDepthPass.createNonOwnerResource(), m_forwardPass.createNonOwnerResource()));
-	wolfInstance->initializePass(m_taaComposePass.createNonOwnerResource<CommandRecordBase>());
+		reportProgress(LoadingProgress::Step::ACCELERATION_STRUCTURES_BUILD, 0.5f);
+		m_forwardPass.reset(new ForwardPass(m_preDepthPass.createNonOwnerResource(), shadowPasses,
+			m_rayTracedGlobalIlluminationPass.createNonOwnerResource()));
+		wolfInstance->initializePass(m_forwardPass.createNonOwnerResource<CommandRecordBase>());
+		m_forwardPass->setShadowMaskPassIdx(static_cast<uint32_t>(m_currentPassState.shadowType));
 
-	wolfInstance->initializePass(m_rayTracedGlobalIlluminationPass.createNonOwnerResource<CommandRecordBase>());
+		m_taaComposePass.reset(new TemporalAntiAliasingPass(m_preDepthPass.createNonOwnerResource(), m_forwardPass.createNonOwnerResource()));
+		wolfInstance->initializePass(m_taaComposePass.createNonOwnerResource<CommandRecordBase>());
+	});
+	scheduler.waitIdle();
 
 	m_sponzaModel->updateGraphic();
 	m_sponzaModel->updateGraphic(); // call twice to set previous matrix
 	m_cubeModel->updateGraphic();
 
-	initializePipelineSets(wolfInstance, shadowPass);
+	// Pipelines for all shadow types are created now so that switching doesn't have to compile them. Shadow types reading the mask with the same forward shader share their pipelines
+	std::vector<std::vector<std::string>> forwardConditionalBlocksPerPipelineSet;
+	for (uint32_t shadowTypeIdx = 0; shadowTypeIdx < shadowPasses.size(); ++shadowTypeIdx)
+	{
+		std::vector<std::string> forwardConditionalBlocks;
+		shadowPasses[shadowTypeIdx]->getConditionalBlocksToEnableWhenReadingMask(forwardConditionalBlocks);
+
+		const auto sharedPipelineSet = std::find(forwardConditionalBlocksPerPipelineSet.begin(), forwardConditionalBlocksPerPipelineSet.end(), forwardConditionalBlocks);
+		m_pipelineSetIdxPerShadowType[shadowTypeIdx] = static_cast<uint32_t>(sharedPipelineSet - forwardConditionalBlocksPerPipelineSet.begin());
+		if (sharedPipelineSet != forwardConditionalBlocksPerPipelineSet.end())
+			continue;
+
+		reportProgress(LoadingProgress::Step::PIPELINES_CREATION, static_cast<float>(shadowTypeIdx) / static_cast<float>(shadowPasses.size()));
+		forwardConditionalBlocksPerPipelineSet.push_back(forwardConditionalBlocks);
+		m_sponzaPipelineSets.emplace_back();
+		initializePipelineSet(m_pipelineSetIdxPerShadowType[shadowTypeIdx], false /* isDynamic */, forwardConditionalBlocks);
+		initializePipelineSet(m_pipelineSetIdxPerShadowType[shadowTypeIdx], true /* isDynamic */, forwardConditionalBlocks);
+	}
+	usePipelineSet(m_currentPassState.shadowType);
 }
 
 static uint32_t screenshotId = 0;
@@ -88,22 +153,26 @@ static bool requestedScreenshot = false;
 void SponzaScene::update(WolfEngine* wolfInstance, GameContext& gameContext)
 {
 	// Handle pass state changes
-	const PassState nextPassState = m_nextPassState; // copy info as 'm_nextPassState' can be changed between here and line 'm_currentPassState = nextPassState;'
+	// Resources for every state are created at load time and never destroyed, frames in flight can keep using the previous ones
+	PassState nextPassState = m_nextPassState; // copy info as 'm_nextPassState' can be changed between here and line 'm_currentPassState = nextPassState;'
+	if (nextPassState.shadowType == ShadowType::RayTraced && !m_tlas)
+	{
+		Debug::sendWarning("Ray tracing is not available on this device");
+		nextPassState.shadowType = m_currentPassState.shadowType;
+	}
 	if(nextPassState.shadowType != m_currentPassState.shadowType)
 	{
-		wolfInstance->waitIdle();
-		const ResourceNonOwner<ShadowMaskBasePass> shadowPass = nextPassState.shadowType == ShadowType::CSM ? m_shadowMaskComputePass.createNonOwnerResource<ShadowMaskBasePass>() :
-			m_rayTracedShadowsPass.createNonOwnerResource<ShadowMaskBasePass>();
-		m_forwardPass->setShadowMaskPass(shadowPass);
-		m_forwardPass->setDebugMode(nextPassState.debugMode); // changing shadow type might change debug image
-		initializePipelineSets(wolfInstance, shadowPass);
-		m_rayTracedGlobalIlluminationPass->initializeDebugPipelineSet();
+		m_forwardPass->setShadowMaskPassIdx(static_cast<uint32_t>(nextPassState.shadowType));
+		usePipelineSet(nextPassState.shadowType);
 	}
-	else if (nextPassState.debugMode != m_currentPassState.debugMode)
+	if (nextPassState.debugMode != m_currentPassState.debugMode)
 	{
-		wolfInstance->waitIdle();
 		m_forwardPass->setDebugMode(nextPassState.debugMode);
 	}
+	if (nextPassState.rayTracedShadowsRayRate != m_currentPassState.rayTracedShadowsRayRate && m_tlas)
+	{
+		m_rayTracedShadowsPass->setRayRate(nextPassState.rayTracedShadowsRayRate);
+	}
 	m_currentPassState = nextPassState;
 
 	// Add meshes
@@ -113,6 +182,8 @@ void SponzaScene::update(WolfEngine* wolfInstance, GameContext& gameContext)
 		m_rayTracedGlobalIlluminationPass->addDebugMeshesToRenderList(wolfInstance->getRenderMeshList());
 
 	// Add cameras
+	if (gameContext.overrideCamera)
+		m_camera->overrideMatrices(glm::lookAt(gameContext.cameraOverridePosition, gameContext.cameraOverrideTarget, glm::vec3(0.0f, 1.0f, 0.0f)), m_camera->getProjectionMatrix());
 	m_camera->setEnableJittering(gameContext.enableTAA);
 	wolfInstance->getCameraList().addCameraForThisFrame(m_camera.get(), CommonCameraIndices::CAMERA_IDX_ACTIVE);
 	if (m_currentPassState.shadowType == ShadowType::CSM)
@@ -122,12 +193,29 @@ void SponzaScene::update(WolfEngine* wolfInstance, GameContext& gameContext)
 
 	wolfInstance->updateBeforeFrame();
 
-	const auto currentTime = std::chrono::high_resolution_clock::now();
-	const long long offsetInMicrosecond = std::chrono::duration_cast<std::chrono::microseconds>(currentTime - m_startTime).count();
-	const float offsetInSeconds = static_cast<float>(offsetInMicrosecond) / 1'000'000.0f;
+	float offsetInSeconds = gameContext.animationTimeInSeconds;
+	if (!gameContext.useFixedAnimationTime)
+	{
+		const auto currentTime = std::chrono::high_resolution_clock::now();
+		const long long offsetInMicrosecond = std::chrono::duration_cast<std::chrono::microseconds>(currentTime - m_startTime).count();
+		offsetInSeconds = static_cast<float>(offsetInMicrosecond) / 1'000'000.0f;
+	}
 	m_cubeModel->setPosition(glm::vec3(5.0f * glm::sin(offsetInSeconds), 2.0f, 0.0f));
 	m_cubeModel->updateGraphic();
 
+	// Shadow casters are culled per cascade when the cascades are recorded
+	if (m_currentPassState.shadowType == ShadowType::CSM)
+	{
+		m_cascadedShadowMappingPass->addShadowCasterForThisFrame(m_sponzaModel->getAABB().getMin(), m_sponzaModel->getAABB().getMax(), m_sponzaModel->getTransform(), m_isSponzaDynamic);
+		m_cascadedShadowMappingPass->addShadowCasterForThisFrame(m_cubeModel->getAABB().getMin(), m_cubeModel->getAABB().getMax(), m_cubeModel->getTransform(), m_isCubeDynamic);
+	}
+	// They bound the virtual shadow map and dynamic ones invalidate the cached pages they cover
+	else if (m_currentPassState.shadowType == ShadowType::Virtual)
+	{
+		m_virtualShadowMapPass->addShadowCasterForThisFrame(m_sponzaModel->getAABB().getMin(), m_sponzaModel->getAABB().getMax(), m_sponzaModel->getTransform(), m_isSponzaDynamic);
+		m_virtualShadowMapPass->addShadowCasterForThisFrame(m_cubeModel->getAABB().getMin(), m_cubeModel->getAABB().getMax(), m_cubeModel->getTransform(), m_isCubeDynamic);
+	}
+
 	gameContext.shadowmapScreenshotsRequested = false;
 	if(wolfInstance->getInputHandler()->keyPressedThisFrame(GLFW_KEY_ESCAPE))
 	{
@@ -225,6 +313,10 @@ void SponzaScene::frame(WolfEngine* wolfInstance)
 		passes.push_back(m_cascadedShadowMappingPass.createNonOwnerResource<CommandRecordBase>());
 		passes.push_back(m_shadowMaskComputePass.createNonOwnerResource<CommandRecordBase>());
 	}
+	else if (m_currentPassState.shadowType == ShadowType::Virtual)
+	{
+		passes.push_back(m_virtualShadowMapPass.createNonOwnerResource<CommandRecordBase>());
+	}
 	else
 	{
 		passes.push_back(m_rayTracedShadowsPass.createNonOwnerResource<CommandRecordBase>());
@@ -236,9 +328,81 @@ void SponzaScene::frame(WolfEngine* wolfInstance)
 	wolfInstance->frame(passes, m_taaComposePass->getSemaphore());
 }
 
-void SponzaScene::initializePipelineSets(const Wolf::WolfEngine* wolfInstance, const Wolf::ResourceNonOwner<ShadowMaskBasePass>& shadowMaskPass)
+void SponzaScene::appendShadowCasterStatistics(std::string& output) const
 {
-	m_sponzaPipelineSet.reset(new PipelineSet);
+	if (m_currentPassState.shadowType == ShadowType::RayTraced)
+	{
+		const uint32_t maskPixelCount = m_rayTracedShadowsPass->getMaskPixelCount();
+
+		char line[128];
+		snprintf(line, sizeof(line), "Shadow rays: %u per frame (%.0f%% of the mask pixels)<br>", m_rayTracedShadowsPass->getRayCount(),
+			100.0f * static_cast<float>(m_rayTracedShadowsPass->getRayCount()) / static_cast<float>(maskPixelCount));
+		output += line;
+		return;
+	}
+	if (m_currentPassState.shadowType == ShadowType::Virtual)
+	{
+		const VirtualShadowMapPageTable::Statistics& pageStatistics = m_virtualShadowMapPass->getPageStatistics();
+
+		char line[256];
+		snprintf(line, sizeof(line), "Virtual shadow map pages: %u requested, %u / %u resident, %u rendered, %u pending, %u evicted, %u overflow<br>", pageStatistics.requestedPageCount,
+			pageStatistics.residentPageCount, m_virtualShadowMapPass->getPhysicalPageCount(), pageStatistics.renderedPageCount, pageStatistics.pendingPageCount, pageStatistics.evictedPageCount,
+			pageStatistics.overflowPageCount);
+		output += line;
+
+		snprintf(line, sizeof(line), "Shadow maps VRAM: physical pages %llu MB<br>", m_virtualShadowMapPass->getPhysicalPoolBytes() >> 20);
+		output += line;
+		return;
+	}
+	if (m_currentPassState.shadowType != ShadowType::CSM)
+		return;
+
+	for (uint32_t cascadeIdx = 0; cascadeIdx < CascadedShadowMapping::CASCADE_COUNT; ++cascadeIdx)
+	{
+		const char* cascadeStatus = "reused";
+		if (m_cascadedShadowMappingPass->isStaticDepthUpdated(cascadeIdx))
+			cascadeStatus = "updated with static casters";
+		else if (m_cascadedShadowMappingPass->isCascadeUpdated(cascadeIdx))
+			cascadeStatus = "updated";
+
+		char line[128];
+		snprintf(line, sizeof(line), "Cascade %u shadow casting models: %u / %u (%s)<br>", cascadeIdx, m_cascadedShadowMappingPass->getVisibleShadowCasterCount(cascadeIdx),
+			m_cascadedShadowMappingPass->getShadowCasterCount(), cascadeStatus);
+		output += line;
+	}
+
+	CascadedShadowMapping::MemoryReport memoryReport;
+	m_cascadedShadowMappingPass->getMemoryReport(memoryReport);
+
+	char line[256];
+	snprintf(line, sizeof(line), "Shadow maps VRAM: %llu MB allocated (%llu MB if both modes were), cascades %llu MB, static cache %llu MB, atlas %llu MB, depth pyramids %llu KB<br>",
+		memoryReport.allocatedBytes >> 20, memoryReport.allModesBytes >> 20, memoryReport.cascadeBytes >> 20, memoryReport.staticCacheBytes >> 20, memoryReport.atlasBytes >> 20, memoryReport.depthPyramidBytes >> 10);
+	output += line;
+
+	const ShadowMaskComputePass::EarlyOutStatistics& earlyOutStatistics = m_shadowMaskComputePass->getEarlyOutStatistics();
+	const uint32_t lookupCount = earlyOutStatistics.litLookupCount + earlyOutStatistics.shadowedLookupCount + earlyOutStatistics.filteredLookupCount;
+	if (lookupCount > 0)
+	{
+		snprintf(line, sizeof(line), "Shadow mask early-outs: %.1f%% lit, %.1f%% shadowed, %.1f%% filtered<br>", 100.0f * static_cast<float>(earlyOutStatistics.litLookupCount) / static_cast<float>(lookupCount),
+			100.0f * static_cast<float>(earlyOutStatistics.shadowedLookupCount) / static_cast<float>(lookupCount), 100.0f * static_cast<float>(earlyOutStatistics.filteredLookupCount) / static_cast<float>(lookupCount));
+		output += line;
+	}
+
+	const std::array<uint32_t, ShadowMaskComputePass::TILE_LIST_COUNT>& tileCounts = m_shadowMaskComputePass->getTileCounts();
+	output += "Shadow mask tiles:";
+	for (uint32_t cascadeIdx = 0; cascadeIdx < CascadedShadowMapping::CASCADE_COUNT; ++cascadeIdx)
+	{
+		snprintf(line, sizeof(line), " cascade %u %u,", cascadeIdx, tileCounts[cascadeIdx]);
+		output += line;
+	}
+	snprintf(line, sizeof(line), " seams %u, skipped %u<br>", tileCounts[ShadowMaskComputePass::SEAM_TILE_LIST], tileCounts[ShadowMaskComputePass::SKIPPED_TILE_LIST]);
+	output += line;
+}
+
+void SponzaScene::initializePipelineSet(uint32_t pipelineSetIdx, bool isDynamic, const std::vector<std::string>& forwardConditionalBlocks)
+{
+	std::unique_ptr<PipelineSet>& pipelineSet = m_sponzaPipelineSets[pipelineSetIdx][isDynamic ? 1 : 0];
+	pipelineSet.reset(new PipelineSet);
 
 	PipelineSet::PipelineInfo pipelineInfo;
 
@@ -261,25 +425,58 @@ void SponzaScene::initializePipelineSets(const Wolf::WolfEngine* wolfInstance, c
 	// Color Blend
 	pipelineInfo.blendModes = { RenderingPipelineCreateInfo::BLEND_MODE::OPAQUE, RenderingPipelineCreateInfo::BLEND_MODE::OPAQUE };
 
-	m_sponzaPipelineSet->addPipeline(pipelineInfo, CommonPipelineIndices::PIPELINE_IDX_PRE_DEPTH);
+	pipelineSet->addPipeline(pipelineInfo, CommonPipelineIndices::PIPELINE_IDX_PRE_DEPTH);
 
 	/* Shadow maps */
-	pipelineInfo.depthBiasConstantFactor = 4.0f;
-	pipelineInfo.depthBiasSlopeFactor = 2.5f;
-	m_sponzaPipelineSet->addPipeline(pipelineInfo, CommonPipelineIndices::PIPELINE_IDX_SHADOW_MAP);
-	pipelineInfo.depthBiasConstantFactor = 0.0f;
-	pipelineInfo.depthBiasSlopeFactor = 0.0f;
+	// Each model is only drawn by the shadow map pass matching its static / dynamic flag
+	PipelineSet::PipelineInfo shadowMapPipelineInfo = pipelineInfo;
+	shadowMapPipelineInfo.depthBiasConstantFactor = 4.0f;
+	shadowMapPipelineInfo.depthBiasSlopeFactor = 2.5f;
+	if (isDynamic)
+		pipelineSet->addPipeline(shadowMapPipelineInfo, CommonPipelineIndices::PIPELINE_IDX_SHADOW_MAP);
+	else
+		pipelineSet->addEmptyPipeline(CommonPipelineIndices::PIPELINE_IDX_SHADOW_MAP);
 
 	/* Forward */
 	pipelineInfo.shaderInfos.resize(2);
 	pipelineInfo.shaderInfos[1].shaderFilename = "Shaders/shader.frag";
 	pipelineInfo.shaderInfos[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	shadowMaskPass->getConditionalBlocksToEnableWhenReadingMask(pipelineInfo.shaderInfos[1].conditionBlocksToInclude);
+	pipelineInfo.shaderInfos[1].conditionBlocksToInclude = forwardConditionalBlocks;
 
 	pipelineInfo.descriptorSetLayouts = { m_sponzaModel->getDescriptorSetLayout(), CommonDescriptorLayouts::g_commonForwardDescriptorSetLayout};
 
-	m_sponzaPipelineSet->addPipeline(pipelineInfo, CommonPipelineIndices::PIPELINE_IDX_FORWARD);
+	pipelineSet->addPipeline(pipelineInfo, CommonPipelineIndices::PIPELINE_IDX_FORWARD);
 
-	m_sponzaModel->setPipelineSet(m_sponzaPipelineSet.get());
-	m_cubeModel->setPipelineSet(m_sponzaPipelineSet.get());
+	/* Static shadow maps */
+	if (isDynamic)
+		pipelineSet->addEmptyPipeline(CommonPipelineIndices::PIPELINE_IDX_STATIC_SHADOW_MAP);
+	else
+		pipelineSet->addPipeline(shadowMapPipelineInfo, CommonPipelineIndices::PIPELINE_IDX_STATIC_SHADOW_MAP);
+
+	/* Single pass shadow maps */
+	shadowMapPipelineInfo.shaderInfos.resize(3);
+	shadowMapPipelineInfo.shaderInfos[0].shaderFilename = "Shaders/cascadedShadowMapping/singlePass.vert";
+	shadowMapPipelineInfo.shaderInfos[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shadowMapPipelineInfo.shaderInfos[1].shaderFilename = "Shaders/cascadedShadowMapping/singlePass.geom";
+	shadowMapPipelineInfo.shaderInfos[1].stage = VK_SHADER_STAGE_GEOMETRY_BIT;
+	shadowMapPipelineInfo.shaderInfos[1].conditionBlocksToInclude = { CascadeSettings::getCascadeCountShaderBlock() };
+	shadowMapPipelineInfo.shaderInfos[2].shaderFilename = "Shaders/cascadedShadowMapping/singlePass.frag";
+	shadowMapPipelineInfo.shaderInfos[2].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shadowMapPipelineInfo.descriptorSetLayouts = { m_sponzaModel->getDescriptorSetLayout(), CommonDescriptorLayouts::g_singlePassShadowMapDescriptorSetLayout };
+	shadowMapPipelineInfo.blendModes = {};
+	pipelineSet->addPipeline(shadowMapPipelineInfo, CommonPipelineIndices::PIPELINE_IDX_SINGLE_PASS_SHADOW_MAP);
+
+	/* Virtual shadow map pages */
+	shadowMapPipelineInfo.shaderInfos[1].shaderFilename = "Shaders/virtualShadowMap/renderPages.geom";
+	shadowMapPipelineInfo.shaderInfos[1].conditionBlocksToInclude = {};
+	shadowMapPipelineInfo.shaderInfos[2].shaderFilename = "Shaders/virtualShadowMap/renderPages.frag";
+	shadowMapPipelineInfo.descriptorSetLayouts = { m_sponzaModel->getDescriptorSetLayout(), CommonDescriptorLayouts::g_virtualShadowMapPagesDescriptorSetLayout };
+	pipelineSet->addPipeline(shadowMapPipelineInfo, CommonPipelineIndices::PIPELINE_IDX_VIRTUAL_SHADOW_MAP_PAGES);
+}
+
+void SponzaScene::usePipelineSet(ShadowType shadowType)
+{
+	const uint32_t pipelineSetIdx = m_pipelineSetIdxPerShadowType[static_cast<uint32_t>(shadowType)];
+	m_sponzaModel->setPipelineSet(m_sponzaPipelineSets[pipelineSetIdx][m_isSponzaDynamic ? 1 : 0].get());
+	m_cubeModel->setPipelineSet(m_sponzaPipelineSets[pipelineSetIdx][m_isCubeDynamic ? 1 : 0].get());
 }
@@ -7,44 +7,57 @@
 #include "PreDepthPass.h"
 #include "ForwardPass.h"
 #include "InputHandler.h"
+#include "LoadingProgress.h"
 #include "ModelBase.h"
 #include "RayTracedShadowsPass.h"
 #include "RTGIPass.h"
 #include "ShadowMaskComputePass.h"
 #include "TemporalAntiAliasingPass.h"
+#include "VirtualShadowMapPass.h"
 
 struct GameContext;
 
 class SponzaScene
 {
 public:
-	SponzaScene(Wolf::WolfEngine* wolfInstance, std::mutex* vulkanQueueLock);
+	SponzaScene(Wolf::WolfEngine* wolfInstance, std::mutex* vulkanQueueLock, LoadingProgress* loadingProgress = nullptr);
 
 	void update(Wolf::WolfEngine* wolfInstance, GameContext& gameContext);
 	void frame(Wolf::WolfEngine* wolfInstance);
 
 	enum class ShadowType
 	{
-		CSM, RayTraced
+		CSM, Virtual, RayTraced // ray tracing is last as it's not available on every device
 	};
 	void setShadowType(ShadowType shadowType) { m_nextPassState.shadowType = shadowType; }
 
 	void setDebugMode(ForwardPass::DebugMode debugMode) { m_nextPassState.debugMode = debugMode; }
 
+	void setRayTracedShadowsRayRate(RayTracedShadowsPass::RayRate rayRate) { m_nextPassState.rayTracedShadowsRayRate = rayRate; }
+
+	// Visible / total shadow casters of each cascade, page residency of the virtual shadow map or ray budget of ray traced shadows
+	void appendShadowCasterStatistics(std::string& output) const;
+
 private:
-	void initializePipelineSets(const Wolf::WolfEngine* wolfInstance, const Wolf::ResourceNonOwner<ShadowMaskBasePass>& shadowMaskPass);
+	void initializePipelineSet(uint32_t pipelineSetIdx, bool isDynamic, const std::vector<std::string>& forwardConditionalBlocks);
+	void usePipelineSet(ShadowType shadowType);
 
 	std::chrono::high_resolution_clock::time_point m_startTime = std::chrono::high_resolution_clock::now();
 	
 	std::unique_ptr<Wolf::ModelBase> m_sponzaModel;
 	std::unique_ptr<Wolf::ModelBase> m_cubeModel;
+
+	// Static models are rendered in the cached cascade depth, dynamic ones are rendered on top of it at each cascade update
+	bool m_isSponzaDynamic = false;
+	bool m_isCubeDynamic = true;
 	std::unique_ptr<Wolf::TopLevelAccelerationStructure> m_tlas;
 
 	std::unique_ptr<Wolf::FirstPersonCamera> m_camera;
 	bool m_isLocked = false;
 
-	// Pipeline sets
-	std::unique_ptr<Wolf::PipelineSet> m_sponzaPipelineSet;
+	// Pipeline sets, one per distinct forward shader needed by the shadow types and static / dynamic
+	std::vector<std::array<std::unique_ptr<Wolf::PipelineSet>, 2>> m_sponzaPipelineSets; // [pipeline set][is dynamic]
+	std::array<uint32_t, 3> m_pipelineSetIdxPerShadowType{};
 
 	// PreDepth
 	Wolf::ResourceUniqueOwner<PreDepthPass> m_preDepthPass;
@@ -52,6 +65,7 @@ private:
 	// Shadows
 	Wolf::ResourceUniqueOwner<CascadedShadowMapping> m_cascadedShadowMappingPass;
 	Wolf::ResourceUniqueOwner<ShadowMaskComputePass> m_shadowMaskComputePass;
+	Wolf::ResourceUniqueOwner<VirtualShadowMapPass> m_virtualShadowMapPass;
 	Wolf::ResourceUniqueOwner<RayTracedShadowsPass> m_rayTracedShadowsPass;
 
 	// Global Illumination
@@ -67,6 +81,7 @@ private:
 	{
 		ShadowType shadowType = ShadowType::CSM;
 		ForwardPass::DebugMode debugMode = ForwardPass::DebugMode::None;
+		RayTracedShadowsPass::RayRate rayTracedShadowsRayRate = RayTracedShadowsPass::RayRate::Full;
 	};
 
 	PassState m_currentPassState;
@@ -1,12 +1,23 @@
 #include "SystemManager.h"
 
+#include <cstdio>
 #include <iostream>
 
 using namespace Wolf;
 
-SystemManager::SystemManager()
+SystemManager::SystemManager(const Benchmark::CreateInfo* benchmarkCreateInfo)
 {
-	createWolfInstance();
+	createWolfInstance(benchmarkCreateInfo && benchmarkCreateInfo->offscreen);
+
+	if (benchmarkCreateInfo)
+		m_benchmark.reset(new Benchmark(*benchmarkCreateInfo, g_configuration->getMaxCachedFrames()));
+
+	m_gpuProfiler.reset(new GPUProfiler(benchmarkCreateInfo && benchmarkCreateInfo->collectPipelineStatistics, g_configuration->getMaxCachedFrames()));
+	g_gpuProfiler = m_gpuProfiler.get();
+
+	// Before any pass is initialized, their pipelines are created on worker threads during the loading
+	m_pipelineCache.reset(new PipelineCache("pipelines.cache"));
+	g_pipelineCache = m_pipelineCache.get();
 
 	m_loadingScreenUniquePass.reset(new LoadingScreenUniquePass());
 	m_wolfInstance->initializePass(m_loadingScreenUniquePass.createNonOwnerResource<CommandRecordBase>());
@@ -18,24 +29,37 @@ void SystemManager::run()
 {
 	while (!m_wolfInstance->windowShouldClose() /* check if the window should close (for example if the user pressed alt+f4)*/)
 	{
+		if (m_benchmark && m_benchmark->isFinished())
+			break;
+
 		if (m_needJoinLoadingThread)
 		{
 			m_sceneLoadingThread.join();
 			m_needJoinLoadingThread = false;
 		}
 
-		if (m_gameState == GAME_STATE::LOADING)
+		if (m_gameState == GAME_STATE::LOADING && m_benchmark && m_benchmark->isOffscreen())
 		{
-			m_mutex.lock();
-			std::vector<ResourceNonOwner<CommandRecordBase>> passes;
-			passes.reserve(1);
-			passes.push_back(m_loadingScreenUniquePass.createNonOwnerResource<CommandRecordBase>());
+			// Nobody looks at the loading screen, the swapchain is neither acquired nor presented until the scene is ready
+			m_loadingProgress.waitForUpdate(m_lastLoadingProgressVersion, std::chrono::milliseconds(100));
+		}
+		else if (m_gameState == GAME_STATE::LOADING)
+		{
+			m_loadingScreenUniquePass->setProgress(m_loadingProgress.getProgress());
 
-			m_wolfInstance->updateBeforeFrame();
-			m_wolfInstance->frame(passes, m_loadingScreenUniquePass->getSemaphore());
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				std::vector<ResourceNonOwner<CommandRecordBase>> passes;
+				passes.reserve(1);
+				passes.push_back(m_loadingScreenUniquePass.createNonOwnerResource<CommandRecordBase>());
 
-			m_mutex.unlock();
-			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+				m_wolfInstance->updateBeforeFrame();
+				m_wolfInstance->frame(passes, m_loadingScreenUniquePass->getSemaphore());
+			}
+
+			// Sleep until the loading thread reports progress, the timeout only keeps the loading icon spinning
+			constexpr std::chrono::milliseconds LOADING_ICON_REFRESH_PERIOD(33);
+			m_loadingProgress.waitForUpdate(m_lastLoadingProgressVersion, LOADING_ICON_REFRESH_PERIOD);
 		}
 		else if (m_gameState == GAME_STATE::RUNNING)
 		{
@@ -46,28 +70,62 @@ void SystemManager::run()
 			gameContext.sunTheta = static_cast<float>(m_sunTheta);
 			gameContext.sunAreaAngle = static_cast<float>(m_sunAreaAngle);
 			gameContext.enableTAA = m_TAAEnabled;
+			gameContext.singlePassCascades = m_singlePassCascadesEnabled;
+			gameContext.cascadeResolutionDivisor = m_cascadeResolutionDivisor;
+			gameContext.temporalShadowMask = m_temporalShadowMaskEnabled;
+			gameContext.shadowMaskResolutionDivisor = m_shadowMaskResolutionDivisor;
+
+			if (m_benchmark)
+			{
+				m_benchmark->beginFrame();
+				m_benchmark->updateGameContext(gameContext);
+			}
 
 			m_sponzaScene->update(m_wolfInstance.get(), gameContext);
+			if (m_benchmark)
+				m_benchmark->endUpdate();
+
 			m_sponzaScene->frame(m_wolfInstance.get());
+			m_gpuProfiler->collectResults();
+			if (m_benchmark)
+				m_benchmark->endFrame(m_gpuProfiler.get());
 		}
 
 		const auto currentTime = std::chrono::steady_clock::now();
-		m_currentFramesAccumulated++;
-		const long long durationInMs = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - m_startTimeFPSCounter).count();
-		if (durationInMs > 1000)
-		{
-			m_stableFPS = static_cast<uint32_t>(std::round((1000.0f * static_cast<float>(m_currentFramesAccumulated)) / static_cast<float>(durationInMs)));
-
-			m_currentFramesAccumulated = 0;
-			m_startTimeFPSCounter = currentTime;
-		}
+		if (m_gameState == GAME_STATE::RUNNING) // loading screen frames are throttled and would pollute the statistics
+			m_frameTimeTracker.addFrame(std::chrono::duration<float, std::milli>(currentTime - m_previousFrameTime).count());
+		m_previousFrameTime = currentTime;
 	}
 
 	m_wolfInstance->waitIdle();
+
+	m_pipelineCache->save();
+	m_frameTimeTracker.dumpToFile("frameTimes.csv");
+
+	if (m_benchmark)
+		m_benchmark->writeResults();
+
+	g_gpuProfiler = nullptr;
+	g_pipelineCache = nullptr;
 }
 
-void SystemManager::createWolfInstance()
+bool SystemManager::isOffscreenSupported()
 {
+#ifdef GLFW_PLATFORM_NULL
+	return glfwPlatformSupported(GLFW_PLATFORM_NULL) == GLFW_TRUE;
+#else
+	return false; // before GLFW 3.4
+#endif
+}
+
+void SystemManager::createWolfInstance(bool offscreen)
+{
+	// Without a window, GLFW's null platform gives the engine a VK_EXT_headless_surface: the swapchain images are never shown and no display server is needed (lavapipe supports it)
+#ifdef GLFW_PLATFORM_NULL
+	if (offscreen)
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+
 	WolfInstanceCreateInfo wolfInstanceCreateInfo;
 	wolfInstanceCreateInfo.configFilename = "config/config.ini";
 	wolfInstanceCreateInfo.debugCallback = debugCallback;
@@ -78,6 +136,7 @@ void SystemManager::createWolfInstance()
 	m_wolfInstance.reset(new WolfEngine(wolfInstanceCreateInfo));
 	bindUltralightCallbacks();
 
+	// Contexts are indexed by frame % maxCachedFrames, pointers given to the engine must stay valid
 	m_gameContexts.reserve(g_configuration->getMaxCachedFrames());
 	std::vector<void*> contextPtrs(g_configuration->getMaxCachedFrames());
 	for (uint32_t i = 0; i < g_configuration->getMaxCachedFrames(); ++i)
@@ -100,10 +159,11 @@ void SystemManager::loadSponzaScene()
 	SetThreadDescription(GetCurrentThread(), L"Loading");
 #endif
 
-	m_sponzaScene.reset(new SponzaScene(m_wolfInstance.get(), &m_mutex));
+	m_sponzaScene.reset(new SponzaScene(m_wolfInstance.get(), &m_mutex, &m_loadingProgress));
 
-	m_gameState = GAME_STATE::RUNNING;
 	m_needJoinLoadingThread = true;
+	m_gameState = GAME_STATE::RUNNING;
+	m_loadingProgress.setFinished(); // wake up the main loop
 }
 
 void SystemManager::debugCallback(Debug::Severity severity, Debug::Type type, const std::string& message)
@@ -131,18 +191,49 @@ void SystemManager::bindUltralightCallbacks()
 	ultralight::JSObject jsObject;
 	m_wolfInstance->getUserInterfaceJSObject(jsObject);
 	jsObject["getFrameRate"] = static_cast<ultralight::JSCallbackWithRetval>(std::bind(&SystemManager::getFrameRate, this, std::placeholders::_1, std::placeholders::_2));
+	jsObject["getPassTimings"] = static_cast<ultralight::JSCallbackWithRetval>(std::bind(&SystemManager::getPassTimings, this, std::placeholders::_1, std::placeholders::_2));
 	jsObject["setSunTheta"] = std::bind(&SystemManager::setSunTheta, this, std::placeholders::_1, std::placeholders::_2);
 	jsObject["setSunPhi"] = std::bind(&SystemManager::setSunPhi, this, std::placeholders::_1, std::placeholders::_2);
 	jsObject["setShadows"] = std::bind(&SystemManager::setShadows, this, std::placeholders::_1, std::placeholders::_2);
 	jsObject["setSunAreaAngle"] = std::bind(&SystemManager::setSunAreaAngle, this, std::placeholders::_1, std::placeholders::_2);
 	jsObject["setDebugMode"] = std::bind(&SystemManager::setDebugMode, this, std::placeholders::_1, std::placeholders::_2);
 	jsObject["setEnableTAA"] = std::bind(&SystemManager::setEnableTAA, this, std::placeholders::_1, std::placeholders::_2);
+	jsObject["setSinglePassCascades"] = std::bind(&SystemManager::setSinglePassCascades, this, std::placeholders::_1, std::placeholders::_2);
+	jsObject["setCascadeResolution"] = std::bind(&SystemManager::setCascadeResolution, this, std::placeholders::_1, std::placeholders::_2);
+	jsObject["setTemporalShadowMask"] = std::bind(&SystemManager::setTemporalShadowMask, this, std::placeholders::_1, std::placeholders::_2);
+	jsObject["setShadowMaskResolution"] = std::bind(&SystemManager::setShadowMaskResolution, this, std::placeholders::_1, std::placeholders::_2);
+	jsObject["setRayTracedShadowsRayRate"] = std::bind(&SystemManager::setRayTracedShadowsRayRate, this, std::placeholders::_1, std::placeholders::_2);
 }
 
 ultralight::JSValue SystemManager::getFrameRate(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args)
 {
-	const std::string fpsStr = "FPS: " + std::to_string(m_stableFPS);
-	return {fpsStr.c_str()};
+	FrameTimeTracker::Statistics statistics;
+	m_frameTimeTracker.computeStatistics(statistics);
+
+	char fpsStr[256];
+	snprintf(fpsStr, sizeof(fpsStr), "FPS: %.0f | p50 %.1f ms | p95 %.1f ms | p99 %.1f ms | max %.1f ms | jitter %.2f ms | hitches %u", statistics.averageFPS, statistics.p50InMs, statistics.p95InMs,
+		statistics.p99InMs, statistics.maxInMs, statistics.jitterInMs, statistics.hitchCount);
+	return { fpsStr };
+}
+
+ultralight::JSValue SystemManager::getPassTimings(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args)
+{
+	if (!m_gpuProfiler)
+		return { "" };
+
+	std::vector<GPUProfiler::RegionResult> results;
+	m_gpuProfiler->getResults(results);
+
+	std::string timingsStr;
+	for (const GPUProfiler::RegionResult& result : results)
+	{
+		char line[128];
+		snprintf(line, sizeof(line), "%s: %.2f ms (max %.2f ms)<br>", result.name.c_str(), result.averageTimeInMs, result.maxTimeInMs);
+		timingsStr += line;
+	}
+	if (m_gameState == GAME_STATE::RUNNING)
+		m_sponzaScene->appendShadowCasterStatistics(timingsStr);
+	return { timingsStr.c_str() };
 }
 
 void SystemManager::setSunTheta(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args)
@@ -160,6 +251,8 @@ void SystemManager::setShadows(const ultralight::JSObject& thisObject, const ult
 	const std::string shadowType(static_cast<ultralight::String>(args[0].ToString()).utf8().data());
 	if(shadowType == "Shadow Mapping")
 		m_sponzaScene->setShadowType(SponzaScene::ShadowType::CSM);
+	else if(shadowType == "Virtual Shadow Mapping")
+		m_sponzaScene->setShadowType(SponzaScene::ShadowType::Virtual);
 	else if(shadowType == "Ray Tracing")
 		m_sponzaScene->setShadowType(SponzaScene::ShadowType::RayTraced);
 	else
@@ -200,3 +293,74 @@ void SystemManager::setEnableTAA(const ultralight::JSObject& thisObject, const u
 		Debug::sendError("Wrong input for set enable TAA");
 
 }
+
+void SystemManager::setSinglePassCascades(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args)
+{
+	const std::string enable(static_cast<ultralight::String>(args[0].ToString()).utf8().data());
+
+	if (enable == "true")
+		m_singlePassCascadesEnabled = true;
+	else if (enable == "false")
+		m_singlePassCascadesEnabled = false;
+	else
+		Debug::sendError("Wrong input for set single pass cascades");
+}
+
+void SystemManager::setCascadeResolution(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args)
+{
+	const std::string strResolution(static_cast<ultralight::String>(args[0].ToString()).utf8().data());
+
+	if (strResolution == "full")
+		m_cascadeResolutionDivisor = 1;
+	else if (strResolution == "half")
+		m_cascadeResolutionDivisor = 2;
+	else if (strResolution == "quarter")
+		m_cascadeResolutionDivisor = 4;
+	else
+		Debug::sendError("Unsupported cascade resolution");
+}
+
+void SystemManager::setTemporalShadowMask(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args)
+{
+	const std::string enable(static_cast<ultralight::String>(args[0].ToString()).utf8().data());
+
+	if (enable == "true")
+		m_temporalShadowMaskEnabled = true;
+	else if (enable == "false")
+		m_temporalShadowMaskEnabled = false;
+	else
+		Debug::sendError("Wrong input for set temporal shadow mask");
+}
+
+void SystemManager::setShadowMaskResolution(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args)
+{
+	const std::string strResolution(static_cast<ultralight::String>(args[0].ToString()).utf8().data());
+
+	if (strResolution == "full")
+		m_shadowMaskResolutionDivisor = 1;
+	else if (strResolution == "half")
+		m_shadowMaskResolutionDivisor = 2;
+	else if (strResolution == "quarter")
+		m_shadowMaskResolutionDivisor = 4;
+	else
+		Debug::sendError("Unsupported shadow mask resolution");
+}
+
+void SystemManager::setRayTracedShadowsRayRate(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args)
+{
+	const std::string strRayRate(static_cast<ultralight::String>(args[0].ToString()).utf8().data());
+
+	RayTracedShadowsPass::RayRate rayRate = RayTracedShadowsPass::RayRate::Full;
+	if (strRayRate == "full")
+		rayRate = RayTracedShadowsPass::RayRate::Full;
+	else if (strRayRate == "checkerboard")
+		rayRate = RayTracedShadowsPass::RayRate::Checkerboard;
+	else if (strRayRate == "half")
+		rayRate = RayTracedShadowsPass::RayRate::Half;
+	else if (strRayRate == "quarter")
+		rayRate = RayTracedShadowsPass::RayRate::Quarter;
+	else
+		Debug::sendError("Unsupported ray traced shadows ray rate");
+
+	m_sponzaScene->setRayTracedShadowsRayRate(rayRate);
+}
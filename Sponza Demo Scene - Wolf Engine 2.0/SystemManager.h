@@ -4,8 +4,13 @@
 #include <math.h>
 #include <WolfEngine.h>
 
+#include "Benchmark.h"
+#include "FrameTimeTracker.h"
 #include "GameContext.h"
+#include "GPUProfiler.h"
+#include "LoadingProgress.h"
 #include "LoadingScreenUniquePass.h"
+#include "PipelineCache.h"
 #include "SponzaScene.h"
 
 enum class GAME_STATE
@@ -17,42 +22,60 @@ enum class GAME_STATE
 class SystemManager
 {
 public:
-	SystemManager();
+	SystemManager(const Benchmark::CreateInfo* benchmarkCreateInfo = nullptr);
 	void run();
 
+	// Offscreen benchmarks need GLFW's null platform, there's no fallback to a window
+	static bool isOffscreenSupported();
+
 private:
-	void createWolfInstance();
+	void createWolfInstance(bool offscreen);
 	void loadSponzaScene();
 
 	static void debugCallback(Wolf::Debug::Severity severity, Wolf::Debug::Type type, const std::string& message);
 	void bindUltralightCallbacks();
 	ultralight::JSValue getFrameRate(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args);
+	ultralight::JSValue getPassTimings(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args);
 	void setSunTheta(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args);
 	void setSunPhi(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args);
 	void setShadows(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args);
 	void setSunAreaAngle(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args);
 	void setDebugMode(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args);
 	void setEnableTAA(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args);
+	void setSinglePassCascades(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args);
+	void setCascadeResolution(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args);
+	void setTemporalShadowMask(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args);
+	void setShadowMaskResolution(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args);
+	void setRayTracedShadowsRayRate(const ultralight::JSObject& thisObject, const ultralight::JSArgs& args);
 
 private:
 	std::unique_ptr<Wolf::WolfEngine> m_wolfInstance;
+	std::unique_ptr<GPUProfiler> m_gpuProfiler;
+	std::unique_ptr<PipelineCache> m_pipelineCache;
 
 	Wolf::ResourceUniqueOwner<LoadingScreenUniquePass> m_loadingScreenUniquePass;
 	std::unique_ptr<SponzaScene> m_sponzaScene;
 
-	GAME_STATE m_gameState = GAME_STATE::LOADING;
+	std::atomic<GAME_STATE> m_gameState = GAME_STATE::LOADING;
 	std::thread m_sceneLoadingThread;
 	std::mutex m_mutex;
-	bool m_needJoinLoadingThread = false;
+	std::atomic<bool> m_needJoinLoadingThread = false;
+	LoadingProgress m_loadingProgress;
+	uint32_t m_lastLoadingProgressVersion = 0;
 
-	uint32_t m_currentFramesAccumulated = 0;
-	uint32_t m_stableFPS = 0;
-	std::chrono::steady_clock::time_point m_startTimeFPSCounter = std::chrono::steady_clock::now();
+	FrameTimeTracker m_frameTimeTracker;
+	std::chrono::steady_clock::time_point m_previousFrameTime = std::chrono::steady_clock::now();
 
 	std::vector<GameContext> m_gameContexts;
 
+	std::unique_ptr<Benchmark> m_benchmark;
+
 	double m_sunTheta = 0.0, m_sunPhi = 0.0;
 	double m_sunAreaAngle = 0.01;
 	bool m_TAAEnabled = true;
+	bool m_singlePassCascadesEnabled = false;
+	uint32_t m_cascadeResolutionDivisor = 1;
+	bool m_temporalShadowMaskEnabled = true;
+	uint32_t m_shadowMaskResolutionDivisor = 1;
 };
 
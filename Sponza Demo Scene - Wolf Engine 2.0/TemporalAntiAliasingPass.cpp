@@ -2,6 +2,7 @@
 
 #include <DescriptorSetGenerator.h>
 #include <Image.h>
+#include <Timer.h>
 
 #include "CameraInterface.h"
 #include "CameraList.h"
@@ -10,6 +11,7 @@
 #include "PreDepthPass.h"
 #include "ForwardPass.h"
 #include "GameContext.h"
+#include "GPUProfiler.h"
 
 using namespace Wolf;
 
@@ -18,8 +20,6 @@ void TemporalAntiAliasingPass::initializeResources(const InitializationContext&
 	m_commandBuffer.reset(new CommandBuffer(QueueType::COMPUTE, false /* isTransient */));
 	m_semaphore.reset(new Semaphore(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT));
 
-	m_computeShaderParser.reset(new ShaderParser("Shaders/TAA/shader.comp"));
-
 	m_descriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT,                             0); // previous image
 	m_descriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT,                             1); // result image
 	m_descriptorSetLayoutGenerator.addUniformBuffer(VK_SHADER_STAGE_COMPUTE_BIT,                            2); // uniform buffer
@@ -27,13 +27,17 @@ void TemporalAntiAliasingPass::initializeResources(const InitializationContext&
 	m_descriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT,                             4); // velocity
 	m_descriptorSetLayout.reset(new DescriptorSetLayout(m_descriptorSetLayoutGenerator.getDescriptorLayouts()));
 
-	if (m_forwardPass->getOutputImageCount() != 2)
-		Debug::sendError("TAA assumes forward pass uses 2 output images (current and previous)");
-
 	m_uniformBuffer.reset(new Buffer(sizeof(ReprojectionUBData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::EACH_FRAME));
 
-	createPipeline();
+	// Shader compilation and pipeline creation don't use the queue, they run on a worker thread while the next passes are initialized
+	m_pipelineCreation = std::async(std::launch::async, [this]
+	{
+		Timer timer("TAA pipeline creation");
+		m_computeShaderParser.reset(new ShaderParser("Shaders/TAA/shader.comp"));
+		createPipeline();
+	});
 
+	m_descriptorSets.resize(m_forwardPass->getOutputImageCount());
 	for (uint32_t i = 0; i < m_forwardPass->getOutputImageCount(); ++i)
 		m_descriptorSets[i].reset(new DescriptorSet(m_descriptorSetLayout->getDescriptorSetLayout(), UpdateRate::EACH_FRAME));
 	updateDescriptorSets();
@@ -46,6 +50,8 @@ void TemporalAntiAliasingPass::resize(const InitializationContext& context)
 
 void TemporalAntiAliasingPass::record(const RecordContext& context)
 {
+	waitForPipelineCreation();
+
 	const GameContext* gameContext = static_cast<const GameContext*>(context.gameContext);
 	const uint32_t currentImageIdx = context.currentFrameIdx % m_forwardPass->getOutputImageCount();
 	ResourceNonOwner<Image> currentOutputImage = m_forwardPass->getOutputImage(currentImageIdx);
@@ -69,7 +75,7 @@ void TemporalAntiAliasingPass::record(const RecordContext& context)
 	/* Command buffer record */
 	m_commandBuffer->beginCommandBuffer(context.commandBufferIdx);
 
-	DebugMarker::beginRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), DebugMarker::computePassDebugColor, "TAA Compose Compute Pass");
+	GPUProfiler::beginPassRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), DebugMarker::computePassDebugColor, "TAA Compose Compute Pass", false);
 
 	vkCmdBindDescriptorSets(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->getPipelineLayout(), 0, 1,
 		m_descriptorSets[currentImageIdx]->getDescriptorSet(context.commandBufferIdx), 0, nullptr);
@@ -81,7 +87,15 @@ void TemporalAntiAliasingPass::record(const RecordContext& context)
 	const uint32_t groupSizeY = currentOutputImage->getExtent().height % dispatchGroups.height != 0 ? currentOutputImage->getExtent().height / dispatchGroups.height + 1 : currentOutputImage->getExtent().height / dispatchGroups.height;
 	vkCmdDispatch(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), groupSizeX, groupSizeY, dispatchGroups.depth);
 
-	DebugMarker::endRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
+	GPUProfiler::endPassRegion(m_commandBuffer->getCommandBuffer(context.commandBufferIdx));
+
+	if (gameContext->offscreen)
+	{
+		// The TAA output is the final image, the swapchain image of the headless surface is only made presentable
+		recordSwapChainImageTransitionToPresent(context);
+		m_commandBuffer->endCommandBuffer(context.commandBufferIdx);
+		return;
+	}
 
 	VkImageCopy copyRegion{};
 
@@ -126,13 +140,7 @@ void TemporalAntiAliasingPass::record(const RecordContext& context)
 	transitionLayoutInfoToGeneral.levelCount = 1;
 	currentOutputImage->transitionImageLayout(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), transitionLayoutInfoToGeneral);
 
-	Image::TransitionLayoutInfo transitionLayoutInfoToPresent{};
-	transitionLayoutInfoToPresent.baseMipLevel = 0;
-	transitionLayoutInfoToPresent.dstAccessMask = 0;
-	transitionLayoutInfoToPresent.dstLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-	transitionLayoutInfoToPresent.dstPipelineStageFlags = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	transitionLayoutInfoToPresent.levelCount = 1;
-	context.swapchainImage->transitionImageLayout(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), transitionLayoutInfoToPresent);
+	recordSwapChainImageTransitionToPresent(context);
 
 	m_commandBuffer->endCommandBuffer(context.commandBufferIdx);
 }
@@ -150,6 +158,17 @@ void TemporalAntiAliasingPass::submit(const SubmitContext& context)
 	}
 }
 
+void TemporalAntiAliasingPass::recordSwapChainImageTransitionToPresent(const RecordContext& context) const
+{
+	Image::TransitionLayoutInfo transitionLayoutInfoToPresent{};
+	transitionLayoutInfoToPresent.baseMipLevel = 0;
+	transitionLayoutInfoToPresent.dstAccessMask = 0;
+	transitionLayoutInfoToPresent.dstLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	transitionLayoutInfoToPresent.dstPipelineStageFlags = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	transitionLayoutInfoToPresent.levelCount = 1;
+	context.swapchainImage->transitionImageLayout(m_commandBuffer->getCommandBuffer(context.commandBufferIdx), transitionLayoutInfoToPresent);
+}
+
 void TemporalAntiAliasingPass::createPipeline()
 {
 	// Compute shader parser
@@ -162,7 +181,13 @@ void TemporalAntiAliasingPass::createPipeline()
 
 	std::vector<VkDescriptorSetLayout> descriptorSetLayouts(1);
 	descriptorSetLayouts[0] = m_descriptorSetLayout->getDescriptorSetLayout();
-	m_pipeline.reset(new Pipeline(computeShaderCreateInfo, descriptorSetLayouts));
+	m_pipeline.reset(new ComputePipeline(computeShaderCreateInfo, descriptorSetLayouts));
+}
+
+void TemporalAntiAliasingPass::waitForPipelineCreation()
+{
+	if (m_pipelineCreation.valid())
+		m_pipelineCreation.get();
 }
 
 void TemporalAntiAliasingPass::updateDescriptorSets() const
@@ -185,7 +210,7 @@ void TemporalAntiAliasingPass::updateDescriptorSets() const
 	{
 		DescriptorSetGenerator::ImageDescription previousOutputImageDesc;
 		previousOutputImageDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-		previousOutputImageDesc.imageView = m_forwardPass->getOutputImage((i + 1) % m_forwardPass->getOutputImageCount())->getDefaultImageView();
+		previousOutputImageDesc.imageView = m_forwardPass->getOutputImage((i + m_forwardPass->getOutputImageCount() - 1) % m_forwardPass->getOutputImageCount())->getDefaultImageView();
 		descriptorSetGenerator.setImage(0, previousOutputImageDesc);
 
 		DescriptorSetGenerator::ImageDescription outputImageDesc;
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <future>
 #include <glm/glm.hpp>
+#include <vector>
 
 #include <CommandRecordBase.h>
 #include <DescriptorSet.h>
@@ -10,6 +12,8 @@
 #include <ResourceUniqueOwner.h>
 #include <ShaderParser.h>
 
+#include "PipelineCache.h"
+
 class PreDepthPass;
 class ForwardPass;
 class ShadowMaskBasePass;
@@ -25,18 +29,21 @@ public:
 	void submit(const Wolf::SubmitContext& context) override;
 
 private:
+	void recordSwapChainImageTransitionToPresent(const Wolf::RecordContext& context) const;
 	void createPipeline();
+	void waitForPipelineCreation();
 	void updateDescriptorSets() const;
 
 	Wolf::ResourceNonOwner<PreDepthPass> m_preDepthPass;
 	Wolf::ResourceNonOwner<ForwardPass> m_forwardPass;
 
 	std::unique_ptr<Wolf::ShaderParser> m_computeShaderParser;
-	std::unique_ptr<Wolf::Pipeline> m_pipeline;
+	std::unique_ptr<ComputePipeline> m_pipeline;
+	std::future<void> m_pipelineCreation;
 
 	Wolf::DescriptorSetLayoutGenerator m_descriptorSetLayoutGenerator;
 	std::unique_ptr<Wolf::DescriptorSetLayout> m_descriptorSetLayout;
-	std::array<std::unique_ptr<Wolf::DescriptorSet>, 2> m_descriptorSets;
+	std::vector<std::unique_ptr<Wolf::DescriptorSet>> m_descriptorSets; // one per forward output image
 
 	struct ReprojectionUBData
 	{
@@ -3,7 +3,7 @@ class WolfCheckbox extends HTMLElement {
         super();
         var el = document.createElement("input");
         el.setAttribute("type", "checkbox");
-        el.setAttribute("checked", this.getAttribute('checked')? this.getAttribute('checked'):"false");
+        el.checked = this.getAttribute('checked') === "true"; // the attribute alone would check the box, even with "false"
         el.addEventListener('change', () => {
             window[this.getAttribute('onchange')](el.checked);
         })
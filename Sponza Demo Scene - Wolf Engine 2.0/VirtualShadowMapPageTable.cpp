@@ -0,0 +1,159 @@
+#include "VirtualShadowMapPageTable.h"
+
+#include <algorithm>
+
+VirtualShadowMapPageTable::VirtualShadowMapPageTable(uint32_t levelCount, uint32_t level0PageCountPerSide, uint32_t physicalPageCount) : m_levelCount(levelCount), m_level0PageCountPerSide(level0PageCountPerSide)
+{
+	uint32_t virtualPageCount = 0;
+	m_levelOffsets.resize(levelCount);
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		m_levelOffsets[level] = virtualPageCount;
+		virtualPageCount += getPageCountPerSide(level) * getPageCountPerSide(level);
+	}
+
+	m_virtualPages.resize(virtualPageCount);
+	m_isRequested.resize(virtualPageCount);
+	m_gpuPageTable.resize(virtualPageCount, INVALID_PAGE);
+	m_physicalPages.resize(physicalPageCount);
+
+	invalidateAll();
+}
+
+void VirtualShadowMapPageTable::getVirtualPageCoords(uint32_t virtualPageIdx, uint32_t& outLevel, uint32_t& outX, uint32_t& outY) const
+{
+	outLevel = m_levelCount - 1;
+	while (m_levelOffsets[outLevel] > virtualPageIdx)
+		outLevel--;
+
+	const uint32_t pageIdxInLevel = virtualPageIdx - m_levelOffsets[outLevel];
+	outX = pageIdxInLevel % getPageCountPerSide(outLevel);
+	outY = pageIdxInLevel / getPageCountPerSide(outLevel);
+}
+
+void VirtualShadowMapPageTable::invalidateAll()
+{
+	std::fill(m_virtualPages.begin(), m_virtualPages.end(), VirtualPage());
+	std::fill(m_physicalPages.begin(), m_physicalPages.end(), PhysicalPage());
+
+	// Reversed so that pages are allocated from the first one
+	m_freePhysicalPages.resize(m_physicalPages.size());
+	for (uint32_t i = 0; i < m_freePhysicalPages.size(); ++i)
+		m_freePhysicalPages[i] = static_cast<uint32_t>(m_physicalPages.size()) - 1 - i;
+}
+
+void VirtualShadowMapPageTable::invalidateRect(const glm::vec2& min, const glm::vec2& max)
+{
+	if (max.x < 0.0f || max.y < 0.0f || min.x > 1.0f || min.y > 1.0f)
+		return;
+
+	for (uint32_t level = 0; level < m_levelCount; ++level)
+	{
+		const uint32_t pageCountPerSide = getPageCountPerSide(level);
+		const glm::uvec2 minPage(glm::clamp(glm::ivec2(glm::floor(min * static_cast<float>(pageCountPerSide))), glm::ivec2(0), glm::ivec2(pageCountPerSide - 1)));
+		const glm::uvec2 maxPage(glm::clamp(glm::ivec2(glm::floor(max * static_cast<float>(pageCountPerSide))), glm::ivec2(0), glm::ivec2(pageCountPerSide - 1)));
+
+		for (uint32_t y = minPage.y; y <= maxPage.y; ++y)
+		{
+			for (uint32_t x = minPage.x; x <= maxPage.x; ++x)
+			{
+				VirtualPage& virtualPage = m_virtualPages[getVirtualPageIdx(level, x, y)];
+				if (virtualPage.contentState == ContentState::VALID)
+					virtualPage.contentState = ContentState::STALE;
+			}
+		}
+	}
+}
+
+void VirtualShadowMapPageTable::update(std::span<const uint32_t> requests, uint32_t frameIdx, uint32_t maxRenderedPageCount, std::vector<uint32_t>& outPagesToRender)
+{
+	m_statistics = Statistics();
+	outPagesToRender.clear();
+
+	const uint32_t coarsestLevelOffset = m_levelOffsets[m_levelCount - 1];
+	for (uint32_t virtualPageIdx = 0; virtualPageIdx < m_virtualPages.size(); ++virtualPageIdx)
+	{
+		const bool isRequested = (virtualPageIdx < requests.size() && requests[virtualPageIdx] != 0) || virtualPageIdx >= coarsestLevelOffset;
+		m_isRequested[virtualPageIdx] = isRequested ? 1 : 0;
+		if (!isRequested)
+			continue;
+
+		m_statistics.requestedPageCount++;
+		if (m_virtualPages[virtualPageIdx].physicalPage != INVALID_PAGE)
+			m_physicalPages[m_virtualPages[virtualPageIdx].physicalPage].lastRequestedFrame = frameIdx;
+	}
+
+	m_evictionCandidates.clear();
+	for (uint32_t physicalPageIdx = 0; physicalPageIdx < m_physicalPages.size(); ++physicalPageIdx)
+	{
+		const PhysicalPage& physicalPage = m_physicalPages[physicalPageIdx];
+		if (physicalPage.virtualPage != INVALID_PAGE && physicalPage.lastRequestedFrame != frameIdx)
+			m_evictionCandidates.push_back(physicalPageIdx);
+	}
+	std::sort(m_evictionCandidates.begin(), m_evictionCandidates.end(), [this](uint32_t a, uint32_t b) { return m_physicalPages[a].lastRequestedFrame > m_physicalPages[b].lastRequestedFrame; });
+
+	// Coarse pages are the fallback of the finer ones, they are rendered first
+	for (uint32_t level = m_levelCount; level-- > 0;)
+	{
+		const uint32_t levelPageCount = getPageCountPerSide(level) * getPageCountPerSide(level);
+		for (uint32_t virtualPageIdx = m_levelOffsets[level]; virtualPageIdx < m_levelOffsets[level] + levelPageCount; ++virtualPageIdx)
+		{
+			VirtualPage& virtualPage = m_virtualPages[virtualPageIdx];
+			if (!m_isRequested[virtualPageIdx] || virtualPage.contentState == ContentState::VALID)
+				continue;
+
+			if (outPagesToRender.size() >= maxRenderedPageCount)
+			{
+				m_statistics.pendingPageCount++;
+				continue;
+			}
+
+			if (virtualPage.physicalPage == INVALID_PAGE)
+			{
+				const uint32_t physicalPageIdx = allocatePhysicalPage(frameIdx);
+				if (physicalPageIdx == INVALID_PAGE)
+				{
+					m_statistics.overflowPageCount++;
+					continue;
+				}
+				virtualPage.physicalPage = physicalPageIdx;
+				m_physicalPages[physicalPageIdx].virtualPage = virtualPageIdx;
+			}
+
+			virtualPage.contentState = ContentState::VALID; // rendered before the page table is read this frame
+			outPagesToRender.push_back(virtualPageIdx);
+		}
+	}
+
+	for (uint32_t virtualPageIdx = 0; virtualPageIdx < m_virtualPages.size(); ++virtualPageIdx)
+	{
+		const VirtualPage& virtualPage = m_virtualPages[virtualPageIdx];
+		m_gpuPageTable[virtualPageIdx] = virtualPage.contentState != ContentState::NONE ? virtualPage.physicalPage : INVALID_PAGE;
+	}
+
+	m_statistics.renderedPageCount = static_cast<uint32_t>(outPagesToRender.size());
+	m_statistics.residentPageCount = static_cast<uint32_t>(m_physicalPages.size() - m_freePhysicalPages.size());
+}
+
+uint32_t VirtualShadowMapPageTable::allocatePhysicalPage(uint32_t frameIdx)
+{
+	uint32_t physicalPageIdx = INVALID_PAGE;
+	if (!m_freePhysicalPages.empty())
+	{
+		physicalPageIdx = m_freePhysicalPages.back();
+		m_freePhysicalPages.pop_back();
+	}
+	else if (!m_evictionCandidates.empty())
+	{
+		physicalPageIdx = m_evictionCandidates.back();
+		m_evictionCandidates.pop_back();
+
+		m_virtualPages[m_physicalPages[physicalPageIdx].virtualPage] = VirtualPage();
+		m_physicalPages[physicalPageIdx] = PhysicalPage();
+		m_statistics.evictedPageCount++;
+	}
+
+	if (physicalPageIdx != INVALID_PAGE)
+		m_physicalPages[physicalPageIdx].lastRequestedFrame = frameIdx;
+	return physicalPageIdx;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Residency of the pages of the virtual sun shadow map, doesn't depend on Vulkan so it can be checked on its own.
+// Level 0 is the full resolution, each level halves the page count per side. Virtual pages are indexed level after level, row by row
+class VirtualShadowMapPageTable
+{
+public:
+	static constexpr uint32_t INVALID_PAGE = 0xFFFFFFFF;
+
+	VirtualShadowMapPageTable(uint32_t levelCount, uint32_t level0PageCountPerSide, uint32_t physicalPageCount);
+
+	uint32_t getVirtualPageCount() const { return static_cast<uint32_t>(m_virtualPages.size()); }
+	uint32_t getVirtualPageIdx(uint32_t level, uint32_t x, uint32_t y) const { return m_levelOffsets[level] + y * getPageCountPerSide(level) + x; }
+	uint32_t getPageCountPerSide(uint32_t level) const { return m_level0PageCountPerSide >> level; }
+	void getVirtualPageCoords(uint32_t virtualPageIdx, uint32_t& outLevel, uint32_t& outX, uint32_t& outY) const;
+
+	// Every page is dropped, used when the light projection changes
+	void invalidateAll();
+	// Resident pages overlapping the rectangle are rendered again the next time they are requested, the rectangle is in [0, 1] of the virtual map
+	void invalidateRect(const glm::vec2& min, const glm::vec2& max);
+
+	// 'requests' has one value per virtual page, non zero when a visible receiver uses the page. The coarsest level is always requested so that there's a fallback everywhere.
+	// Requested pages without content get a physical page, the least recently requested pages are evicted when the pool is full.
+	// Pages to render are returned coarsest level first, at most 'maxRenderedPageCount', the others stay pending until the next frames
+	void update(std::span<const uint32_t> requests, uint32_t frameIdx, uint32_t maxRenderedPageCount, std::vector<uint32_t>& outPagesToRender);
+
+	// Virtual page to physical page, INVALID_PAGE when the page doesn't have content yet
+	const std::vector<uint32_t>& getGPUPageTable() const { return m_gpuPageTable; }
+	uint32_t getPhysicalPage(uint32_t virtualPageIdx) const { return m_virtualPages[virtualPageIdx].physicalPage; }
+
+	struct Statistics
+	{
+		uint32_t requestedPageCount = 0;
+		uint32_t residentPageCount = 0;
+		uint32_t renderedPageCount = 0; // this frame
+		uint32_t pendingPageCount = 0; // requested but over the render budget
+		uint32_t evictedPageCount = 0; // this frame
+		uint32_t overflowPageCount = 0; // requested but every physical page is used this frame
+	};
+	const Statistics& getStatistics() const { return m_statistics; }
+
+private:
+	enum class ContentState { NONE, STALE, VALID };
+	struct VirtualPage
+	{
+		uint32_t physicalPage = INVALID_PAGE;
+		ContentState contentState = ContentState::NONE;
+	};
+	struct PhysicalPage
+	{
+		uint32_t virtualPage = INVALID_PAGE;
+		uint32_t lastRequestedFrame = 0;
+	};
+
+	uint32_t allocatePhysicalPage(uint32_t frameIdx);
+
+	uint32_t m_levelCount;
+	uint32_t m_level0PageCountPerSide;
+	std::vector<uint32_t> m_levelOffsets;
+
+	std::vector<VirtualPage> m_virtualPages;
+	std::vector<PhysicalPage> m_physicalPages;
+	std::vector<uint32_t> m_freePhysicalPages;
+	std::vector<uint8_t> m_isRequested; // this frame, per virtual page
+	std::vector<uint32_t> m_evictionCandidates; // resident pages not requested this frame, most recently requested first
+	std::vector<uint32_t> m_gpuPageTable;
+
+	Statistics m_statistics;
+};
@@ -0,0 +1,433 @@
+#include "VirtualShadowMapPass.h"
+
+#include <cstring>
+#include <limits>
+
+#include <CameraInterface.h>
+#include <Configuration.h>
+#include <DescriptorSetGenerator.h>
+#include <Timer.h>
+
+#include "CameraList.h"
+#include "CascadeFitting.h"
+#include "CommonLayout.h"
+#include "DebugMarker.h"
+#include "GameContext.h"
+#include "GPUProfiler.h"
+#include "GraphicCameraInterface.h"
+#include "PreDepthPass.h"
+#include "RenderMeshList.h"
+#include "ShadowMaskSettings.h"
+
+using namespace Wolf;
+
+VkDescriptorSetLayout CommonDescriptorLayouts::g_virtualShadowMapPagesDescriptorSetLayout;
+
+// Casters can move a bit outside of the bounds fitted when the light changes without invalidating every page
+static constexpr float LIGHT_SPACE_BOUNDS_MARGIN = 0.1f;
+
+VirtualShadowMapPageRenderPass::VirtualShadowMapPageRenderPass(const InitializationContext& context, uint32_t size, const CommandBuffer* commandBuffer, const DescriptorSet* descriptorSet) : m_size(size)
+{
+	m_commandBuffer = commandBuffer;
+	m_descriptorSet = descriptorSet;
+
+	DepthPassBase::initializeResources(context);
+}
+
+void VirtualShadowMapPageRenderPass::recordDraws(const RecordContext& context)
+{
+	// Page matrices come from the page descriptor set, the camera is only bound to match the pipeline layout
+	const VkCommandBuffer commandBuffer = getCommandBuffer(context);
+	context.renderMeshList->draw(context, commandBuffer, m_renderPass.get(), CommonPipelineIndices::PIPELINE_IDX_VIRTUAL_SHADOW_MAP_PAGES, CommonCameraIndices::CAMERA_IDX_ACTIVE,
+		{
+			{ 3, m_descriptorSet }
+		});
+}
+
+VkCommandBuffer VirtualShadowMapPageRenderPass::getCommandBuffer(const RecordContext& context)
+{
+	return m_commandBuffer->getCommandBuffer(context.commandBufferIdx);
+}
+
+VirtualShadowMapPass::VirtualShadowMapPass(const ResourceNonOwner<PreDepthPass>& preDepthPass) : m_preDepthPass(preDepthPass),
+	m_pageTable(LEVEL_COUNT, VIRTUAL_RESOLUTION / PAGE_SIZE, PHYSICAL_PAGE_COUNT_PER_SIDE * PHYSICAL_PAGE_COUNT_PER_SIDE)
+{
+	m_pageRequests.resize(m_pageTable.getVirtualPageCount());
+}
+
+void VirtualShadowMapPass::initializeResources(const InitializationContext& context)
+{
+	m_commandBuffer.reset(new CommandBuffer(QueueType::GRAPHIC, false /* isTransient */));
+	m_semaphore.reset(new Semaphore(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT));
+
+	// Page rendering
+	m_pageRenderDescriptorSetLayoutGenerator.addUniformBuffer(VK_SHADER_STAGE_GEOMETRY_BIT, 0);
+	m_pageRenderDescriptorSetLayout.reset(new DescriptorSetLayout(m_pageRenderDescriptorSetLayoutGenerator.getDescriptorLayouts()));
+	CommonDescriptorLayouts::g_virtualShadowMapPagesDescriptorSetLayout = m_pageRenderDescriptorSetLayout->getDescriptorSetLayout();
+
+	m_pageRenderUniformBuffer.reset(new Buffer(sizeof(PageRenderUBData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::EACH_FRAME));
+
+	DescriptorSetGenerator pageRenderDescriptorSetGenerator(m_pageRenderDescriptorSetLayoutGenerator.getDescriptorLayouts());
+	pageRenderDescriptorSetGenerator.setBuffer(0, *m_pageRenderUniformBuffer);
+	m_pageRenderDescriptorSet.reset(new DescriptorSet(m_pageRenderDescriptorSetLayout->getDescriptorSetLayout(), UpdateRate::EACH_FRAME));
+	m_pageRenderDescriptorSet->update(pageRenderDescriptorSetGenerator.getDescriptorSetCreateInfo());
+
+	InitializationContext pageRenderContext = context;
+	pageRenderContext.depthFormat = DEPTH_FORMAT;
+	m_pageRenderPass.reset(new VirtualShadowMapPageRenderPass(pageRenderContext, STAGING_PAGE_COUNT_PER_SIDE * PAGE_SIZE, m_commandBuffer.get(), m_pageRenderDescriptorSet.get()));
+
+	CreateImageInfo physicalPagesCreateInfo;
+	physicalPagesCreateInfo.extent = { PHYSICAL_PAGE_COUNT_PER_SIDE * PAGE_SIZE, PHYSICAL_PAGE_COUNT_PER_SIDE * PAGE_SIZE, 1 };
+	physicalPagesCreateInfo.format = DEPTH_FORMAT;
+	physicalPagesCreateInfo.mipLevelCount = 1;
+	physicalPagesCreateInfo.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	physicalPagesCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	m_physicalPages.reset(new Image(physicalPagesCreateInfo));
+	m_physicalPages->setImageLayout({ VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
+
+	// Shadow mask
+	m_descriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0, 1); // input depth
+	m_descriptorSetLayoutGenerator.addUniformBuffer(VK_SHADER_STAGE_COMPUTE_BIT, 1);
+	m_descriptorSetLayoutGenerator.addImages(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2, 1); // physical pages
+	m_descriptorSetLayoutGenerator.addStorageBuffer(VK_SHADER_STAGE_COMPUTE_BIT, 3); // page table
+	m_descriptorSetLayoutGenerator.addStorageBuffer(VK_SHADER_STAGE_COMPUTE_BIT, 4); // page requests
+	m_descriptorSetLayoutGenerator.addStorageImage(VK_SHADER_STAGE_COMPUTE_BIT, 5); // output mask
+	m_descriptorSetLayout.reset(new DescriptorSetLayout(m_descriptorSetLayoutGenerator.getDescriptorLayouts()));
+
+	const VkDeviceSize pageTableSize = m_pageTable.getVirtualPageCount() * sizeof(uint32_t);
+	m_uniformBuffer.reset(new Buffer(sizeof(ShadowUBData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::EACH_FRAME));
+	m_pageTableBuffer.reset(new Buffer(pageTableSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, UpdateRate::EACH_FRAME));
+	m_pageRequestsBuffer.reset(new Buffer(pageTableSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		UpdateRate::EACH_FRAME));
+	for (uint32_t i = 0; i < g_configuration->getMaxCachedFrames(); ++i)
+		m_pageRequestsBuffer->transferCPUMemory(m_pageRequests.data(), pageTableSize, 0, i); // nothing requested until the first results are read back
+
+	// Shader compilation and pipeline creation don't use the queue, they run on a worker thread while the next passes are initialized
+	m_pipelineCreation = std::async(std::launch::async, [this]
+	{
+		Timer timer("Virtual shadow map pipeline creation");
+		m_computeShaderParser.reset(new ShaderParser("Shaders/virtualShadowMap/shadowMask.comp", {}, 1));
+		createPipeline();
+	});
+	createOutputImages(context.swapChainWidth, context.swapChainHeight);
+
+	m_upsampler.reset(new ShadowMaskUpsampler(m_preDepthPass));
+	m_upsampler->initializeResources(context.swapChainWidth, context.swapChainHeight, m_outputMasks);
+
+	m_descriptorSets.resize(getMaskCount());
+	for (uint32_t i = 0; i < getMaskCount(); ++i)
+		m_descriptorSets[i].reset(new DescriptorSet(m_descriptorSetLayout->getDescriptorSetLayout(), UpdateRate::EACH_FRAME));
+	updateDescriptorSets();
+}
+
+void VirtualShadowMapPass::resize(const InitializationContext& context)
+{
+	createOutputImages(context.swapChainWidth, context.swapChainHeight);
+	m_upsampler->resize(context.swapChainWidth, context.swapChainHeight, m_outputMasks);
+	updateDescriptorSets();
+}
+
+void VirtualShadowMapPass::record(const RecordContext& context)
+{
+	waitForPipelineCreation();
+
+	const GameContext* gameContext = static_cast<const GameContext*>(context.gameContext);
+	const CameraInterface* camera = context.cameraList->getCamera(CommonCameraIndices::CAMERA_IDX_ACTIVE);
+	const uint32_t currentMaskIdx = context.currentFrameIdx % getMaskCount();
+
+	/* Page residency */
+	updateVirtualMapProjection(gameContext->sunDirection);
+	invalidateDynamicCasterPages();
+	m_previousShadowCasters.swap(m_shadowCasters);
+	m_shadowCasters.clear();
+
+	readPageRequests(context.commandBufferIdx);
+	m_pageTable.update(m_pageRequests, context.currentFrameIdx, MAX_RENDERED_PAGE_COUNT, m_pagesToRender);
+
+	/* Update data */
+	PageRenderUBData pageRenderUBData{};
+	pageRenderUBData.lightViewProjection = m_lightViewProjection;
+	pageRenderUBData.pageCount = static_cast<uint32_t>(m_pagesToRender.size());
+	for (uint32_t i = 0; i < m_pagesToRender.size(); ++i)
+	{
+		uint32_t level, x, y;
+		m_pageTable.getVirtualPageCoords(m_pagesToRender[i], level, x, y);
+		pageRenderUBData.pages[i] = glm::uvec4(level, x, y, 0);
+	}
+	m_pageRenderUniformBuffer->transferCPUMemory(&pageRenderUBData, sizeof(pageRenderUBData), 0, context.commandBufferIdx);
+
+	const std::vector<uint32_t>& gpuPageTable = m_pageTable.getGPUPageTable();
+	m_pageTableBuffer->transferCPUMemory(gpuPageTable.data(), gpuPageTable.size() * sizeof(uint32_t), 0, context.commandBufferIdx);
+
+	ShadowUBData shadowUBData;
+	shadowUBData.lightViewProjection = m_lightViewProjection;
+	const uint32_t resolutionDivisor = gameContext->shadowMaskResolutionDivisor;
+	shadowUBData.screenSize = glm::uvec2(ShadowMaskSettings::getReducedSize(m_outputMasks[currentMaskIdx]->getExtent().width, resolutionDivisor),
+		ShadowMaskSettings::getReducedSize(m_outputMasks[currentMaskIdx]->getExtent().height, resolutionDivisor));
+	// Pages match the upsampled mask, not the reduced one
+	shadowUBData.pixelFootprintFactor = 2.0f * glm::tan(camera->getFOV() / 2.0f) / static_cast<float>(m_preDepthPass->getOutput()->getExtent().height);
+	shadowUBData.level0TexelWorldSize = (m_lightSpaceMax.x - m_lightSpaceMin.x) / static_cast<float>(VIRTUAL_RESOLUTION);
+	shadowUBData.resolutionDivisor = resolutionDivisor;
+	m_uniformBuffer->transferCPUMemory(&shadowUBData, sizeof(shadowUBData), 0, context.commandBufferIdx);
+
+	/* Command buffer record */
+	m_commandBuffer->beginCommandBuffer(context.commandBufferIdx);
+	const VkCommandBuffer commandBuffer = m_commandBuffer->getCommandBuffer(context.commandBufferIdx);
+
+	if (!m_pagesToRender.empty())
+	{
+		GPUProfiler::beginPassRegion(commandBuffer, DebugMarker::renderPassDebugColor, "Virtual shadow map pages", true);
+
+		// Copies of the previous frame read the staging target
+		VkMemoryBarrier memoryBarrier{};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = 0;
+		memoryBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		m_pageRenderPass->record(context);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		recordPageCopies(commandBuffer);
+
+		GPUProfiler::endPassRegion(commandBuffer);
+	}
+
+	const VkBuffer pageRequestsBuffer = m_pageRequestsBuffer->getBuffer(context.commandBufferIdx);
+	vkCmdFillBuffer(commandBuffer, pageRequestsBuffer, 0, VK_WHOLE_SIZE, 0);
+
+	VkBufferMemoryBarrier bufferMemoryBarrier{};
+	bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferMemoryBarrier.buffer = pageRequestsBuffer;
+	bufferMemoryBarrier.offset = 0;
+	bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &bufferMemoryBarrier, 0, nullptr);
+
+	GPUProfiler::beginPassRegion(commandBuffer, DebugMarker::computePassDebugColor, "Virtual Shadow Map Mask", false);
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->getPipelineLayout(), 0, 1, m_descriptorSets[currentMaskIdx]->getDescriptorSet(context.commandBufferIdx), 0, nullptr);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->getPipelineLayout(), 1, 1, camera->getDescriptorSet()->getDescriptorSet(), 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->getPipeline());
+
+	constexpr VkExtent3D dispatchGroups = { 16, 16, 1 };
+	const uint32_t groupSizeX = (shadowUBData.screenSize.x + dispatchGroups.width - 1) / dispatchGroups.width;
+	const uint32_t groupSizeY = (shadowUBData.screenSize.y + dispatchGroups.height - 1) / dispatchGroups.height;
+	vkCmdDispatch(commandBuffer, groupSizeX, groupSizeY, dispatchGroups.depth);
+
+	GPUProfiler::endPassRegion(commandBuffer);
+
+	if (resolutionDivisor > 1)
+		m_upsampler->record(commandBuffer, context, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, resolutionDivisor);
+
+	m_commandBuffer->endCommandBuffer(context.commandBufferIdx);
+}
+
+void VirtualShadowMapPass::submit(const SubmitContext& context)
+{
+	const std::vector waitSemaphores{ m_preDepthPass->getSemaphore() };
+	const std::vector signalSemaphores{ m_semaphore->getSemaphore() };
+	m_commandBuffer->submit(context.commandBufferIdx, waitSemaphores, signalSemaphores, VK_NULL_HANDLE);
+
+	if (m_computeShaderParser->compileIfFileHasBeenModified())
+	{
+		vkDeviceWaitIdle(context.device);
+		createPipeline();
+	}
+
+	m_upsampler->reloadShaderIfModified(context);
+}
+
+void VirtualShadowMapPass::addShadowCasterForThisFrame(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& transform, bool isDynamic)
+{
+	// World space AABB enclosing the transformed box
+	const glm::mat3 absoluteRotationScale(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2])));
+	const glm::vec3 center = transform * glm::vec4((localMin + localMax) / 2.0f, 1.0f);
+	const glm::vec3 extent = absoluteRotationScale * ((localMax - localMin) / 2.0f);
+
+	m_shadowCasters.push_back({ center - extent, center + extent, isDynamic });
+}
+
+void VirtualShadowMapPass::createOutputImages(uint32_t width, uint32_t height)
+{
+	CreateImageInfo createImageInfo;
+	createImageInfo.extent = { width, height, 1 };
+	createImageInfo.format = VK_FORMAT_R32G32_SFLOAT;
+	createImageInfo.mipLevelCount = 1;
+	createImageInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+	createImageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	m_outputMasks.resize(getMaskCount());
+	for (uint32_t i = 0; i < getMaskCount(); ++i)
+	{
+		m_outputMasks[i].reset(new Image(createImageInfo));
+		m_outputMasks[i]->setImageLayout({ VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT });
+	}
+}
+
+void VirtualShadowMapPass::createPipeline()
+{
+	std::vector<char> computeShaderCode;
+	m_computeShaderParser->readCompiledShader(computeShaderCode);
+
+	ShaderCreateInfo computeShaderCreateInfo;
+	computeShaderCreateInfo.shaderCode = computeShaderCode;
+	computeShaderCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts(2);
+	descriptorSetLayouts[0] = m_descriptorSetLayout->getDescriptorSetLayout();
+	descriptorSetLayouts[1] = GraphicCameraInterface::getDescriptorSetLayout();
+	m_pipeline.reset(new ComputePipeline(computeShaderCreateInfo, descriptorSetLayouts));
+}
+
+void VirtualShadowMapPass::waitForPipelineCreation()
+{
+	if (m_pipelineCreation.valid())
+		m_pipelineCreation.get();
+}
+
+void VirtualShadowMapPass::updateDescriptorSets() const
+{
+	DescriptorSetGenerator descriptorSetGenerator(m_descriptorSetLayoutGenerator.getDescriptorLayouts());
+
+	DescriptorSetGenerator::ImageDescription preDepthImageDesc;
+	preDepthImageDesc.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	preDepthImageDesc.imageView = m_preDepthPass->getOutput()->getDefaultImageView();
+	descriptorSetGenerator.setImage(0, preDepthImageDesc);
+	descriptorSetGenerator.setBuffer(1, *m_uniformBuffer);
+
+	DescriptorSetGenerator::ImageDescription physicalPagesImageDesc;
+	physicalPagesImageDesc.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	physicalPagesImageDesc.imageView = m_physicalPages->getDefaultImageView();
+	descriptorSetGenerator.setImage(2, physicalPagesImageDesc);
+	descriptorSetGenerator.setBuffer(3, *m_pageTableBuffer);
+	descriptorSetGenerator.setBuffer(4, *m_pageRequestsBuffer);
+
+	for (uint32_t i = 0; i < getMaskCount(); ++i)
+	{
+		DescriptorSetGenerator::ImageDescription outputImageDesc;
+		outputImageDesc.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		outputImageDesc.imageView = m_outputMasks[i]->getDefaultImageView();
+		descriptorSetGenerator.setImage(5, outputImageDesc);
+
+		m_descriptorSets[i]->update(descriptorSetGenerator.getDescriptorSetCreateInfo());
+	}
+}
+
+void VirtualShadowMapPass::updateVirtualMapProjection(const glm::vec3& sunDirection)
+{
+	if (m_shadowCasters.empty())
+		return;
+
+	// The virtual map covers every caster, it only moves when the light changes or a caster leaves it
+	const glm::mat4 lightViewMatrix = CascadeFitting::computeLightViewMatrix(sunDirection);
+	glm::vec3 lightSpaceMin(std::numeric_limits<float>::max());
+	glm::vec3 lightSpaceMax(std::numeric_limits<float>::lowest());
+	for (const ShadowCaster& shadowCaster : m_shadowCasters)
+	{
+		for (uint32_t cornerIdx = 0; cornerIdx < 8; ++cornerIdx)
+		{
+			const glm::vec3 corner((cornerIdx & 1) ? shadowCaster.worldMax.x : shadowCaster.worldMin.x, (cornerIdx & 2) ? shadowCaster.worldMax.y : shadowCaster.worldMin.y,
+				(cornerIdx & 4) ? shadowCaster.worldMax.z : shadowCaster.worldMin.z);
+			const glm::vec3 lightSpaceCorner = lightViewMatrix * glm::vec4(corner, 1.0f);
+			lightSpaceMin = glm::min(lightSpaceMin, lightSpaceCorner);
+			lightSpaceMax = glm::max(lightSpaceMax, lightSpaceCorner);
+		}
+	}
+
+	const bool isLightDirectionSame = m_isProjectionValid && glm::all(glm::lessThan(glm::abs(sunDirection - m_lightDirection), glm::vec3(1.0e-5f)));
+	const bool areCastersContained = glm::all(glm::greaterThanEqual(lightSpaceMin, m_lightSpaceMin)) && glm::all(glm::lessThanEqual(lightSpaceMax, m_lightSpaceMax));
+	if (isLightDirectionSame && areCastersContained)
+		return;
+
+	const glm::vec3 center = (lightSpaceMin + lightSpaceMax) / 2.0f;
+	glm::vec3 halfExtent = (lightSpaceMax - lightSpaceMin) / 2.0f * (1.0f + LIGHT_SPACE_BOUNDS_MARGIN);
+	halfExtent.x = halfExtent.y = glm::max(halfExtent.x, halfExtent.y);
+	m_lightSpaceMin = center - halfExtent;
+	m_lightSpaceMax = center + halfExtent;
+	m_lightDirection = sunDirection;
+	m_isProjectionValid = true;
+
+	// Light space to [-1, 1] in xy and [0, 1] in z, the light looks down -z so the depth grows away from the sun
+	const glm::vec3 extent = m_lightSpaceMax - m_lightSpaceMin;
+	glm::mat4 projectionMatrix(1.0f);
+	projectionMatrix[0][0] = 2.0f / extent.x;
+	projectionMatrix[1][1] = 2.0f / extent.y;
+	projectionMatrix[2][2] = -1.0f / extent.z;
+	projectionMatrix[3] = glm::vec4(-2.0f * center.x / extent.x, -2.0f * center.y / extent.y, m_lightSpaceMax.z / extent.z, 1.0f);
+	m_lightViewProjection = projectionMatrix * lightViewMatrix;
+
+	m_pageTable.invalidateAll();
+}
+
+void VirtualShadowMapPass::invalidateDynamicCasterPages()
+{
+	// Shadows are projected along the light direction so a caster only changes the pages under its light space footprint
+	for (const std::vector<ShadowCaster>* shadowCasters : { &m_shadowCasters, &m_previousShadowCasters })
+	{
+		for (const ShadowCaster& shadowCaster : *shadowCasters)
+		{
+			if (!shadowCaster.isDynamic)
+				continue;
+
+			glm::vec2 virtualMapMin(std::numeric_limits<float>::max());
+			glm::vec2 virtualMapMax(std::numeric_limits<float>::lowest());
+			for (uint32_t cornerIdx = 0; cornerIdx < 8; ++cornerIdx)
+			{
+				const glm::vec3 corner((cornerIdx & 1) ? shadowCaster.worldMax.x : shadowCaster.worldMin.x, (cornerIdx & 2) ? shadowCaster.worldMax.y : shadowCaster.worldMin.y,
+					(cornerIdx & 4) ? shadowCaster.worldMax.z : shadowCaster.worldMin.z);
+				const glm::vec2 virtualMapCorner = glm::vec2(m_lightViewProjection * glm::vec4(corner, 1.0f)) * 0.5f + 0.5f;
+				virtualMapMin = glm::min(virtualMapMin, virtualMapCorner);
+				virtualMapMax = glm::max(virtualMapMax, virtualMapCorner);
+			}
+			m_pageTable.invalidateRect(virtualMapMin, virtualMapMax);
+		}
+	}
+}
+
+void VirtualShadowMapPass::readPageRequests(uint32_t commandBufferIdx)
+{
+	const void* mappedData = m_pageRequestsBuffer->map(commandBufferIdx);
+	memcpy(m_pageRequests.data(), mappedData, m_pageRequests.size() * sizeof(uint32_t));
+	m_pageRequestsBuffer->unmap(commandBufferIdx);
+}
+
+void VirtualShadowMapPass::recordPageCopies(VkCommandBuffer commandBuffer) const
+{
+	Image::TransitionLayoutInfo transitionLayoutInfoToTransferDst{};
+	transitionLayoutInfoToTransferDst.baseMipLevel = 0;
+	transitionLayoutInfoToTransferDst.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	transitionLayoutInfoToTransferDst.dstLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	transitionLayoutInfoToTransferDst.dstPipelineStageFlags = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	transitionLayoutInfoToTransferDst.levelCount = 1;
+	m_physicalPages->transitionImageLayout(commandBuffer, transitionLayoutInfoToTransferDst);
+
+	std::vector<VkImageCopy> copyRegions(m_pagesToRender.size());
+	for (uint32_t stagingSlot = 0; stagingSlot < m_pagesToRender.size(); ++stagingSlot)
+	{
+		const uint32_t physicalPage = m_pageTable.getPhysicalPage(m_pagesToRender[stagingSlot]);
+
+		VkImageCopy& copyRegion = copyRegions[stagingSlot];
+		copyRegion.srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1 };
+		copyRegion.srcOffset = { static_cast<int32_t>((stagingSlot % STAGING_PAGE_COUNT_PER_SIDE) * PAGE_SIZE), static_cast<int32_t>((stagingSlot / STAGING_PAGE_COUNT_PER_SIDE) * PAGE_SIZE), 0 };
+		copyRegion.dstSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1 };
+		copyRegion.dstOffset = { static_cast<int32_t>((physicalPage % PHYSICAL_PAGE_COUNT_PER_SIDE) * PAGE_SIZE), static_cast<int32_t>((physicalPage / PHYSICAL_PAGE_COUNT_PER_SIDE) * PAGE_SIZE), 0 };
+		copyRegion.extent = { PAGE_SIZE, PAGE_SIZE, 1 };
+	}
+	vkCmdCopyImage(commandBuffer, m_pageRenderPass->getOutput()->getImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_physicalPages->getImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+
+	Image::TransitionLayoutInfo transitionLayoutInfoToShaderRead{};
+	transitionLayoutInfoToShaderRead.baseMipLevel = 0;
+	transitionLayoutInfoToShaderRead.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	transitionLayoutInfoToShaderRead.dstLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	transitionLayoutInfoToShaderRead.dstPipelineStageFlags = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	transitionLayoutInfoToShaderRead.levelCount = 1;
+	m_physicalPages->transitionImageLayout(commandBuffer, transitionLayoutInfoToShaderRead);
+}
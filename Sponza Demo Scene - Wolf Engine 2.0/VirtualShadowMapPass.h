@@ -0,0 +1,150 @@
+#pragma once
+
+#include <future>
+#include <glm/glm.hpp>
+
+#include <Buffer.h>
+#include <CommandBuffer.h>
+#include <CommandRecordBase.h>
+#include <DepthPassBase.h>
+#include <DescriptorSet.h>
+#include <DescriptorSetLayout.h>
+#include <DescriptorSetLayoutGenerator.h>
+#include <Image.h>
+#include <Pipeline.h>
+#include <ResourceUniqueOwner.h>
+#include <ShaderParser.h>
+
+#include "PipelineCache.h"
+#include "ShadowMaskBasePass.h"
+#include "ShadowMaskUpsampler.h"
+#include "VirtualShadowMapPageTable.h"
+
+class PreDepthPass;
+
+// Pages rendered this frame, side by side in a small depth target then copied to the physical pages.
+// A geometry shader sends each triangle to the pages it overlaps
+class VirtualShadowMapPageRenderPass : public Wolf::DepthPassBase
+{
+public:
+	VirtualShadowMapPageRenderPass(const Wolf::InitializationContext& context, uint32_t size, const Wolf::CommandBuffer* commandBuffer, const Wolf::DescriptorSet* descriptorSet);
+	VirtualShadowMapPageRenderPass(const VirtualShadowMapPageRenderPass&) = delete;
+
+private:
+	uint32_t getWidth() override { return m_size; }
+	uint32_t getHeight() override { return m_size; }
+
+	void recordDraws(const Wolf::RecordContext& context) override;
+	VkCommandBuffer getCommandBuffer(const Wolf::RecordContext& context) override;
+	VkImageUsageFlags getAdditionalUsages() override { return VK_IMAGE_USAGE_TRANSFER_SRC_BIT; }
+	VkImageLayout getFinalLayout() override { return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; }
+
+	/* Shared resources */
+	const Wolf::CommandBuffer* m_commandBuffer;
+	const Wolf::DescriptorSet* m_descriptorSet;
+
+	/* Owned resources */
+	uint32_t m_size;
+};
+
+// Sun shadows from a single 16K virtual shadow map split in pages. Only the pages used by visible receivers (marked by the mask shader and read back a few frames later) are rendered,
+// they stay cached in a physical page pool until the light moves or a dynamic caster overlaps them. Coarser levels of the virtual map are the fallback while pages are missing
+class VirtualShadowMapPass : public Wolf::CommandRecordBase, public ShadowMaskBasePass
+{
+public:
+	// Constants are also in the shaders of "Shaders/virtualShadowMap"
+	static constexpr uint32_t PAGE_SIZE = 128;
+	static constexpr uint32_t VIRTUAL_RESOLUTION = 16384;
+	static constexpr uint32_t LEVEL_COUNT = 5; // coarsest level is 1024x1024, always resident
+	static constexpr uint32_t PHYSICAL_PAGE_COUNT_PER_SIDE = 32; // 4096x4096 pool
+	static constexpr uint32_t STAGING_PAGE_COUNT_PER_SIDE = 8;
+	static constexpr uint32_t MAX_RENDERED_PAGE_COUNT = STAGING_PAGE_COUNT_PER_SIDE * STAGING_PAGE_COUNT_PER_SIDE;
+	static constexpr VkFormat DEPTH_FORMAT = VK_FORMAT_D32_SFLOAT;
+
+	VirtualShadowMapPass(const Wolf::ResourceNonOwner<PreDepthPass>& preDepthPass);
+
+	void initializeResources(const Wolf::InitializationContext& context) override;
+	void resize(const Wolf::InitializationContext& context) override;
+	void record(const Wolf::RecordContext& context) override;
+	void submit(const Wolf::SubmitContext& context) override;
+
+	Wolf::Image* getOutput(uint32_t frameIdx, bool upsampled) override { return upsampled ? m_upsampler->getOutput(frameIdx % getMaskCount()) : m_outputMasks[frameIdx % getMaskCount()].get(); }
+	const Wolf::Semaphore* getSemaphore() const override { return Wolf::CommandRecordBase::getSemaphore(); }
+	void getConditionalBlocksToEnableWhenReadingMask(std::vector<std::string>& conditionalBlocks) const override {}
+
+	void addShadowCasterForThisFrame(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& transform, bool isDynamic);
+
+	// Statistics of the last recorded frame
+	const VirtualShadowMapPageTable::Statistics& getPageStatistics() const { return m_pageTable.getStatistics(); }
+	uint32_t getPhysicalPageCount() const { return PHYSICAL_PAGE_COUNT_PER_SIDE * PHYSICAL_PAGE_COUNT_PER_SIDE; }
+	uint64_t getPhysicalPoolBytes() const { return static_cast<uint64_t>(PHYSICAL_PAGE_COUNT_PER_SIDE * PAGE_SIZE) * (PHYSICAL_PAGE_COUNT_PER_SIDE * PAGE_SIZE) * sizeof(float); }
+
+private:
+	void createOutputImages(uint32_t width, uint32_t height);
+	void createPipeline();
+	void waitForPipelineCreation();
+	void updateDescriptorSets() const;
+	void updateVirtualMapProjection(const glm::vec3& sunDirection);
+	void invalidateDynamicCasterPages();
+	void readPageRequests(uint32_t commandBufferIdx);
+	void recordPageCopies(VkCommandBuffer commandBuffer) const;
+
+	Wolf::ResourceNonOwner<PreDepthPass> m_preDepthPass;
+
+	/* Virtual map */
+	VirtualShadowMapPageTable m_pageTable;
+	std::vector<uint32_t> m_pagesToRender;
+	std::vector<uint32_t> m_pageRequests;
+	glm::mat4 m_lightViewProjection = glm::mat4(1.0f);
+	glm::vec3 m_lightDirection{};
+	glm::vec3 m_lightSpaceMin{}; // light view space, square in xy
+	glm::vec3 m_lightSpaceMax{};
+	bool m_isProjectionValid = false;
+
+	// World space bounds of the casters added this frame, dynamic ones invalidate the pages they cover now and the frame before
+	struct ShadowCaster
+	{
+		glm::vec3 worldMin;
+		glm::vec3 worldMax;
+		bool isDynamic;
+	};
+	std::vector<ShadowCaster> m_shadowCasters;
+	std::vector<ShadowCaster> m_previousShadowCasters;
+
+	/* Page rendering */
+	std::unique_ptr<VirtualShadowMapPageRenderPass> m_pageRenderPass;
+	Wolf::DescriptorSetLayoutGenerator m_pageRenderDescriptorSetLayoutGenerator;
+	std::unique_ptr<Wolf::DescriptorSetLayout> m_pageRenderDescriptorSetLayout;
+	std::unique_ptr<Wolf::DescriptorSet> m_pageRenderDescriptorSet;
+	struct PageRenderUBData
+	{
+		glm::mat4 lightViewProjection;
+		uint32_t pageCount;
+		uint32_t padding[3];
+		std::array<glm::uvec4, MAX_RENDERED_PAGE_COUNT> pages; // level, x, y
+	};
+	std::unique_ptr<Wolf::Buffer> m_pageRenderUniformBuffer;
+	std::unique_ptr<Wolf::Image> m_physicalPages;
+
+	/* Shadow mask */
+	std::unique_ptr<Wolf::ShaderParser> m_computeShaderParser;
+	std::unique_ptr<ComputePipeline> m_pipeline;
+	std::future<void> m_pipelineCreation;
+	std::vector<std::unique_ptr<Wolf::Image>> m_outputMasks; // allocated at the screen resolution, a reduced mask fills the top left part
+	std::unique_ptr<ShadowMaskUpsampler> m_upsampler; // only recorded with a reduced resolution
+
+	Wolf::DescriptorSetLayoutGenerator m_descriptorSetLayoutGenerator;
+	std::unique_ptr<Wolf::DescriptorSetLayout> m_descriptorSetLayout;
+	std::vector<std::unique_ptr<Wolf::DescriptorSet>> m_descriptorSets;
+	struct ShadowUBData
+	{
+		glm::mat4 lightViewProjection;
+		glm::uvec2 screenSize; // of the mask
+		float pixelFootprintFactor; // world size of a full resolution pixel at a linear depth of 1
+		float level0TexelWorldSize;
+		glm::uint32_t resolutionDivisor;
+	};
+	std::unique_ptr<Wolf::Buffer> m_uniformBuffer;
+	std::unique_ptr<Wolf::Buffer> m_pageTableBuffer; // one per frame in flight
+	std::unique_ptr<Wolf::Buffer> m_pageRequestsBuffer; // one per frame in flight, read back by the CPU when the slot is reused
+};
@@ -1,10 +1,22 @@
+#include <iostream>
+
 #include <WolfEngine.h>
 
+#include "Benchmark.h"
 #include "SystemManager.h"
 
-int main()
+int main(int argc, char* argv[])
 {
-	const std::unique_ptr<SystemManager> s(new SystemManager);
+	Benchmark::CreateInfo benchmarkCreateInfo;
+	const bool runBenchmark = Benchmark::parseCommandLine(argc, argv, benchmarkCreateInfo);
+	if (runBenchmark && benchmarkCreateInfo.offscreen && !SystemManager::isOffscreenSupported())
+	{
+		// The engine isn't created yet, its debug callback can't report this
+		std::cout << "Error : offscreen benchmark needs GLFW 3.4 or later with the null platform, use --benchmark-window to run it in a window" << std::endl;
+		return 1;
+	}
+
+	const std::unique_ptr<SystemManager> s(new SystemManager(runBenchmark ? &benchmarkCreateInfo : nullptr));
 	s->run();
 
 	return 0;
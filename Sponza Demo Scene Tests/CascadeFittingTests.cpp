@@ -0,0 +1,119 @@
+#include <array>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "CascadeFitting.h"
+#include "Tests.h"
+
+static constexpr uint32_t TEXTURE_SIZE = 3072;
+
+static const std::array<glm::vec3, 3> LIGHT_DIRECTIONS = { glm::normalize(glm::vec3(0.3f, -1.0f, 0.2f)), glm::normalize(glm::vec3(-0.6f, -0.5f, 0.4f)),
+	glm::normalize(glm::vec3(0.1f, -0.2f, -1.0f)) };
+
+static CascadeFitting::ViewFrustum createViewFrustum(const glm::vec3& eye, const glm::vec3& target)
+{
+	CascadeFitting::ViewFrustum viewFrustum;
+	viewFrustum.invViewMatrix = glm::inverse(glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+	viewFrustum.tanHalfFOVY = glm::tan(glm::radians(45.0f) / 2.0f);
+	viewFrustum.aspect = 16.0f / 9.0f;
+	return viewFrustum;
+}
+
+static std::array<CascadeFitting::ViewFrustum, 3> createViewFrustums()
+{
+	return { createViewFrustum(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1.0f, 2.0f, 0.3f)), createViewFrustum(glm::vec3(5.0f, 10.0f, -3.0f), glm::vec3(0.0f)),
+		createViewFrustum(glm::vec3(-12.0f, 1.5f, 4.0f), glm::vec3(-11.0f, 1.0f, 6.0f)) };
+}
+
+TEST(cascadeSplitsAreIncreasingAndEndAtMaxDepth)
+{
+	const std::array<std::array<float, 2>, 3> depthRanges = { { { 0.1f, 100.0f }, { 1.0f, 1.1f }, { 5.0f, 3000.0f } } };
+	for (const std::array<float, 2>& depthRange : depthRanges)
+	{
+		for (const float logarithmicWeight : { 0.0f, 0.5f, 0.85f, 1.0f })
+		{
+			std::array<float, 8> splits;
+			for (uint32_t cascadeCount = 2; cascadeCount <= splits.size(); ++cascadeCount)
+			{
+				CascadeFitting::computeSplits(depthRange[0], depthRange[1], logarithmicWeight, std::span<float>(splits.data(), cascadeCount));
+
+				CHECK(splits[0] > depthRange[0]);
+				for (uint32_t cascadeIdx = 1; cascadeIdx < cascadeCount; ++cascadeIdx)
+					CHECK(splits[cascadeIdx] > splits[cascadeIdx - 1]);
+				CHECK(Tests::isNear(splits[cascadeCount - 1], depthRange[1], depthRange[1] * 1e-5f));
+			}
+		}
+	}
+}
+
+TEST(cascadeCenterIsSnappedToTexels)
+{
+	for (const glm::vec3& lightDirection : LIGHT_DIRECTIONS)
+	{
+		const glm::mat4 lightView = CascadeFitting::computeLightViewMatrix(lightDirection);
+
+		// Camera moving by a quarter of a texel along the light space X axis, the center can only move by whole texels
+		CascadeFitting::CascadeBounds firstBounds;
+		CascadeFitting::fitCascade(createViewFrustum(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(1.0f, 2.0f, 0.3f)), 1.0f, 20.0f, lightDirection, TEXTURE_SIZE, firstBounds);
+		const float texelSize = firstBounds.radius * 2.0f / static_cast<float>(TEXTURE_SIZE);
+		const glm::vec3 step = glm::vec3(glm::inverse(lightView) * glm::vec4(0.25f * texelSize, 0.0f, 0.0f, 0.0f));
+
+		for (uint32_t stepIdx = 0; stepIdx < 16; ++stepIdx)
+		{
+			const glm::vec3 eye = glm::vec3(0.0f, 2.0f, 0.0f) + static_cast<float>(stepIdx) * step;
+			CascadeFitting::CascadeBounds bounds;
+			CascadeFitting::fitCascade(createViewFrustum(eye, eye + glm::vec3(1.0f, 0.0f, 0.3f)), 1.0f, 20.0f, lightDirection, TEXTURE_SIZE, bounds);
+
+			CHECK(bounds.radius == firstBounds.radius);
+
+			const glm::vec2 centerInTexels = bounds.lightSpaceCenter / texelSize;
+			CHECK(Tests::isNear(centerInTexels.x, glm::round(centerInTexels.x), 1e-2f));
+			CHECK(Tests::isNear(centerInTexels.y, glm::round(centerInTexels.y), 1e-2f));
+
+			// The world space center is the light space one
+			const glm::vec3 centerLightSpace = lightView * glm::vec4(bounds.center, 1.0f);
+			CHECK(Tests::isNear(centerLightSpace.x, bounds.lightSpaceCenter.x, 1e-3f));
+			CHECK(Tests::isNear(centerLightSpace.y, bounds.lightSpaceCenter.y, 1e-3f));
+		}
+	}
+}
+
+TEST(cascadeBoundsContainFrustumSlice)
+{
+	std::array<float, 4> splits;
+	CascadeFitting::computeSplits(0.1f, 150.0f, 0.85f, splits);
+
+	for (const CascadeFitting::ViewFrustum& viewFrustum : createViewFrustums())
+	{
+		for (const glm::vec3& lightDirection : LIGHT_DIRECTIONS)
+		{
+			const glm::mat4 viewToLight = CascadeFitting::computeLightViewMatrix(lightDirection) * viewFrustum.invViewMatrix;
+			const float tanHalfFOVX = viewFrustum.tanHalfFOVY * viewFrustum.aspect;
+
+			for (uint32_t cascadeIdx = 0; cascadeIdx < splits.size(); ++cascadeIdx)
+			{
+				const float startDepth = cascadeIdx == 0 ? 0.1f : splits[cascadeIdx - 1];
+				const float endDepth = splits[cascadeIdx];
+
+				CascadeFitting::CascadeBounds bounds;
+				CascadeFitting::fitCascade(viewFrustum, startDepth, endDepth, lightDirection, TEXTURE_SIZE, bounds);
+
+				for (const float depth : { startDepth, endDepth })
+				{
+					for (const float y : { -1.0f, 1.0f })
+					{
+						for (const float x : { -1.0f, 1.0f })
+						{
+							const glm::vec3 corner = viewToLight * glm::vec4(x * tanHalfFOVX * depth, y * viewFrustum.tanHalfFOVY * depth, -depth, 1.0f);
+							const float epsilon = 1e-4f * bounds.radius;
+
+							CHECK(glm::abs(corner.x - bounds.lightSpaceCenter.x) <= bounds.radius + epsilon);
+							CHECK(glm::abs(corner.y - bounds.lightSpaceCenter.y) <= bounds.radius + epsilon);
+							CHECK(corner.z <= bounds.lightSpaceMaxZ + epsilon);
+						}
+					}
+				}
+			}
+		}
+	}
+}
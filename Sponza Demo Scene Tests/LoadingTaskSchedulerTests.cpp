@@ -0,0 +1,83 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "LoadingTaskScheduler.h"
+#include "Tests.h"
+
+TEST(gpuTasksRunInOrderAfterTheirDependencies)
+{
+	std::mutex vulkanQueueLock;
+	LoadingTaskScheduler scheduler(&vulkanQueueLock);
+
+	std::atomic<bool> isCPUTaskDone = false;
+	const std::shared_future<void> cpuTask = scheduler.addCPUTask([&isCPUTaskDone]
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		isCPUTaskDone = true;
+	});
+
+	// Only the submission thread writes 'order'
+	std::vector<uint32_t> order;
+	bool wasCPUTaskDone = false;
+	scheduler.addGPUTask([&order] { order.push_back(0); });
+	scheduler.addGPUTask([&order, &isCPUTaskDone, &wasCPUTaskDone] { order.push_back(1); wasCPUTaskDone = isCPUTaskDone; }, { cpuTask });
+	scheduler.addGPUTask([&order] { order.push_back(2); });
+	scheduler.waitIdle();
+
+	CHECK(order == std::vector<uint32_t>({ 0, 1, 2 }));
+	CHECK(wasCPUTaskDone);
+}
+
+TEST(gpuTasksHoldTheQueueLock)
+{
+	std::mutex vulkanQueueLock;
+	LoadingTaskScheduler scheduler(&vulkanQueueLock);
+
+	bool wasLocked = false;
+	bool wasUnlockedForModelLoading = false;
+	scheduler.addGPUTask([&vulkanQueueLock, &wasLocked]
+	{
+		wasLocked = !vulkanQueueLock.try_lock();
+		if (!wasLocked)
+			vulkanQueueLock.unlock();
+	});
+	scheduler.addGPUTask([&vulkanQueueLock, &wasUnlockedForModelLoading]
+	{
+		wasUnlockedForModelLoading = vulkanQueueLock.try_lock();
+		if (wasUnlockedForModelLoading)
+			vulkanQueueLock.unlock();
+	}, {}, false);
+	scheduler.waitIdle();
+
+	CHECK(wasLocked);
+	CHECK(wasUnlockedForModelLoading);
+}
+
+TEST(cpuTasksRunConcurrently)
+{
+	std::mutex vulkanQueueLock;
+	LoadingTaskScheduler scheduler(&vulkanQueueLock);
+	if (std::thread::hardware_concurrency() < 3)
+		return; // a single CPU worker
+
+	// Each task waits for the other one to start
+	std::atomic<uint32_t> startedTaskCount = 0;
+	std::atomic<bool> haveBothStarted = true;
+	for (uint32_t i = 0; i < 2; ++i)
+	{
+		scheduler.addCPUTask([&startedTaskCount, &haveBothStarted]
+		{
+			startedTaskCount++;
+			const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+			while (startedTaskCount < 2 && std::chrono::steady_clock::now() < timeout)
+				std::this_thread::yield();
+			if (startedTaskCount < 2)
+				haveBothStarted = false;
+		});
+	}
+	scheduler.waitIdle();
+
+	CHECK(haveBothStarted);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cmath>
+
+// Minimal test registration, tests of the CPU-only parts of the demo (no Vulkan device needed).
+// A test is a function declared with TEST(), CHECK() reports a failed condition without stopping the test
+namespace Tests
+{
+	typedef void (*TestFunction)();
+
+	bool registerTest(const char* name, TestFunction function);
+	void reportFailure(const char* file, int line, const char* condition);
+
+	// Returns the number of failed tests
+	int runAll();
+
+	inline bool isNear(float a, float b, float epsilon) { return std::abs(a - b) <= epsilon; }
+}
+
+#define TEST(name) \
+	static void name(); \
+	static const bool name##IsRegistered = Tests::registerTest(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do { if (!(condition)) Tests::reportFailure(__FILE__, __LINE__, #condition); } while (false)
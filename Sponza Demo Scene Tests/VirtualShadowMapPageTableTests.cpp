@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <vector>
+
+#include "Tests.h"
+#include "VirtualShadowMapPageTable.h"
+
+// 4x4, 2x2 and 1x1 pages
+static constexpr uint32_t LEVEL_COUNT = 3;
+static constexpr uint32_t LEVEL_0_PAGE_COUNT_PER_SIDE = 4;
+static constexpr uint32_t NO_BUDGET_LIMIT = 0xFFFFFFFF;
+
+static uint32_t getCoarsestPageIdx(const VirtualShadowMapPageTable& pageTable)
+{
+	return pageTable.getVirtualPageIdx(LEVEL_COUNT - 1, 0, 0);
+}
+
+static std::vector<uint32_t> createRequests(const VirtualShadowMapPageTable& pageTable, const std::vector<uint32_t>& requestedPages)
+{
+	std::vector<uint32_t> requests(pageTable.getVirtualPageCount(), 0);
+	for (const uint32_t virtualPageIdx : requestedPages)
+		requests[virtualPageIdx] = 1;
+	return requests;
+}
+
+TEST(virtualPageCoordsRoundTrip)
+{
+	const VirtualShadowMapPageTable pageTable(LEVEL_COUNT, LEVEL_0_PAGE_COUNT_PER_SIDE, 8);
+	CHECK(pageTable.getVirtualPageCount() == 16 + 4 + 1);
+
+	uint32_t expectedVirtualPageIdx = 0;
+	for (uint32_t level = 0; level < LEVEL_COUNT; ++level)
+	{
+		for (uint32_t y = 0; y < pageTable.getPageCountPerSide(level); ++y)
+		{
+			for (uint32_t x = 0; x < pageTable.getPageCountPerSide(level); ++x)
+			{
+				const uint32_t virtualPageIdx = pageTable.getVirtualPageIdx(level, x, y);
+				CHECK(virtualPageIdx == expectedVirtualPageIdx++);
+
+				uint32_t outLevel, outX, outY;
+				pageTable.getVirtualPageCoords(virtualPageIdx, outLevel, outX, outY);
+				CHECK(outLevel == level);
+				CHECK(outX == x);
+				CHECK(outY == y);
+			}
+		}
+	}
+}
+
+TEST(leastRecentlyRequestedPageIsEvictedFirst)
+{
+	// The coarsest page and 3 others
+	VirtualShadowMapPageTable pageTable(LEVEL_COUNT, LEVEL_0_PAGE_COUNT_PER_SIDE, 4);
+	const uint32_t pageA = pageTable.getVirtualPageIdx(0, 0, 0);
+	const uint32_t pageB = pageTable.getVirtualPageIdx(0, 1, 0);
+	const uint32_t pageC = pageTable.getVirtualPageIdx(0, 2, 0);
+	const uint32_t pageD = pageTable.getVirtualPageIdx(0, 3, 0);
+	const uint32_t pageE = pageTable.getVirtualPageIdx(0, 0, 1);
+
+	// A is requested again after B and C, B is the least recently requested
+	std::vector<uint32_t> pagesToRender;
+	uint32_t frameIdx = 1;
+	for (const uint32_t requestedPage : { pageA, pageB, pageC, pageA })
+		pageTable.update(createRequests(pageTable, { requestedPage }), frameIdx++, NO_BUDGET_LIMIT, pagesToRender);
+	CHECK(pageTable.getStatistics().residentPageCount == 4);
+	CHECK(pageTable.getStatistics().evictedPageCount == 0);
+
+	const uint32_t physicalPageB = pageTable.getPhysicalPage(pageB);
+	pageTable.update(createRequests(pageTable, { pageD }), frameIdx++, NO_BUDGET_LIMIT, pagesToRender);
+	CHECK(pageTable.getStatistics().evictedPageCount == 1);
+	CHECK(pageTable.getPhysicalPage(pageB) == VirtualShadowMapPageTable::INVALID_PAGE);
+	CHECK(pageTable.getGPUPageTable()[pageB] == VirtualShadowMapPageTable::INVALID_PAGE);
+	CHECK(pageTable.getPhysicalPage(pageD) == physicalPageB);
+	CHECK(pageTable.getPhysicalPage(pageA) != VirtualShadowMapPageTable::INVALID_PAGE);
+	CHECK(pageTable.getPhysicalPage(pageC) != VirtualShadowMapPageTable::INVALID_PAGE);
+
+	// C is now older than A and D
+	pageTable.update(createRequests(pageTable, { pageE }), frameIdx++, NO_BUDGET_LIMIT, pagesToRender);
+	CHECK(pageTable.getStatistics().evictedPageCount == 1);
+	CHECK(pageTable.getPhysicalPage(pageC) == VirtualShadowMapPageTable::INVALID_PAGE);
+	CHECK(pageTable.getPhysicalPage(pageA) != VirtualShadowMapPageTable::INVALID_PAGE);
+	CHECK(pageTable.getPhysicalPage(pageD) != VirtualShadowMapPageTable::INVALID_PAGE);
+	CHECK(pageTable.getPhysicalPage(pageE) != VirtualShadowMapPageTable::INVALID_PAGE);
+}
+
+TEST(coarsestLevelStaysResident)
+{
+	VirtualShadowMapPageTable pageTable(LEVEL_COUNT, LEVEL_0_PAGE_COUNT_PER_SIDE, 3);
+	const uint32_t coarsestPageIdx = getCoarsestPageIdx(pageTable);
+
+	// Not requested by any receiver
+	std::vector<uint32_t> pagesToRender;
+	pageTable.update(createRequests(pageTable, {}), 1, NO_BUDGET_LIMIT, pagesToRender);
+	CHECK(pagesToRender.size() == 1);
+	CHECK(!pagesToRender.empty() && pagesToRender[0] == coarsestPageIdx);
+
+	// Every frame requests more level 0 pages than the pool can hold
+	const uint32_t coarsestPhysicalPage = pageTable.getPhysicalPage(coarsestPageIdx);
+	for (uint32_t frameIdx = 2; frameIdx < 10; ++frameIdx)
+	{
+		std::vector<uint32_t> requestedPages;
+		for (uint32_t x = 0; x < LEVEL_0_PAGE_COUNT_PER_SIDE; ++x)
+			requestedPages.push_back(pageTable.getVirtualPageIdx(0, x, frameIdx % LEVEL_0_PAGE_COUNT_PER_SIDE));
+		pageTable.update(createRequests(pageTable, requestedPages), frameIdx, NO_BUDGET_LIMIT, pagesToRender);
+
+		CHECK(pageTable.getStatistics().overflowPageCount > 0);
+		CHECK(pageTable.getPhysicalPage(coarsestPageIdx) == coarsestPhysicalPage);
+		CHECK(pageTable.getGPUPageTable()[coarsestPageIdx] == coarsestPhysicalPage);
+		CHECK(std::find(pagesToRender.begin(), pagesToRender.end(), coarsestPageIdx) == pagesToRender.end());
+	}
+}
+
+TEST(invalidateRectOnlyRerendersOverlappingPages)
+{
+	VirtualShadowMapPageTable pageTable(LEVEL_COUNT, LEVEL_0_PAGE_COUNT_PER_SIDE, 16 + 4 + 1);
+	const std::vector<uint32_t> requests(pageTable.getVirtualPageCount(), 1);
+
+	std::vector<uint32_t> pagesToRender;
+	pageTable.update(requests, 1, NO_BUDGET_LIMIT, pagesToRender);
+	CHECK(pagesToRender.size() == pageTable.getVirtualPageCount());
+	const std::vector<uint32_t> initialGPUPageTable = pageTable.getGPUPageTable();
+
+	// Outside of the map
+	pageTable.invalidateRect(glm::vec2(1.1f, 0.0f), glm::vec2(1.5f, 1.0f));
+	pageTable.update(requests, 2, NO_BUDGET_LIMIT, pagesToRender);
+	CHECK(pagesToRender.empty());
+
+	// Overlaps level 0 pages (0, 0) and (1, 0), and page (0, 0) of the coarser levels
+	pageTable.invalidateRect(glm::vec2(0.1f, 0.1f), glm::vec2(0.3f, 0.2f));
+	const std::vector<uint32_t> expectedPagesToRender = { getCoarsestPageIdx(pageTable), pageTable.getVirtualPageIdx(1, 0, 0), pageTable.getVirtualPageIdx(0, 0, 0),
+		pageTable.getVirtualPageIdx(0, 1, 0) };
+
+	// Stale pages keep their content as long as they aren't rendered again
+	pageTable.update(requests, 3, 0, pagesToRender);
+	CHECK(pagesToRender.empty());
+	CHECK(pageTable.getStatistics().pendingPageCount == expectedPagesToRender.size());
+	CHECK(pageTable.getGPUPageTable() == initialGPUPageTable);
+
+	pageTable.update(requests, 4, NO_BUDGET_LIMIT, pagesToRender);
+	CHECK(pagesToRender == expectedPagesToRender);
+	CHECK(pageTable.getGPUPageTable() == initialGPUPageTable);
+}
+
+TEST(renderBudgetLeavesPagesPending)
+{
+	VirtualShadowMapPageTable pageTable(LEVEL_COUNT, LEVEL_0_PAGE_COUNT_PER_SIDE, 16 + 4 + 1);
+	const std::vector<uint32_t> requests(pageTable.getVirtualPageCount(), 1);
+	constexpr uint32_t MAX_RENDERED_PAGE_COUNT = 5;
+
+	// Coarsest level first: the first frame renders the 1x1 and 2x2 levels
+	std::vector<uint32_t> pagesToRender;
+	pageTable.update(requests, 1, MAX_RENDERED_PAGE_COUNT, pagesToRender);
+	CHECK(pagesToRender.size() == MAX_RENDERED_PAGE_COUNT);
+	CHECK(pageTable.getStatistics().pendingPageCount == pageTable.getVirtualPageCount() - MAX_RENDERED_PAGE_COUNT);
+	for (const uint32_t virtualPageIdx : pagesToRender)
+	{
+		uint32_t level, x, y;
+		pageTable.getVirtualPageCoords(virtualPageIdx, level, x, y);
+		CHECK(level > 0);
+	}
+	for (uint32_t i = 0; i < 16; ++i)
+		CHECK(pageTable.getGPUPageTable()[pageTable.getVirtualPageIdx(0, i % 4, i / 4)] == VirtualShadowMapPageTable::INVALID_PAGE);
+
+	// Pending pages are rendered by the next frames, each page once
+	std::vector<uint32_t> renderedPages = pagesToRender;
+	for (uint32_t frameIdx = 2; frameIdx <= 5; ++frameIdx)
+	{
+		const uint32_t pendingPageCount = pageTable.getStatistics().pendingPageCount;
+		pageTable.update(requests, frameIdx, MAX_RENDERED_PAGE_COUNT, pagesToRender);
+		CHECK(pagesToRender.size() == std::min(pendingPageCount, MAX_RENDERED_PAGE_COUNT));
+		CHECK(pageTable.getStatistics().pendingPageCount == pendingPageCount - pagesToRender.size());
+		renderedPages.insert(renderedPages.end(), pagesToRender.begin(), pagesToRender.end());
+	}
+
+	std::sort(renderedPages.begin(), renderedPages.end());
+	CHECK(renderedPages.size() == pageTable.getVirtualPageCount());
+	CHECK(std::unique(renderedPages.begin(), renderedPages.end()) == renderedPages.end());
+	CHECK(std::find(pageTable.getGPUPageTable().begin(), pageTable.getGPUPageTable().end(), VirtualShadowMapPageTable::INVALID_PAGE) == pageTable.getGPUPageTable().end());
+}
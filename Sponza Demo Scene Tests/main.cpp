@@ -0,0 +1,54 @@
+#include <iostream>
+#include <vector>
+
+#include "Tests.h"
+
+struct RegisteredTest
+{
+	const char* name;
+	Tests::TestFunction function;
+};
+
+// Function static so that it's built before the registration of tests from other translation units
+static std::vector<RegisteredTest>& getRegisteredTests()
+{
+	static std::vector<RegisteredTest> registeredTests;
+	return registeredTests;
+}
+
+static int g_failureCount = 0;
+
+bool Tests::registerTest(const char* name, TestFunction function)
+{
+	getRegisteredTests().push_back({ name, function });
+	return true;
+}
+
+void Tests::reportFailure(const char* file, int line, const char* condition)
+{
+	std::cout << "  " << file << "(" << line << "): CHECK(" << condition << ") failed\n";
+	g_failureCount++;
+}
+
+int Tests::runAll()
+{
+	int failedTestCount = 0;
+	for (const RegisteredTest& registeredTest : getRegisteredTests())
+	{
+		const int previousFailureCount = g_failureCount;
+		registeredTest.function();
+
+		const bool hasFailed = g_failureCount != previousFailureCount;
+		std::cout << (hasFailed ? "[FAILED] " : "[  OK  ] ") << registeredTest.name << "\n";
+		if (hasFailed)
+			failedTestCount++;
+	}
+
+	std::cout << getRegisteredTests().size() - failedTestCount << "/" << getRegisteredTests().size() << " tests passed\n";
+	return failedTestCount;
+}
+
+int main()
+{
+	return Tests::runAll() == 0 ? 0 : 1;
+}